@@ -0,0 +1,242 @@
+#include "ApiBudget.h"
+#include "Platform.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const uint32_t kBucketMagic = 0x41504231;
+static const double kBurstHours = 10.0 / 60.0;
+static const double kMinCapacity = 2.0;
+static const double kMsPerHour = 3600.0 * 1000.0;
+// Share of the bucket each priority must leave for the ones above it.
+static const double kReserve[kApiPriorityCount] = {0.5, 0.25, 0.0};
+
+double ApiBucketCapacity(uint32_t perHour)
+{
+    return (std::max)(perHour * kBurstHours, kMinCapacity);
+}
+
+static void Refill(ApiBucket& bucket, uint32_t perHour, uint64_t nowMs)
+{
+    double capacity = ApiBucketCapacity(perHour);
+    if (bucket.magic != kBucketMagic) {
+        bucket = ApiBucket{};
+        bucket.magic = kBucketMagic;
+        bucket.tokens = capacity;
+        bucket.refilledMs = nowMs;
+    }
+    bucket.perHour = perHour;
+    if (nowMs > bucket.refilledMs)
+        bucket.tokens += (nowMs - bucket.refilledMs) * perHour / kMsPerHour;
+    bucket.tokens = (std::min)(bucket.tokens, capacity);
+    bucket.refilledMs = nowMs;
+}
+
+bool ApiBucketTake(ApiBucket& bucket, ApiPriority priority, uint32_t perHour, uint64_t nowMs, uint64_t& retryMs)
+{
+    retryMs = 0;
+    if (!perHour) {
+        ++bucket.calls;
+        return true;
+    }
+
+    Refill(bucket, perHour, nowMs);
+    double needed = 1.0 + kReserve[static_cast<int>(priority)] * ApiBucketCapacity(perHour);
+    if (bucket.tokens >= needed) {
+        bucket.tokens -= 1.0;
+        ++bucket.calls;
+        return true;
+    }
+
+    ++bucket.deferred[static_cast<int>(priority)];
+    retryMs = static_cast<uint64_t>(std::ceil((needed - bucket.tokens) * kMsPerHour / perHour));
+    return false;
+}
+
+void ApiBucketCharge(ApiBucket& bucket, uint32_t perHour, uint64_t nowMs)
+{
+    ++bucket.calls;
+    if (!perHour) return;
+    Refill(bucket, perHour, nowMs);
+    bucket.tokens = (std::max)(bucket.tokens - 1.0, -ApiBucketCapacity(perHour));
+}
+
+void ApiBucketRefund(ApiBucket& bucket, uint32_t perHour, uint64_t nowMs)
+{
+    if (bucket.calls) --bucket.calls;
+    if (!perHour) return;
+    Refill(bucket, perHour, nowMs);
+    bucket.tokens = (std::min)(bucket.tokens + 1.0, ApiBucketCapacity(perHour));
+}
+
+// Serializes threads in this process, then processes sharing the bucket.
+class ApiGovernor::Lock {
+public:
+    explicit Lock(ApiGovernor& governor)
+        : m_guard(governor.m_mutex)
+        , m_governor(governor)
+    {
+#ifdef _WIN32
+        // WAIT_ABANDONED still grants ownership; the bucket is plain numbers,
+        // so whatever a crashed holder left behind is usable.
+        if (m_governor.m_lock) WaitForSingleObject(m_governor.m_lock, INFINITE);
+#else
+        if (m_governor.m_fd >= 0) flock(m_governor.m_fd, LOCK_EX);
+#endif
+    }
+
+    ~Lock()
+    {
+#ifdef _WIN32
+        if (m_governor.m_lock) ReleaseMutex(m_governor.m_lock);
+#else
+        if (m_governor.m_fd >= 0) flock(m_governor.m_fd, LOCK_UN);
+#endif
+    }
+
+private:
+    std::lock_guard<std::mutex> m_guard;
+    ApiGovernor& m_governor;
+};
+
+ApiGovernor& ApiGovernor::Shared()
+{
+    static ApiGovernor governor("ClaudeUsageTaskbar.ApiBudget");
+    return governor;
+}
+
+#ifdef _WIN32
+
+ApiGovernor::ApiGovernor(const char* name)
+{
+    std::wstring base = L"Local\\";
+    for (const char* c = name; *c; ++c) base += static_cast<wchar_t>(*c);
+    m_mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(ApiBucket), base.c_str());
+    m_lock = CreateMutexW(nullptr, FALSE, (base + L".lock").c_str());
+    void* view = m_mapping && m_lock ? MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(ApiBucket)) : nullptr;
+    if (view) {
+        m_bucket = static_cast<ApiBucket*>(view);
+        return;
+    }
+    for (HANDLE* handle : {&m_mapping, &m_lock}) {
+        if (*handle) CloseHandle(*handle);
+        *handle = nullptr;
+    }
+}
+
+ApiGovernor::~ApiGovernor()
+{
+    if (m_bucket != &m_local) UnmapViewOfFile(m_bucket);
+    for (HANDLE handle : {m_mapping, m_lock})
+        if (handle) CloseHandle(handle);
+}
+
+#else
+
+ApiGovernor::ApiGovernor(const char* name)
+{
+    // /dev/shm is machine-wide; keep one bucket per user.
+    std::string path = "/" + std::string(name) + "." + std::to_string(getuid());
+    m_fd = shm_open(path.c_str(), O_RDWR | O_CREAT, 0600);
+    if (m_fd < 0) return;
+
+    struct stat st;
+    void* view = MAP_FAILED;
+    if (fstat(m_fd, &st) == 0
+        && (st.st_size >= static_cast<off_t>(sizeof(ApiBucket)) || ftruncate(m_fd, sizeof(ApiBucket)) == 0))
+        view = mmap(nullptr, sizeof(ApiBucket), PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (view != MAP_FAILED) {
+        m_bucket = static_cast<ApiBucket*>(view);
+        return;
+    }
+    close(m_fd);
+    m_fd = -1;
+}
+
+ApiGovernor::~ApiGovernor()
+{
+    if (m_bucket != &m_local) munmap(m_bucket, sizeof(ApiBucket));
+    if (m_fd >= 0) close(m_fd);
+}
+
+#endif
+
+void ApiGovernor::SetBudget(uint32_t perHour)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_perHour = perHour;
+}
+
+bool ApiGovernor::Acquire(ApiPriority priority, uint64_t& retryMs)
+{
+    Lock lock(*this);
+    return ApiBucketTake(*m_bucket, priority, m_perHour, TickMs(), retryMs);
+}
+
+void ApiGovernor::Charge()
+{
+    Lock lock(*this);
+    ApiBucketCharge(*m_bucket, m_perHour, TickMs());
+}
+
+void ApiGovernor::Refund()
+{
+    Lock lock(*this);
+    ApiBucketRefund(*m_bucket, m_perHour, TickMs());
+}
+
+ApiBudgetStats ApiGovernor::GetStats()
+{
+    Lock lock(*this);
+    ApiBudgetStats stats;
+    stats.perHour = m_perHour;
+    stats.shared = m_bucket != &m_local;
+    stats.calls = m_bucket->calls;
+    std::copy(m_bucket->deferred, m_bucket->deferred + kApiPriorityCount, stats.deferred);
+    if (m_perHour) {
+        ApiBucket current = *m_bucket;
+        Refill(current, m_perHour, TickMs());
+        stats.capacity = ApiBucketCapacity(m_perHour);
+        stats.tokens = current.tokens;
+    }
+    return stats;
+}
+
+static thread_local ApiAdmission* t_admission = nullptr;
+
+ApiAdmission::ApiAdmission(ApiPriority priority, ApiGovernor& governor)
+    : m_governor(governor)
+    , m_previous(t_admission)
+{
+    m_granted = governor.Acquire(priority, m_retryMs);
+    m_credit = m_granted;
+    t_admission = this;
+}
+
+ApiAdmission::~ApiAdmission()
+{
+    if (m_credit) m_governor.Refund();
+    t_admission = m_previous;
+}
+
+void ChargeApiCall()
+{
+    auto* admission = t_admission;
+    if (!admission) {
+        ApiGovernor::Shared().Charge();
+        return;
+    }
+    if (admission->m_credit) {
+        admission->m_credit = false;
+        return;
+    }
+    admission->m_governor.Charge();
+}
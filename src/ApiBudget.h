@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+// Lowest first: when the budget runs short, scheduled polls are deferred
+// before token refreshes, and a click is deferred only once nothing is left.
+enum class ApiPriority {
+    Scheduled,
+    TokenRefresh,
+    Manual,
+};
+
+constexpr int kApiPriorityCount = 3;
+
+// Token-bucket state. Plain data, so it can live in memory shared by every
+// instance on the machine.
+struct ApiBucket {
+    uint32_t magic;
+    uint32_t perHour;
+    double tokens;
+    uint64_t refilledMs;
+    uint64_t calls;
+    uint64_t deferred[kApiPriorityCount];
+};
+
+struct ApiBudgetStats {
+    uint32_t perHour = 0;
+    double capacity = 0.0;
+    double tokens = 0.0;
+    uint64_t calls = 0;
+    uint64_t deferred[kApiPriorityCount] = {};
+    bool shared = false;
+};
+
+// The bucket refills at perHour tokens an hour and holds ten minutes' worth.
+// Each priority below Manual must leave a reserve behind for the ones above
+// it. Calls charged after admission may push the balance into debt, which
+// later admissions wait out. A perHour of 0 turns the limit off.
+double ApiBucketCapacity(uint32_t perHour);
+bool ApiBucketTake(ApiBucket& bucket, ApiPriority priority, uint32_t perHour, uint64_t nowMs, uint64_t& retryMs);
+void ApiBucketCharge(ApiBucket& bucket, uint32_t perHour, uint64_t nowMs);
+void ApiBucketRefund(ApiBucket& bucket, uint32_t perHour, uint64_t nowMs);
+
+// Hourly budget for the usage and token endpoints, shared through a named
+// mapping so every process and account on the machine draws from one
+// bucket. Falls back to a private bucket when the mapping cannot be opened.
+class ApiGovernor {
+public:
+    static ApiGovernor& Shared();
+
+    explicit ApiGovernor(const char* name);
+    ~ApiGovernor();
+    ApiGovernor(const ApiGovernor&) = delete;
+    ApiGovernor& operator=(const ApiGovernor&) = delete;
+
+    void SetBudget(uint32_t perHour);
+    bool Acquire(ApiPriority priority, uint64_t& retryMs);
+    void Charge();
+    void Refund();
+    ApiBudgetStats GetStats();
+
+private:
+    class Lock;
+
+    std::mutex m_mutex;
+    uint32_t m_perHour = 0;
+    ApiBucket m_local = {};
+    ApiBucket* m_bucket = &m_local;
+
+#ifdef _WIN32
+    HANDLE m_mapping = nullptr;
+    HANDLE m_lock = nullptr;
+#else
+    int m_fd = -1;
+#endif
+};
+
+// Admits one poll or refresh. The admission token pays for the first call
+// made on this thread while it is alive; any further call is charged as it
+// goes out, and an unused token is refunded.
+class ApiAdmission {
+public:
+    explicit ApiAdmission(ApiPriority priority, ApiGovernor& governor = ApiGovernor::Shared());
+    ~ApiAdmission();
+    ApiAdmission(const ApiAdmission&) = delete;
+    ApiAdmission& operator=(const ApiAdmission&) = delete;
+
+    bool Granted() const { return m_granted; }
+    uint64_t RetryMs() const { return m_retryMs; }
+
+private:
+    friend void ChargeApiCall();
+
+    ApiGovernor& m_governor;
+    ApiAdmission* m_previous;
+    bool m_granted;
+    bool m_credit;
+    uint64_t m_retryMs = 0;
+};
+
+// Counts a usage or token call that is about to be sent.
+void ChargeApiCall();
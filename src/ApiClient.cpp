@@ -1,38 +1,136 @@
 #include "ApiClient.h"
 #include "Settings.h"
+#include "HttpTrace.h"
+#include "CredentialsFile.h"
+#include "PollArena.h"
+#include "Hedge.h"
+#include "ApiBudget.h"
+#include "HttpTransport.h"
+#include "Platform.h"
+#include "Scheduler.h"
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-#include <winhttp.h>
 #include <nlohmann/json.hpp>
 
 #include <fstream>
-#include <sstream>
+#include <cstdio>
 #include <ctime>
 #include <vector>
+#include <mutex>
+#include <memory>
+#include <future>
+#include <map>
+#include <string_view>
 
 using json = nlohmann::json;
+// Per-poll documents; every node, key and string lives in the poll arena.
+using PollJson = nlohmann::basic_json<std::map, std::vector, PollString, bool, std::int64_t, std::uint64_t,
+    double, PollAllocator>;
 
 static const int64_t kTokenExpiryBufferMs = 5 * 60 * 1000;
 
-static std::wstring GetCredentialsPath()
+static thread_local const std::wstring* t_credentialsPath = nullptr;
+
+CredentialsPathScope::CredentialsPathScope(const std::wstring& path)
+    : m_previous(t_credentialsPath)
+{
+    if (!path.empty()) t_credentialsPath = &path;
+}
+
+CredentialsPathScope::~CredentialsPathScope()
+{
+    t_credentialsPath = m_previous;
+}
+
+const std::wstring& GetCredentialsPath()
+{
+    if (t_credentialsPath) return *t_credentialsPath;
+
+    thread_local uint64_t cachedVersion = UINT64_MAX;
+    thread_local std::wstring cachedPath;
+
+    auto settings = Settings::Instance().Get();
+    if (settings->version != cachedVersion) {
+        cachedPath = settings->credentialsPath.empty()
+            ? Settings::GetDefaultCredentialsPath() : settings->credentialsPath;
+        cachedVersion = settings->version;
+    }
+    return cachedPath;
+}
+
+static PollString ReadFileUtf8(const std::wstring& path)
+{
+    PollString content;
+    std::ifstream file(NativePath(path), std::ios::binary | std::ios::ate);
+    if (!file.is_open()) return content;
+    auto size = static_cast<std::streamoff>(file.tellg());
+    if (size <= 0) return content;
+    content.resize(static_cast<size_t>(size));
+    file.seekg(0);
+    file.read(&content[0], size);
+    content.resize(static_cast<size_t>(file.gcount()));
+    return content;
+}
+
+static std::string ToStdString(const PollJson& value)
+{
+    auto& str = value.get_ref<const PollString&>();
+    return std::string(str.data(), str.size());
+}
+
+static PollString ToPollString(const std::string& str)
+{
+    return PollString(str.data(), str.size());
+}
+
+struct CachedCredentials {
+    FileStamp stamp;
+    Credentials credentials;
+};
+
+// One entry per file, so workers polling different accounts keep theirs.
+static struct {
+    std::mutex mutex;
+    std::map<std::wstring, CachedCredentials> byPath;
+} g_credCache;
+
+static void StoreCachedCredentials(const std::wstring& path, const FileStamp& stamp, const Credentials& creds)
+{
+    std::lock_guard<std::mutex> lock(g_credCache.mutex);
+    g_credCache.byPath[path] = {stamp, creds};
+}
+
+void InvalidateCredentialsCache()
 {
-    return Settings::Instance().GetEffectiveCredentialsPath();
+    auto& path = GetCredentialsPath();
+    std::lock_guard<std::mutex> lock(g_credCache.mutex);
+    g_credCache.byPath.erase(path);
 }
 
-static std::string ReadFileUtf8(const std::wstring& path)
+bool HasCredentialsFileChanged()
 {
-    std::ifstream file(path, std::ios::binary);
-    if (!file.is_open()) return {};
-    std::ostringstream ss;
-    ss << file.rdbuf();
-    return ss.str();
+    auto& path = GetCredentialsPath();
+    auto stamp = GetFileStamp(path);
+    std::lock_guard<std::mutex> lock(g_credCache.mutex);
+    auto cached = g_credCache.byPath.find(path);
+    return cached == g_credCache.byPath.end() || !(cached->second.stamp == stamp);
 }
 
 ApiResponse ReadCredentials()
 {
     ApiResponse resp;
-    auto path = GetCredentialsPath();
+    auto& path = GetCredentialsPath();
+    auto stamp = GetFileStamp(path);
+
+    {
+        std::lock_guard<std::mutex> lock(g_credCache.mutex);
+        auto cached = g_credCache.byPath.find(path);
+        if (cached != g_credCache.byPath.end() && cached->second.stamp == stamp) {
+            resp.credentials = cached->second.credentials;
+            resp.success = true;
+            return resp;
+        }
+    }
+
     auto content = ReadFileUtf8(path);
 
     if (content.empty()) {
@@ -41,12 +139,13 @@ ApiResponse ReadCredentials()
     }
 
     try {
-        auto j = json::parse(content);
+        auto j = PollJson::parse(content);
         auto& oauth = j.at("claudeAiOauth");
-        resp.credentials.accessToken = oauth.at("accessToken").get<std::string>();
-        resp.credentials.refreshToken = oauth.at("refreshToken").get<std::string>();
+        resp.credentials.accessToken = ToStdString(oauth.at("accessToken"));
+        resp.credentials.refreshToken = ToStdString(oauth.at("refreshToken"));
         resp.credentials.expiresAt = oauth.at("expiresAt").get<int64_t>();
         resp.success = true;
+        StoreCachedCredentials(path, stamp, resp.credentials);
     } catch (const json::exception& e) {
         resp.error = std::string("JSON parse error: ") + e.what();
     }
@@ -54,125 +153,320 @@ ApiResponse ReadCredentials()
     return resp;
 }
 
+int64_t ParseIsoUtc(const char* isoTimestamp)
+{
+    if (!isoTimestamp || !*isoTimestamp) return 0;
+
+    std::tm tm = {};
+    if (sscanf_s(isoTimestamp, "%d-%d-%dT%d:%d:%d",
+            &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+        return -1;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+
+    return UtcFromTm(tm);
+}
+
 bool IsTokenExpired(const Credentials& creds)
 {
     auto nowMs = static_cast<int64_t>(time(nullptr)) * 1000;
     return creds.expiresAt <= (nowMs + kTokenExpiryBufferMs);
 }
 
+int64_t MsUntilTokenRefresh(const Credentials& creds)
+{
+    auto nowMs = static_cast<int64_t>(time(nullptr)) * 1000;
+    if (creds.expiresAt == INT64_MAX) return INT64_MAX;
+    return creds.expiresAt - kTokenExpiryBufferMs - nowMs;
+}
+
 static const wchar_t* kRefreshHost = L"platform.claude.com";
 static const wchar_t* kRefreshPath = L"/v1/oauth/token";
 static const char* kClientId = "9d1c250a-e61b-44d9-88ed-5944d1962f5e";
-static const DWORD kTimeoutMs = 10000;
 
-struct HttpResponse {
-    bool success = false;
-    int statusCode = 0;
-    std::string body;
-    std::string error;
-};
+static std::string DescribeFailure(const char* prefix, const HttpResponse& http)
+{
+    std::string error = prefix;
+    if (http.error.empty()) error += "HTTP " + std::to_string(http.statusCode);
+    else error.append(http.error.data(), http.error.size());
+    return error;
+}
 
-static HttpResponse HttpRequest(
+static struct {
+    std::mutex mutex;
+    std::shared_ptr<HttpRecorder> recorder;
+    std::shared_ptr<HttpReplay> replay;
+    HttpTraceRing recent;
+} g_trace;
+
+static std::shared_ptr<HttpRecorder> ActiveRecorder()
+{
+    std::lock_guard<std::mutex> lock(g_trace.mutex);
+    return g_trace.recorder;
+}
+
+static std::shared_ptr<HttpReplay> ActiveReplay()
+{
+    std::lock_guard<std::mutex> lock(g_trace.mutex);
+    return g_trace.replay;
+}
+
+bool EnableHttpRecording(const std::wstring& path)
+{
+    auto recorder = std::make_shared<HttpRecorder>();
+    if (!recorder->Open(path)) return false;
+    std::lock_guard<std::mutex> lock(g_trace.mutex);
+    g_trace.recorder = std::move(recorder);
+    return true;
+}
+
+bool EnableHttpReplay(const std::wstring& path, double timeScale)
+{
+    auto replay = std::make_shared<HttpReplay>();
+    if (!replay->Load(path)) return false;
+    replay->SetTimeScale(timeScale);
+    std::lock_guard<std::mutex> lock(g_trace.mutex);
+    g_trace.replay = std::move(replay);
+    return true;
+}
+
+void DisableHttpTrace()
+{
+    std::lock_guard<std::mutex> lock(g_trace.mutex);
+    g_trace.recorder.reset();
+    g_trace.replay.reset();
+}
+
+bool IsHttpReplayActive()
+{
+    return ActiveReplay() != nullptr;
+}
+
+bool DumpRecentHttpTrace(const std::wstring& path)
+{
+    return g_trace.recent.Dump(path);
+}
+
+// Reuses out's capacity, for the trace scratch exchange.
+static void AssignAscii(std::string& out, const wchar_t* s)
+{
+    out.clear();
+    if (s) {
+        for (; *s; ++s) out.push_back(static_cast<char>(*s));
+    }
+}
+
+static std::string NarrowAscii(const wchar_t* s)
+{
+    std::string out;
+    AssignAscii(out, s);
+    return out;
+}
+
+static HedgePolicy g_hedge;
+
+// Idempotent requests may be duplicated once they outlast the recent p95;
+// a duplicate that fails to get any HTTP response never wins the race.
+static HttpResponse SendRequest(
     const wchar_t* host,
     const wchar_t* path,
     const wchar_t* method,
     const wchar_t* headers,
-    const std::string& body)
+    std::string_view body,
+    bool captureHeaders,
+    bool hedge)
 {
-    HttpResponse resp;
+    if (!hedge) {
+        ChargeApiCall();
+        return SendHttpsRequest(host, path, method, headers, body, captureHeaders);
+    }
 
-    HINTERNET hSession = WinHttpOpen(L"claude-usage-taskbar/1.0",
-        WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, nullptr, nullptr, 0);
-    if (!hSession) { resp.error = "WinHttpOpen failed"; return resp; }
+    g_hedge.SetBudget(Settings::Instance().Get()->hedgeBudgetPct / 100.0);
+    return RunHedged<HttpResponse>(g_hedge,
+        [&](HedgeCancel& cancel) {
+            ChargeApiCall();
+            return SendHttpsRequest(host, path, method, headers, body, captureHeaders, kHttpTimeoutMs, &cancel);
+        },
+        [](const HttpResponse& resp) { return resp.statusCode != 0; });
+}
 
-    WinHttpSetTimeouts(hSession, kTimeoutMs, kTimeoutMs, kTimeoutMs, kTimeoutMs);
+HedgeStats GetHedgeStats()
+{
+    return g_hedge.GetStats();
+}
 
-    HINTERNET hConnect = WinHttpConnect(hSession, host, INTERNET_DEFAULT_HTTPS_PORT, 0);
-    if (!hConnect) {
-        resp.error = "WinHttpConnect failed";
-        WinHttpCloseHandle(hSession);
+static HttpResponse HttpRequest(
+    const wchar_t* host,
+    const wchar_t* path,
+    const wchar_t* method,
+    const wchar_t* headers,
+    std::string_view body,
+    bool hedge = false)
+{
+    if (auto replay = ActiveReplay()) {
+        HttpResponse resp;
+        HttpExchange ex;
+        if (!replay->Next(NarrowAscii(method), NarrowAscii(host), NarrowAscii(path), ex)) {
+            resp.error = "Replay trace has no exchange for " + NarrowAscii(path);
+            return resp;
+        }
+        resp.statusCode = ex.statusCode;
+        resp.headers.assign(ex.responseHeaders.data(), ex.responseHeaders.size());
+        resp.body.assign(ex.responseBody.data(), ex.responseBody.size());
+        resp.error.assign(ex.error.data(), ex.error.size());
+        resp.success = resp.error.empty() && resp.statusCode >= 200 && resp.statusCode < 300;
         return resp;
     }
 
-    HINTERNET hRequest = WinHttpOpenRequest(hConnect, method, path,
-        nullptr, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, WINHTTP_FLAG_SECURE);
-    if (!hRequest) {
-        resp.error = "WinHttpOpenRequest failed";
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hSession);
-        return resp;
+    // Every live exchange goes to the in-memory ring; response headers are
+    // only fetched while a recording wants them. The scratch exchange keeps
+    // its capacity between requests on this thread.
+    auto recorder = ActiveRecorder();
+    thread_local HttpExchange ex;
+    ex.startMs = TraceClockMs();
+    auto resp = SendRequest(host, path, method, headers, body, recorder != nullptr, hedge);
+    ex.durationMs = TraceClockMs() - ex.startMs;
+    AssignAscii(ex.method, method);
+    AssignAscii(ex.host, host);
+    AssignAscii(ex.path, path);
+    AssignAscii(ex.requestHeaders, headers);
+    ex.requestBody.assign(body.data(), body.size());
+    ex.statusCode = resp.statusCode;
+    ex.responseHeaders.assign(resp.headers.data(), resp.headers.size());
+    ex.responseBody.assign(resp.body.data(), resp.body.size());
+    ex.error.assign(resp.error.data(), resp.error.size());
+    g_trace.recent.Append(ex);
+    if (recorder) recorder->Append(ex);
+    return resp;
+}
+
+static const uint64_t kCredentialsLockWaitMs = 5000;
+static const uint64_t kCredentialsLockStaleMs = 10000;
+
+// mkdir-style advisory lock on "<credentials>.lock", the convention used by
+// Node's proper-lockfile, so a refresh here and one by the CLI serialize.
+// Like proper-lockfile, the holder touches the directory every half stale
+// period, so a slow refresh is never mistaken for an abandoned lock.
+class CredentialsLock {
+public:
+    explicit CredentialsLock(const std::wstring& credentialsPath)
+        : m_path(credentialsPath + L".lock")
+    {
+        auto deadline = TickMs() + kCredentialsLockWaitMs;
+        for (;;) {
+            bool exists;
+            if (MakeDirectory(m_path, exists)) {
+                m_held = true;
+                StartHeartbeat();
+                return;
+            }
+            if (!exists || TickMs() >= deadline) return;
+            if (IsStale()) {
+                RemoveEmptyDirectory(m_path);
+                continue;
+            }
+            SleepMs(50);
+        }
     }
 
-    if (headers) {
-        WinHttpAddRequestHeaders(hRequest, headers, static_cast<DWORD>(-1), WINHTTP_ADDREQ_FLAG_ADD);
+    ~CredentialsLock()
+    {
+        if (m_heartbeat >= 0) Scheduler::Shared().Remove(m_heartbeat);
+        if (m_held) RemoveEmptyDirectory(m_path);
     }
 
-    BOOL sent = WinHttpSendRequest(hRequest,
-        WINHTTP_NO_ADDITIONAL_HEADERS, 0,
-        body.empty() ? WINHTTP_NO_REQUEST_DATA : const_cast<char*>(body.c_str()),
-        static_cast<DWORD>(body.size()),
-        static_cast<DWORD>(body.size()), 0);
-
-    if (!sent || !WinHttpReceiveResponse(hRequest, nullptr)) {
-        resp.error = "HTTP request failed (error " + std::to_string(GetLastError()) + ")";
-        WinHttpCloseHandle(hRequest);
-        WinHttpCloseHandle(hConnect);
-        WinHttpCloseHandle(hSession);
-        return resp;
+    CredentialsLock(const CredentialsLock&) = delete;
+    CredentialsLock& operator=(const CredentialsLock&) = delete;
+
+    bool Held() const { return m_held; }
+
+private:
+    bool IsStale() const
+    {
+        uint64_t ageMs;
+        return GetFileAgeMs(m_path, ageMs) && ageMs > kCredentialsLockStaleMs;
     }
 
-    DWORD statusCode = 0;
-    DWORD size = sizeof(statusCode);
-    WinHttpQueryHeaders(hRequest,
-        WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
-        nullptr, &statusCode, &size, nullptr);
-    resp.statusCode = static_cast<int>(statusCode);
-
-    std::string responseBody;
-    DWORD bytesAvailable = 0;
-    while (WinHttpQueryDataAvailable(hRequest, &bytesAvailable) && bytesAvailable > 0) {
-        std::vector<char> buf(bytesAvailable);
-        DWORD bytesRead = 0;
-        WinHttpReadData(hRequest, buf.data(), bytesAvailable, &bytesRead);
-        responseBody.append(buf.data(), bytesRead);
+    void StartHeartbeat()
+    {
+        auto& scheduler = Scheduler::Shared();
+        m_heartbeat = scheduler.Add(TaskPriority::High, [this] {
+            TouchFile(m_path);
+            Scheduler::Shared().ScheduleIn(m_heartbeat, kCredentialsLockStaleMs / 2);
+        });
+        scheduler.ScheduleIn(m_heartbeat, kCredentialsLockStaleMs / 2);
     }
-    resp.body = responseBody;
-    resp.success = (statusCode >= 200 && statusCode < 300);
 
-    WinHttpCloseHandle(hRequest);
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
-    return resp;
-}
+    std::wstring m_path;
+    bool m_held = false;
+    Scheduler::TaskId m_heartbeat = -1;
+};
 
 static bool WriteCredentialsFile(const Credentials& creds)
 {
-    auto path = GetCredentialsPath();
+    auto& path = GetCredentialsPath();
     auto content = ReadFileUtf8(path);
     if (content.empty()) return false;
 
-    try {
-        auto j = json::parse(content);
-        j["claudeAiOauth"]["accessToken"] = creds.accessToken;
-        j["claudeAiOauth"]["refreshToken"] = creds.refreshToken;
-        j["claudeAiOauth"]["expiresAt"] = creds.expiresAt;
+    std::string patched;
+    if (!PatchOAuthCredentials(content, creds, patched)) {
+        try {
+            auto j = PollJson::parse(content);
+            j["claudeAiOauth"]["accessToken"] = ToPollString(creds.accessToken);
+            j["claudeAiOauth"]["refreshToken"] = ToPollString(creds.refreshToken);
+            j["claudeAiOauth"]["expiresAt"] = creds.expiresAt;
+            auto dumped = j.dump();
+            patched.assign(dumped.data(), dumped.size());
+        } catch (const json::exception&) {
+            return false;
+        }
+    }
 
-        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    auto tmpPath = path + L".tmp" + std::to_wstring(CurrentProcessId());
+    {
+        std::ofstream file(NativePath(tmpPath), std::ios::binary | std::ios::trunc);
         if (!file.is_open()) return false;
-        file << j.dump();
-        return true;
-    } catch (...) {
+        file << patched;
+        if (!file.good()) {
+            file.close();
+            RemoveFile(tmpPath);
+            return false;
+        }
+    }
+    if (!ReplaceFileAtomically(tmpPath, path, true)) {
+        RemoveFile(tmpPath);
         return false;
     }
+    StoreCachedCredentials(path, GetFileStamp(path), creds);
+    return true;
 }
 
 ApiResponse RefreshToken(const Credentials& creds)
 {
     ApiResponse resp;
+    bool replay = IsHttpReplayActive();
+    CredentialsLock lock(GetCredentialsPath());
+
+    // The CLI may have rotated the token while we waited; reuse its result
+    // rather than spending (and invalidating) the refresh token again.
+    InvalidateCredentialsCache();
+    auto onDisk = ReadCredentials();
+    if (onDisk.success && !IsTokenExpired(onDisk.credentials)
+        && (onDisk.credentials.accessToken != creds.accessToken
+            || onDisk.credentials.refreshToken != creds.refreshToken))
+        return onDisk;
+
+    // Spending the refresh token outside the lock could race the CLI's own
+    // refresh and leave one of us holding a revoked token; try again later.
+    if (!lock.Held()) {
+        resp.error = "Token refresh deferred: the credentials file is locked by another process";
+        return resp;
+    }
+    auto& refreshToken = onDisk.success ? onDisk.credentials.refreshToken : creds.refreshToken;
 
-    json body;
+    PollJson body;
     body["grant_type"] = "refresh_token";
-    body["refresh_token"] = creds.refreshToken;
+    body["refresh_token"] = ToPollString(refreshToken);
     body["client_id"] = kClientId;
     body["scope"] = "user:profile user:inference user:sessions:claude_code user:mcp_servers";
 
@@ -180,21 +474,21 @@ ApiResponse RefreshToken(const Credentials& creds)
         L"Content-Type: application/json", body.dump());
 
     if (!http.success) {
-        resp.error = "Token refresh failed: " + (http.error.empty()
-            ? ("HTTP " + std::to_string(http.statusCode))
-            : http.error);
+        resp.error = DescribeFailure("Token refresh failed: ", http);
         return resp;
     }
 
     try {
-        auto j = json::parse(http.body);
-        resp.credentials.accessToken = j.at("access_token").get<std::string>();
-        resp.credentials.refreshToken = j.value("refresh_token", creds.refreshToken);
+        auto j = PollJson::parse(http.body);
+        resp.credentials.accessToken = ToStdString(j.at("access_token"));
+        auto rotated = j.find("refresh_token");
+        resp.credentials.refreshToken = rotated != j.end() ? ToStdString(*rotated) : refreshToken;
         auto expiresIn = j.at("expires_in").get<int64_t>();
         resp.credentials.expiresAt = static_cast<int64_t>(time(nullptr)) * 1000 + expiresIn * 1000;
         resp.success = true;
 
-        WriteCredentialsFile(resp.credentials);
+        if (!replay)
+            WriteCredentialsFile(resp.credentials);
     } catch (const json::exception& e) {
         resp.error = std::string("Refresh response parse error: ") + e.what();
     }
@@ -209,41 +503,43 @@ ApiResponse FetchUsage(const Credentials& creds)
 {
     ApiResponse resp;
 
-    std::wstring headers = L"Authorization: Bearer ";
-    std::wstring wToken(creds.accessToken.begin(), creds.accessToken.end());
-    headers += wToken;
+    PollWString headers = L"Authorization: Bearer ";
+    headers.append(creds.accessToken.begin(), creds.accessToken.end());
     headers += L"\r\nanthropic-beta: oauth-2025-04-20";
 
-    auto http = HttpRequest(kUsageHost, kUsagePath, L"GET", headers.c_str(), {});
+    auto http = HttpRequest(kUsageHost, kUsagePath, L"GET", headers.c_str(), {}, true);
 
     if (!http.success) {
-        resp.error = "Usage fetch failed: " + (http.error.empty()
-            ? ("HTTP " + std::to_string(http.statusCode))
-            : http.error);
+        resp.error = DescribeFailure("Usage fetch failed: ", http);
         return resp;
     }
 
     try {
-        auto j = json::parse(http.body);
-
-        auto safeDouble = [](const json& v) { return v.is_number() ? v.get<double>() : 0.0; };
-        auto safeString = [](const json& v) { return v.is_string() ? v.get<std::string>() : std::string{}; };
+        auto j = PollJson::parse(http.body);
 
-        if (j.contains("five_hour") && j["five_hour"].is_object()) {
-            auto& fh = j["five_hour"];
-            resp.usage.fiveHourPct = safeDouble(fh.value("utilization", json()));
-            resp.usage.fiveHourResetsAt = safeString(fh.value("resets_at", json()));
+        if (!j.is_object()) {
+            resp.error = "Usage response parse error: not an object";
+            return resp;
         }
 
-        if (j.contains("seven_day") && j["seven_day"].is_object()) {
-            auto& sd = j["seven_day"];
-            resp.usage.sevenDayPct = safeDouble(sd.value("utilization", json()));
-            resp.usage.sevenDayResetsAt = safeString(sd.value("resets_at", json()));
+        for (auto& [key, value] : j.items()) {
+            if (!value.is_object()) continue;
+            // Windows the plan does not meter come back with a null
+            // utilization; showing them as 0% would be misleading.
+            auto util = value.find("utilization");
+            if (util == value.end() || !util->is_number()) continue;
+            auto resets = value.find("resets_at");
+
+            auto* window = resp.usage.Add(key.c_str());
+            if (!window) continue;
+            window->pct = util->get<double>();
+            if (resets != value.end() && resets->is_string())
+                window->resetsAt = ParseIsoUtc(resets->get_ref<const PollString&>().c_str());
         }
 
         resp.success = true;
 
-        if (!j.contains("five_hour") || !j.contains("seven_day")) {
+        if (!resp.usage.Find("five_hour") || !resp.usage.Find("seven_day")) {
             resp.error = "Partial data: some usage fields missing (unsupported plan?)";
         }
     } catch (const json::exception& e) {
@@ -256,9 +552,15 @@ ApiResponse FetchUsage(const Credentials& creds)
 ApiResponse FetchUsageWithAutoRefresh()
 {
     auto credResult = ReadCredentials();
+    if (!credResult.success && IsHttpReplayActive()) {
+        credResult.credentials.accessToken = "<replay>";
+        credResult.credentials.refreshToken = "<replay>";
+        credResult.credentials.expiresAt = INT64_MAX;
+        credResult.success = true;
+    }
     if (!credResult.success) return credResult;
 
-    auto creds = credResult.credentials;
+    auto creds = std::move(credResult.credentials);
 
     if (IsTokenExpired(creds)) {
         auto refreshResult = RefreshToken(creds);
@@ -276,3 +578,23 @@ ApiResponse FetchUsageWithAutoRefresh()
 
     return usageResult;
 }
+
+void PrewarmConnections()
+{
+    if (IsHttpReplayActive()) return;
+
+    auto warm = [](const wchar_t* host) {
+        SendHttpsRequest(host, L"/", L"HEAD", nullptr, {}, false);
+    };
+    auto refreshHost = std::async(std::launch::async, warm, kRefreshHost);
+    warm(kUsageHost);
+    refreshHost.wait();
+}
+
+bool ProbeReachability(int timeoutMs)
+{
+    if (IsHttpReplayActive()) return true;
+    // Any HTTP status proves DNS, routing and TLS all work.
+    auto resp = SendHttpsRequest(kUsageHost, L"/", L"HEAD", nullptr, {}, false, static_cast<uint32_t>(timeoutMs));
+    return resp.statusCode != 0;
+}
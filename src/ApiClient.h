@@ -2,6 +2,9 @@
 
 #include <string>
 #include <cstdint>
+#include <cstring>
+#include "Hedge.h"
+#include "HttpTransport.h"
 
 struct Credentials {
     std::string accessToken;
@@ -9,11 +12,36 @@ struct Credentials {
     int64_t expiresAt = 0;
 };
 
+constexpr int kMaxUsageWindows = 8;
+constexpr size_t kUsageWindowKeyLen = 40;
+
+struct UsageWindow {
+    char key[kUsageWindowKeyLen] = {};
+    double pct = 0.0;
+    int64_t resetsAt = 0;
+};
+
+// Every window object in the usage response ("five_hour", "seven_day",
+// per-model limits, ...) lands in one flat, fixed-capacity table.
 struct UsageResult {
-    double fiveHourPct = 0.0;
-    double sevenDayPct = 0.0;
-    std::string fiveHourResetsAt;
-    std::string sevenDayResetsAt;
+    UsageWindow windows[kMaxUsageWindows];
+    int count = 0;
+
+    const UsageWindow* Find(const char* key) const
+    {
+        for (int i = 0; i < count; ++i)
+            if (strcmp(windows[i].key, key) == 0) return &windows[i];
+        return nullptr;
+    }
+
+    UsageWindow* Add(const char* key)
+    {
+        if (count >= kMaxUsageWindows || strlen(key) >= kUsageWindowKeyLen) return nullptr;
+        auto& w = windows[count++];
+        w = UsageWindow{};
+        memcpy(w.key, key, strlen(key) + 1);
+        return &w;
+    }
 };
 
 struct ApiResponse {
@@ -23,8 +51,42 @@ struct ApiResponse {
     UsageResult usage;
 };
 
+int64_t ParseIsoUtc(const char* isoTimestamp);
+inline int64_t ParseIsoUtc(const std::string& isoTimestamp) { return ParseIsoUtc(isoTimestamp.c_str()); }
+
+const std::wstring& GetCredentialsPath();
+
+// Points GetCredentialsPath() at another file on this thread while alive, so
+// one process can poll several accounts. An empty path changes nothing.
+class CredentialsPathScope {
+public:
+    explicit CredentialsPathScope(const std::wstring& path);
+    ~CredentialsPathScope();
+    CredentialsPathScope(const CredentialsPathScope&) = delete;
+    CredentialsPathScope& operator=(const CredentialsPathScope&) = delete;
+
+private:
+    const std::wstring* m_previous;
+};
+
 ApiResponse ReadCredentials();
+void InvalidateCredentialsCache();
+bool HasCredentialsFileChanged();
 bool IsTokenExpired(const Credentials& creds);
+int64_t MsUntilTokenRefresh(const Credentials& creds);
 ApiResponse RefreshToken(const Credentials& creds);
 ApiResponse FetchUsage(const Credentials& creds);
 ApiResponse FetchUsageWithAutoRefresh();
+
+void PrewarmConnections();
+HedgeStats GetHedgeStats();
+// A short HEAD to the usage host; false when it cannot be reached at all.
+bool ProbeReachability(int timeoutMs);
+
+bool EnableHttpRecording(const std::wstring& path);
+bool EnableHttpReplay(const std::wstring& path, double timeScale);
+void DisableHttpTrace();
+bool IsHttpReplayActive();
+// Writes the most recent live exchanges, tokens redacted, in the RecordTrace
+// format. Replayed exchanges are not kept.
+bool DumpRecentHttpTrace(const std::wstring& path);
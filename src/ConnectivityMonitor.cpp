@@ -0,0 +1,187 @@
+#include "ConnectivityMonitor.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#endif
+
+void ConnectivityMonitor::Report(bool online)
+{
+    Callback callback;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_lastState == static_cast<int>(online)) return;
+        m_lastState = online;
+        callback = m_onChange;
+    }
+    if (callback) callback(online);
+}
+
+#ifdef _WIN32
+
+using NotifyHintChangeFn = decltype(&NotifyNetworkConnectivityHintChange);
+
+// Windows 10 2004 and later; older builds fall back to assuming online.
+static NotifyHintChangeFn LoadNotifyHintChange()
+{
+    HMODULE iphlpapi = GetModuleHandleW(L"iphlpapi.dll");
+    if (!iphlpapi) return nullptr;
+    return reinterpret_cast<NotifyHintChangeFn>(GetProcAddress(iphlpapi, "NotifyNetworkConnectivityHintChange"));
+}
+
+VOID WINAPI ConnectivityMonitor::OnHint(PVOID context, NL_NETWORK_CONNECTIVITY_HINT hint)
+{
+    auto level = hint.ConnectivityLevel;
+    bool online = level != NetworkConnectivityLevelHintNone
+        && level != NetworkConnectivityLevelHintLocalAccess
+        && level != NetworkConnectivityLevelHintConstrainedInternetAccess;
+    static_cast<ConnectivityMonitor*>(context)->Report(online);
+}
+
+bool ConnectivityMonitor::Start(Callback onChange)
+{
+    Stop();
+
+    auto notifyHintChange = LoadNotifyHintChange();
+    if (!notifyHintChange) return false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_onChange = std::move(onChange);
+        m_lastState = -1;
+    }
+    if (notifyHintChange(&ConnectivityMonitor::OnHint, this, TRUE, &m_notify) != NO_ERROR) {
+        m_notify = nullptr;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_onChange = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void ConnectivityMonitor::Stop()
+{
+    if (m_notify) {
+        // Returns once any callback in progress has finished.
+        CancelMibChangeNotify2(m_notify);
+        m_notify = nullptr;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_onChange = nullptr;
+}
+
+bool ConnectivityMonitor::IsRunning() const
+{
+    return m_notify != nullptr;
+}
+
+#else
+
+static bool HasDefaultRoute()
+{
+    std::ifstream v4("/proc/net/route");
+    std::string line;
+    std::getline(v4, line);
+    while (std::getline(v4, line)) {
+        std::istringstream fields(line);
+        std::string iface, destination, gateway;
+        unsigned flags = 0;
+        fields >> iface >> destination >> gateway >> std::hex >> flags;
+        if (destination == "00000000" && (flags & 0x1)) return true;
+    }
+
+    // dest, dest prefix, src, src prefix, next hop, metric, refs, use, flags, iface
+    std::ifstream v6("/proc/net/ipv6_route");
+    while (std::getline(v6, line)) {
+        std::istringstream fields(line);
+        std::string destination, prefix, skip, iface;
+        unsigned flags = 0;
+        fields >> destination >> prefix >> skip >> skip >> skip >> skip >> skip >> skip >> std::hex >> flags >> iface;
+        if (prefix == "00" && destination == std::string(32, '0') && iface != "lo" && (flags & 0x1)) return true;
+    }
+    return false;
+}
+
+bool ConnectivityMonitor::Start(Callback onChange)
+{
+    Stop();
+
+    m_socket = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (m_socket < 0) return false;
+
+    sockaddr_nl addr = {};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR | RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+    if (bind(m_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || pipe2(m_stopPipe, O_CLOEXEC) != 0) {
+        Stop();
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_onChange = std::move(onChange);
+        m_lastState = -1;
+    }
+    Report(HasDefaultRoute());
+    m_thread = std::thread(&ConnectivityMonitor::WatchLoop, this);
+    return true;
+}
+
+void ConnectivityMonitor::WatchLoop()
+{
+    char buf[8192];
+    for (;;) {
+        pollfd fds[2] = {{m_socket, POLLIN, 0}, {m_stopPipe[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) continue;
+        if (fds[1].revents) return;
+        short events = fds[0].revents;
+        if (!events) continue;
+
+        // One route change arrives as a burst; re-check once per burst. A
+        // receive-buffer overrun raises POLLERR and fails one recv with
+        // ENOBUFS; messages were lost, so keep draining and re-check anyway.
+        if (events & POLLERR) {
+            int error = 0;
+            socklen_t len = sizeof(error);
+            getsockopt(m_socket, SOL_SOCKET, SO_ERROR, &error, &len);
+        }
+        for (;;) {
+            ssize_t got = recv(m_socket, buf, sizeof(buf), MSG_DONTWAIT);
+            if (got > 0 || (got < 0 && errno == ENOBUFS)) continue;
+            break;
+        }
+        Report(HasDefaultRoute());
+        // The socket is unusable; polling it again would spin.
+        if (events & (POLLHUP | POLLNVAL)) return;
+    }
+}
+
+void ConnectivityMonitor::Stop()
+{
+    if (m_thread.joinable()) {
+        char stop = 1;
+        (void)!write(m_stopPipe[1], &stop, 1);
+        m_thread.join();
+    }
+    for (int* fd : {&m_socket, &m_stopPipe[0], &m_stopPipe[1]}) {
+        if (*fd >= 0) close(*fd);
+        *fd = -1;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_onChange = nullptr;
+}
+
+bool ConnectivityMonitor::IsRunning() const
+{
+    return m_thread.joinable();
+}
+
+#endif
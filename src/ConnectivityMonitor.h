@@ -0,0 +1,49 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <winsock2.h>
+#include <ws2ipdef.h>
+#include <iphlpapi.h>
+#include <netioapi.h>
+#else
+#include <thread>
+#endif
+
+// Reports internet connectivity: once with the current state when started,
+// then on every change. On Windows the signal is the network connectivity
+// hint (none, local-only and captive-portal count as offline); elsewhere a
+// netlink listener tracks whether a default route exists. The callback runs
+// on a system or monitor thread. Without a platform signal Start() fails and
+// the caller should assume it is online.
+class ConnectivityMonitor {
+public:
+    using Callback = std::function<void(bool online)>;
+
+    ~ConnectivityMonitor() { Stop(); }
+
+    bool Start(Callback onChange);
+    void Stop();
+    bool IsRunning() const;
+
+private:
+    void Report(bool online);
+
+    std::mutex m_mutex;
+    Callback m_onChange;
+    int m_lastState = -1;
+
+#ifdef _WIN32
+    static VOID WINAPI OnHint(PVOID context, NL_NETWORK_CONNECTIVITY_HINT hint);
+    HANDLE m_notify = nullptr;
+#else
+    void WatchLoop();
+    std::thread m_thread;
+    int m_socket = -1;
+    int m_stopPipe[2] = {-1, -1};
+#endif
+};
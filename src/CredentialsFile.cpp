@@ -0,0 +1,113 @@
+#include "CredentialsFile.h"
+
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cstring>
+
+using json = nlohmann::json;
+
+static void SkipWhitespace(std::string_view s, size_t& i)
+{
+    while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n')) ++i;
+}
+
+static bool SkipString(std::string_view s, size_t& i)
+{
+    if (i >= s.size() || s[i] != '"') return false;
+    for (++i; i < s.size(); ++i) {
+        if (s[i] == '\\') ++i;
+        else if (s[i] == '"') { ++i; return true; }
+    }
+    return false;
+}
+
+static bool SkipValue(std::string_view s, size_t& i)
+{
+    SkipWhitespace(s, i);
+    if (i >= s.size()) return false;
+    if (s[i] == '"') return SkipString(s, i);
+
+    if (s[i] == '{' || s[i] == '[') {
+        int depth = 0;
+        while (i < s.size()) {
+            char c = s[i];
+            if (c == '"') {
+                if (!SkipString(s, i)) return false;
+                continue;
+            }
+            if (c == '{' || c == '[') ++depth;
+            else if (c == '}' || c == ']') {
+                ++i;
+                if (--depth == 0) return true;
+                continue;
+            }
+            ++i;
+        }
+        return false;
+    }
+
+    size_t start = i;
+    while (i < s.size() && s[i] != ',' && s[i] != '}' && s[i] != ']'
+        && s[i] != ' ' && s[i] != '\t' && s[i] != '\r' && s[i] != '\n') ++i;
+    return i > start;
+}
+
+// Locates the value of `key` among the direct members of the object at `obj`.
+static bool FindMember(std::string_view s, size_t obj, const char* key, size_t& begin, size_t& end)
+{
+    size_t i = obj;
+    SkipWhitespace(s, i);
+    if (i >= s.size() || s[i] != '{') return false;
+    ++i;
+
+    size_t keyLen = strlen(key);
+    for (;;) {
+        SkipWhitespace(s, i);
+        if (i >= s.size() || s[i] == '}') return false;
+
+        size_t nameStart = i;
+        if (!SkipString(s, i)) return false;
+        bool match = i - nameStart == keyLen + 2 && s.compare(nameStart + 1, keyLen, key) == 0;
+
+        SkipWhitespace(s, i);
+        if (i >= s.size() || s[i] != ':') return false;
+        ++i;
+        SkipWhitespace(s, i);
+
+        size_t valueStart = i;
+        if (!SkipValue(s, i)) return false;
+        if (match) {
+            begin = valueStart;
+            end = i;
+            return true;
+        }
+
+        SkipWhitespace(s, i);
+        if (i < s.size() && s[i] == ',') ++i;
+    }
+}
+
+bool PatchOAuthCredentials(std::string_view content, const Credentials& creds, std::string& out)
+{
+    size_t oauthBegin, oauthEnd;
+    if (!FindMember(content, 0, "claudeAiOauth", oauthBegin, oauthEnd)) return false;
+
+    struct Edit {
+        size_t begin, end;
+        std::string value;
+    } edits[3] = {
+        {0, 0, json(creds.accessToken).dump()},
+        {0, 0, json(creds.refreshToken).dump()},
+        {0, 0, std::to_string(creds.expiresAt)},
+    };
+    const char* keys[3] = {"accessToken", "refreshToken", "expiresAt"};
+    for (int k = 0; k < 3; ++k) {
+        if (!FindMember(content, oauthBegin, keys[k], edits[k].begin, edits[k].end)) return false;
+    }
+
+    std::sort(std::begin(edits), std::end(edits), [](const Edit& a, const Edit& b) { return a.begin > b.begin; });
+    out.assign(content.data(), content.size());
+    for (auto& e : edits)
+        out.replace(e.begin, e.end - e.begin, e.value);
+    return true;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "ApiClient.h"
+#include <string>
+#include <string_view>
+
+// Rewrites only the accessToken, refreshToken and expiresAt values inside the
+// top-level "claudeAiOauth" object, leaving every other byte untouched.
+// Returns false if the document does not have that shape.
+bool PatchOAuthCredentials(std::string_view content, const Credentials& creds, std::string& out);
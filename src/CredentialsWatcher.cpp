@@ -0,0 +1,191 @@
+#include "CredentialsWatcher.h"
+
+#ifndef _WIN32
+#include "Platform.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+#ifdef _WIN32
+
+static const DWORD kNotifyFilter = FILE_NOTIFY_CHANGE_FILE_NAME
+    | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+
+bool CredentialsWatcher::Start(const std::wstring& filePath, Callback onChange)
+{
+    Stop();
+
+    auto slash = filePath.find_last_of(L"\\/");
+    if (slash == std::wstring::npos) return false;
+    auto dir = filePath.substr(0, slash);
+    m_fileName = filePath.substr(slash + 1);
+
+    m_dir = CreateFileW(dir.c_str(), FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (m_dir == INVALID_HANDLE_VALUE) return false;
+
+    m_event = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    m_path = filePath;
+    m_onChange = std::move(onChange);
+
+    if (!m_event || !Arm()
+        || !RegisterWaitForSingleObject(&m_wait, m_event, OnSignaled, this, INFINITE, WT_EXECUTEDEFAULT)) {
+        Stop();
+        return false;
+    }
+    return true;
+}
+
+void CredentialsWatcher::Stop()
+{
+    if (m_wait) {
+        UnregisterWaitEx(m_wait, INVALID_HANDLE_VALUE);
+        m_wait = nullptr;
+    }
+    if (m_dir != INVALID_HANDLE_VALUE) {
+        DWORD bytes = 0;
+        if (CancelIoEx(m_dir, &m_overlapped))
+            GetOverlappedResult(m_dir, &m_overlapped, &bytes, TRUE);
+        CloseHandle(m_dir);
+        m_dir = INVALID_HANDLE_VALUE;
+    }
+    if (m_event) {
+        CloseHandle(m_event);
+        m_event = nullptr;
+    }
+    m_path.clear();
+    m_onChange = nullptr;
+    m_failed = false;
+}
+
+bool CredentialsWatcher::IsRunning() const
+{
+    return m_dir != INVALID_HANDLE_VALUE && !m_failed;
+}
+
+bool CredentialsWatcher::Arm()
+{
+    m_overlapped = {};
+    m_overlapped.hEvent = m_event;
+    return ReadDirectoryChangesW(m_dir, m_buffer, sizeof(m_buffer), FALSE,
+        kNotifyFilter, nullptr, &m_overlapped, nullptr) != FALSE;
+}
+
+bool CredentialsWatcher::MatchesFile(DWORD bytes) const
+{
+    // A zero-length completion means the buffer overflowed; assume a match.
+    if (bytes == 0) return true;
+
+    auto* base = reinterpret_cast<const BYTE*>(m_buffer);
+    for (DWORD offset = 0;;) {
+        auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(base + offset);
+        int len = static_cast<int>(info->FileNameLength / sizeof(WCHAR));
+        if (CompareStringOrdinal(info->FileName, len,
+                m_fileName.c_str(), static_cast<int>(m_fileName.size()), TRUE) == CSTR_EQUAL)
+            return true;
+        if (info->NextEntryOffset == 0) return false;
+        offset += info->NextEntryOffset;
+    }
+}
+
+VOID CALLBACK CredentialsWatcher::OnSignaled(PVOID context, BOOLEAN)
+{
+    auto* self = static_cast<CredentialsWatcher*>(context);
+
+    // A failed read (a dropped notification, the directory going away) may
+    // have hidden a change, so treat it as a match.
+    DWORD bytes = 0;
+    bool matched = !GetOverlappedResult(self->m_dir, &self->m_overlapped, &bytes, FALSE)
+        || self->MatchesFile(bytes);
+
+    // If the watch cannot be re-armed it would never signal again; report it
+    // stopped so the owner starts a new one.
+    if (!self->Arm())
+        self->m_failed = true;
+
+    if (matched && self->m_onChange)
+        self->m_onChange();
+}
+
+#else
+
+static const uint32_t kWatchMask = IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF;
+
+bool CredentialsWatcher::Start(const std::wstring& filePath, Callback onChange)
+{
+    Stop();
+
+    auto slash = filePath.find_last_of(L'/');
+    if (slash == std::wstring::npos) return false;
+    auto dir = filePath.substr(0, slash);
+    m_fileName = filePath.substr(slash + 1);
+
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify < 0 || inotify_add_watch(m_inotify, NativePath(dir).c_str(), kWatchMask) < 0
+        || pipe2(m_stopPipe, O_CLOEXEC) != 0) {
+        Stop();
+        return false;
+    }
+
+    m_path = filePath;
+    m_onChange = std::move(onChange);
+    m_thread = std::thread(&CredentialsWatcher::WatchLoop, this);
+    return true;
+}
+
+void CredentialsWatcher::WatchLoop()
+{
+    auto name = NativePath(m_fileName);
+    alignas(inotify_event) char buf[4096];
+    for (;;) {
+        pollfd fds[2] = {{m_inotify, POLLIN, 0}, {m_stopPipe[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) continue;
+        if (fds[1].revents) return;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        bool matched = false;
+        ssize_t len;
+        while ((len = read(m_inotify, buf, sizeof(buf))) > 0) {
+            for (char* p = buf; p < buf + len;) {
+                auto* event = reinterpret_cast<inotify_event*>(p);
+                // The directory was deleted, moved or unmounted: the watch is
+                // dead or points elsewhere. Report it stopped so the owner
+                // starts a new one, and let it re-read the file meanwhile.
+                if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))
+                    m_failed = true;
+                // An overflowed queue may have dropped our file; assume a match.
+                if ((event->mask & IN_Q_OVERFLOW) || m_failed || (event->len && name == event->name))
+                    matched = true;
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        if (matched && m_onChange) m_onChange();
+        if (m_failed) return;
+    }
+}
+
+void CredentialsWatcher::Stop()
+{
+    if (m_thread.joinable()) {
+        char stop = 1;
+        (void)!write(m_stopPipe[1], &stop, 1);
+        m_thread.join();
+    }
+    for (int* fd : {&m_inotify, &m_stopPipe[0], &m_stopPipe[1]}) {
+        if (*fd >= 0) close(*fd);
+        *fd = -1;
+    }
+    m_path.clear();
+    m_onChange = nullptr;
+    m_failed = false;
+}
+
+bool CredentialsWatcher::IsRunning() const
+{
+    return m_thread.joinable() && !m_failed;
+}
+
+#endif
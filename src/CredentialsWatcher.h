@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <functional>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <thread>
+#endif
+
+// Watches the directory holding the credentials file and invokes the callback
+// whenever that file is created, written or renamed into place: on a
+// thread-pool thread on Windows, on an inotify thread elsewhere. Nothing runs
+// while the directory is quiet.
+class CredentialsWatcher {
+public:
+    using Callback = std::function<void()>;
+
+    ~CredentialsWatcher() { Stop(); }
+
+    bool Start(const std::wstring& filePath, Callback onChange);
+    void Stop();
+    // False once the watch has broken and can no longer report changes.
+    bool IsRunning() const;
+    const std::wstring& GetPath() const { return m_path; }
+
+private:
+    std::wstring m_path;
+    std::wstring m_fileName;
+    Callback m_onChange;
+    std::atomic<bool> m_failed{false};
+
+#ifdef _WIN32
+    static VOID CALLBACK OnSignaled(PVOID context, BOOLEAN timedOut);
+    bool Arm();
+    bool MatchesFile(DWORD bytes) const;
+
+    HANDLE m_dir = INVALID_HANDLE_VALUE;
+    HANDLE m_event = nullptr;
+    HANDLE m_wait = nullptr;
+    OVERLAPPED m_overlapped = {};
+    DWORD m_buffer[1024] = {};
+#else
+    void WatchLoop();
+    std::thread m_thread;
+    int m_inotify = -1;
+    int m_stopPipe[2] = {-1, -1};
+#endif
+};
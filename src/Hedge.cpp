@@ -0,0 +1,176 @@
+#include "Hedge.h"
+
+#include <algorithm>
+
+bool HedgeCancel::Arm(std::function<void()> abort)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_cancelled) return false;
+    m_abort = std::move(abort);
+    return true;
+}
+
+bool HedgeCancel::Disarm()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_abort = nullptr;
+    return !m_cancelled;
+}
+
+void HedgeCancel::Cancel()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_cancelled) return;
+    m_cancelled = true;
+    if (m_abort) m_abort();
+    m_abort = nullptr;
+}
+
+bool HedgeCancel::IsCancelled()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cancelled;
+}
+
+HedgePolicy::HedgePolicy(double budgetFraction, double percentile)
+    : m_budgetFraction(budgetFraction)
+    , m_percentile(percentile)
+{
+    m_latencies.reserve(kWindow);
+}
+
+void HedgePolicy::SetBudget(double budgetFraction)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budgetFraction = budgetFraction;
+}
+
+uint32_t HedgePolicy::ThresholdLocked() const
+{
+    if (m_latencies.size() < kMinSamples) return 0;
+    uint32_t sorted[kWindow];
+    std::copy(m_latencies.begin(), m_latencies.end(), sorted);
+    size_t rank = static_cast<size_t>(m_percentile * (m_latencies.size() - 1) + 0.5);
+    std::nth_element(sorted, sorted + rank, sorted + m_latencies.size());
+    return std::max(sorted[rank], kMinDelayMs);
+}
+
+uint32_t HedgePolicy::BeginRequest()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_stats.requests;
+    m_tokens = std::min(m_tokens + m_budgetFraction, kMaxBankedHedges);
+    m_stats.thresholdMs = ThresholdLocked();
+    return m_budgetFraction > 0.0 ? m_stats.thresholdMs : 0;
+}
+
+bool HedgePolicy::CanHedge()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_tokens >= 1.0;
+}
+
+bool HedgePolicy::TryHedge()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_tokens < 1.0) {
+        ++m_stats.budgetDenied;
+        return false;
+    }
+    m_tokens -= 1.0;
+    ++m_stats.hedges;
+    return true;
+}
+
+void HedgePolicy::Record(uint32_t latencyMs, bool hedgeWon, bool budgetDenied)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (hedgeWon) ++m_stats.hedgeWins;
+    if (budgetDenied) ++m_stats.budgetDenied;
+    if (m_latencies.size() < kWindow) {
+        m_latencies.push_back(latencyMs);
+    } else {
+        m_latencies[m_next] = latencyMs;
+        m_next = (m_next + 1) % kWindow;
+    }
+}
+
+HedgeStats HedgePolicy::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+HedgeHelper& HedgeHelper::Shared()
+{
+    static HedgeHelper helper;
+    return helper;
+}
+
+#ifdef _WIN32
+
+HedgeHelper::~HedgeHelper() = default;
+
+bool HedgeHelper::Post(std::function<void()> job)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_busy || !TrySubmitThreadpoolCallback(&HedgeHelper::OnWork, this, nullptr)) return false;
+    m_busy = true;
+    m_job = std::move(job);
+    return true;
+}
+
+VOID CALLBACK HedgeHelper::OnWork(PTP_CALLBACK_INSTANCE instance, PVOID context)
+{
+    CallbackMayRunLong(instance);
+    auto* self = static_cast<HedgeHelper*>(context);
+    std::function<void()> job;
+    {
+        std::lock_guard<std::mutex> lock(self->m_mutex);
+        job = std::move(self->m_job);
+        self->m_job = nullptr;
+    }
+    job();
+    std::lock_guard<std::mutex> lock(self->m_mutex);
+    self->m_busy = false;
+}
+
+#else
+
+HedgeHelper::~HedgeHelper()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    if (m_thread.joinable()) m_thread.join();
+}
+
+bool HedgeHelper::Post(std::function<void()> job)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_busy || m_stop) return false;
+    if (!m_thread.joinable()) m_thread = std::thread(&HedgeHelper::Loop, this);
+    m_busy = true;
+    m_job = std::move(job);
+    m_wake.notify_one();
+    return true;
+}
+
+void HedgeHelper::Loop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_wake.wait(lock, [this] { return m_stop || m_job; });
+        if (m_stop) return;
+        auto job = std::move(m_job);
+        m_job = nullptr;
+        lock.unlock();
+        job();
+        lock.lock();
+        m_busy = false;
+    }
+}
+
+#endif
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+struct HedgeStats {
+    uint64_t requests = 0;
+    uint64_t hedges = 0;
+    uint64_t hedgeWins = 0;
+    uint64_t budgetDenied = 0;
+    uint32_t thresholdMs = 0;
+};
+
+// Lets another thread abort an attempt that is blocked in I/O. The attempt
+// arms it with a callback that wakes or interrupts its I/O without freeing
+// anything, and disarms it before cleaning up; only the attempt ever closes
+// its own handles.
+class HedgeCancel {
+public:
+    // False when already cancelled; the attempt should give up.
+    bool Arm(std::function<void()> abort);
+    // False when the attempt was cancelled. No abort runs after this.
+    bool Disarm();
+    void Cancel();
+    bool IsCancelled();
+
+private:
+    std::mutex m_mutex;
+    std::function<void()> m_abort;
+    bool m_cancelled = false;
+};
+
+// Tracks recent latencies and decides when a duplicate request is worth
+// sending: after the observed percentile has passed, and only while the
+// budget allows. Every request earns budgetFraction of a hedge, so hedges
+// stay near that share of traffic however slow the server gets.
+class HedgePolicy {
+public:
+    static constexpr size_t kWindow = 64;
+    static constexpr size_t kMinSamples = 16;
+    static constexpr uint32_t kMinDelayMs = 50;
+    static constexpr double kMaxBankedHedges = 2.0;
+
+    explicit HedgePolicy(double budgetFraction = 0.05, double percentile = 0.95);
+
+    void SetBudget(double budgetFraction);
+    // Counts a request. Returns how long to wait before hedging it, or 0
+    // while hedging is off or there are too few samples to judge.
+    uint32_t BeginRequest();
+    // True when the budget could pay for a hedge right now.
+    bool CanHedge();
+    // Spends one hedge from the budget.
+    bool TryHedge();
+    // budgetDenied marks a request that passed the threshold while the
+    // budget was empty, so no duplicate was sent.
+    void Record(uint32_t latencyMs, bool hedgeWon, bool budgetDenied = false);
+    HedgeStats GetStats();
+
+private:
+    uint32_t ThresholdLocked() const;
+
+    std::mutex m_mutex;
+    double m_budgetFraction;
+    double m_percentile;
+    double m_tokens = 0.0;
+    std::vector<uint32_t> m_latencies;
+    size_t m_next = 0;
+    HedgeStats m_stats;
+};
+
+// Runs duplicate attempts without starting a thread per request: on the
+// system thread pool on Windows, on one long-lived thread elsewhere. One
+// duplicate runs at a time; Post refuses a job while another is running.
+class HedgeHelper {
+public:
+    static HedgeHelper& Shared();
+    ~HedgeHelper();
+
+    bool Post(std::function<void()> job);
+
+private:
+    HedgeHelper() = default;
+
+    std::mutex m_mutex;
+    std::function<void()> m_job;
+    bool m_busy = false;
+
+#ifdef _WIN32
+    static VOID CALLBACK OnWork(PTP_CALLBACK_INSTANCE instance, PVOID context);
+#else
+    void Loop();
+    std::condition_variable m_wake;
+    std::thread m_thread;
+    bool m_stop = false;
+#endif
+};
+
+// Runs attempt once and, if it is still going after the policy's threshold,
+// a duplicate on the shared HedgeHelper. The first to finish wins and the
+// other is cancelled; a duplicate that accept rejects (a fast transport
+// error, say) is dropped and the primary keeps going. Requests the budget
+// could not hedge, or that find the helper busy, never involve it. Returns
+// only after both attempts have stopped.
+template <class Result>
+Result RunHedged(HedgePolicy& policy, const std::function<Result(HedgeCancel&)>& attempt,
+    const std::function<bool(const Result&)>& accept = nullptr)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto elapsedMs = [start] {
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    };
+
+    struct Race {
+        std::mutex mutex;
+        std::condition_variable changed;
+        bool finished = false;
+        bool helperDone = false;
+        int winner = -1;
+        std::optional<Result> duplicate;
+        HedgeCancel cancel[2];
+    } race;
+
+    auto hedge = [&](uint32_t delayMs) {
+        {
+            std::unique_lock<std::mutex> lock(race.mutex);
+            if (race.changed.wait_for(lock, std::chrono::milliseconds(delayMs), [&] { return race.finished; }))
+                return;
+        }
+        if (!policy.TryHedge()) return;
+
+        Result result = attempt(race.cancel[1]);
+        if (accept && !accept(result)) return;
+        {
+            std::lock_guard<std::mutex> lock(race.mutex);
+            if (race.winner >= 0 || race.cancel[1].IsCancelled()) return;
+            race.winner = 1;
+            race.duplicate.emplace(std::move(result));
+        }
+        race.cancel[0].Cancel();
+    };
+
+    uint32_t delayMs = policy.BeginRequest();
+    bool posted = delayMs && policy.CanHedge() && HedgeHelper::Shared().Post([&, delayMs] {
+        hedge(delayMs);
+        // Notify under the lock: once helperDone is seen, race is gone.
+        std::lock_guard<std::mutex> lock(race.mutex);
+        race.helperDone = true;
+        race.changed.notify_all();
+    });
+    if (!posted) {
+        Result result = attempt(race.cancel[0]);
+        uint32_t elapsed = elapsedMs();
+        policy.Record(elapsed, false, delayMs && elapsed >= delayMs);
+        return result;
+    }
+
+    Result primary = attempt(race.cancel[0]);
+    bool primaryWon;
+    {
+        std::lock_guard<std::mutex> lock(race.mutex);
+        race.finished = true;
+        if (race.winner < 0) race.winner = 0;
+        primaryWon = race.winner == 0;
+    }
+    race.changed.notify_all();
+    if (primaryWon) race.cancel[1].Cancel();
+    {
+        std::unique_lock<std::mutex> lock(race.mutex);
+        race.changed.wait(lock, [&] { return race.helperDone; });
+    }
+
+    policy.Record(elapsedMs(), !primaryWon);
+    return primaryWon ? std::move(primary) : std::move(*race.duplicate);
+}
@@ -0,0 +1,196 @@
+#include "HttpTrace.h"
+#include "Platform.h"
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <thread>
+
+using json = nlohmann::json;
+
+static const char* kRedacted = "<redacted>";
+
+int64_t TraceClockMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string RedactHeaders(const std::string& headers)
+{
+    static const std::string kBearer = "Bearer ";
+    std::string out = headers;
+    for (size_t pos = out.find(kBearer); pos != std::string::npos; pos = out.find(kBearer, pos)) {
+        pos += kBearer.size();
+        auto end = out.find_first_of("\r\n", pos);
+        if (end == std::string::npos) end = out.size();
+        out.replace(pos, end - pos, kRedacted);
+    }
+    return out;
+}
+
+std::string RedactBody(const std::string& body)
+{
+    if (body.empty()) return body;
+    try {
+        auto j = json::parse(body);
+        bool changed = false;
+        auto redact = [&](json& obj) {
+            for (auto* key : {"access_token", "refresh_token", "accessToken", "refreshToken"}) {
+                if (obj.contains(key)) {
+                    obj[key] = kRedacted;
+                    changed = true;
+                }
+            }
+        };
+        if (j.is_object()) {
+            redact(j);
+            if (j.contains("claudeAiOauth") && j["claudeAiOauth"].is_object())
+                redact(j["claudeAiOauth"]);
+        }
+        return changed ? j.dump() : body;
+    } catch (const json::exception&) {
+        return body;
+    }
+}
+
+bool HttpRecorder::Open(const std::wstring& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_file.close();
+    m_file.open(NativePath(path), std::ios::binary | std::ios::app);
+    m_originMs = TraceClockMs();
+    return m_file.is_open();
+}
+
+void HttpRecorder::Close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_file.close();
+}
+
+bool HttpRecorder::IsOpen()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_file.is_open();
+}
+
+static std::string FormatExchange(const HttpExchange& ex, int64_t originMs)
+{
+    json line = {
+        {"t", ex.startMs - originMs}, {"d", ex.durationMs},
+        {"m", ex.method}, {"h", ex.host}, {"p", ex.path},
+        {"s", ex.statusCode},
+    };
+    if (!ex.requestHeaders.empty()) line["qh"] = RedactHeaders(ex.requestHeaders);
+    if (!ex.requestBody.empty()) line["qb"] = RedactBody(ex.requestBody);
+    if (!ex.responseHeaders.empty()) line["rh"] = RedactHeaders(ex.responseHeaders);
+    if (!ex.responseBody.empty()) line["rb"] = RedactBody(ex.responseBody);
+    if (!ex.error.empty()) line["e"] = ex.error;
+    return line.dump(-1, ' ', false, json::error_handler_t::replace);
+}
+
+void HttpRecorder::Append(HttpExchange ex)
+{
+    auto text = FormatExchange(ex, m_originMs);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file.is_open()) return;
+    m_file << text << '\n';
+    m_file.flush();
+}
+
+void HttpTraceRing::Append(const HttpExchange& exchange)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_slots[m_next] = exchange;
+    m_next = (m_next + 1) % kCapacity;
+    if (m_count < kCapacity) ++m_count;
+}
+
+bool HttpTraceRing::Dump(const std::wstring& path)
+{
+    std::vector<HttpExchange> exchanges;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < m_count; ++i)
+            exchanges.push_back(m_slots[(m_next + kCapacity - m_count + i) % kCapacity]);
+    }
+
+    std::ofstream file(NativePath(path), std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+    int64_t originMs = exchanges.empty() ? 0 : exchanges.front().startMs;
+    for (auto& ex : exchanges) file << FormatExchange(ex, originMs) << '\n';
+    return static_cast<bool>(file);
+}
+
+size_t HttpTraceRing::Size()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_count;
+}
+
+bool HttpReplay::Load(const std::wstring& path)
+{
+    std::ifstream file(NativePath(path), std::ios::binary);
+    if (!file.is_open()) return false;
+
+    std::vector<HttpExchange> exchanges;
+    std::string text;
+    while (std::getline(file, text)) {
+        if (text.empty()) continue;
+        try {
+            auto j = json::parse(text);
+            HttpExchange ex;
+            ex.startMs = j.value("t", int64_t{0});
+            ex.durationMs = j.value("d", int64_t{0});
+            ex.method = j.value("m", "");
+            ex.host = j.value("h", "");
+            ex.path = j.value("p", "");
+            ex.statusCode = j.value("s", 0);
+            ex.requestHeaders = j.value("qh", "");
+            ex.requestBody = j.value("qb", "");
+            ex.responseHeaders = j.value("rh", "");
+            ex.responseBody = j.value("rb", "");
+            ex.error = j.value("e", "");
+            exchanges.push_back(std::move(ex));
+        } catch (const json::exception&) {
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_exchanges = std::move(exchanges);
+    m_consumed.assign(m_exchanges.size(), false);
+    return true;
+}
+
+bool HttpReplay::Next(const std::string& method, const std::string& host, const std::string& path, HttpExchange& out)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t i = 0;
+        for (; i < m_exchanges.size(); ++i) {
+            auto& ex = m_exchanges[i];
+            if (!m_consumed[i] && ex.method == method && ex.host == host && ex.path == path)
+                break;
+        }
+        if (i == m_exchanges.size()) return false;
+        m_consumed[i] = true;
+        out = m_exchanges[i];
+    }
+
+    if (m_timeScale > 0.0 && out.durationMs > 0) {
+        auto delay = static_cast<int64_t>(out.durationMs * m_timeScale);
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+    }
+    return true;
+}
+
+size_t HttpReplay::Remaining()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t n = 0;
+    for (bool consumed : m_consumed)
+        if (!consumed) ++n;
+    return n;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include <cstdint>
+
+struct HttpExchange {
+    std::string method;
+    std::string host;
+    std::string path;
+    std::string requestHeaders;
+    std::string requestBody;
+    int statusCode = 0;
+    std::string responseHeaders;
+    std::string responseBody;
+    std::string error;
+    int64_t startMs = 0;
+    int64_t durationMs = 0;
+};
+
+int64_t TraceClockMs();
+
+std::string RedactHeaders(const std::string& headers);
+std::string RedactBody(const std::string& body);
+
+// Appends one JSON line per exchange. Bearer tokens and OAuth token fields
+// are redacted before anything touches the disk.
+class HttpRecorder {
+public:
+    bool Open(const std::wstring& path);
+    void Close();
+    bool IsOpen();
+    void Append(HttpExchange exchange);
+
+private:
+    std::mutex m_mutex;
+    std::ofstream m_file;
+    int64_t m_originMs = 0;
+};
+
+// The last kCapacity exchanges, kept in memory so a trace can be written
+// after the fact. Slots are overwritten in place and keep their capacity, so
+// once warm, recording allocates nothing. Redaction happens on Dump, which
+// writes the HttpRecorder format so the file replays like a recorded trace.
+class HttpTraceRing {
+public:
+    static constexpr size_t kCapacity = 32;
+
+    void Append(const HttpExchange& exchange);
+    bool Dump(const std::wstring& path);
+    size_t Size();
+
+private:
+    std::mutex m_mutex;
+    HttpExchange m_slots[kCapacity];
+    size_t m_next = 0;
+    size_t m_count = 0;
+};
+
+// Serves recorded exchanges back in order. Each (method, host, path) key has
+// its own cursor, so interleaved refresh and usage calls replay
+// deterministically. timeScale 1.0 reproduces the recorded latency, 0 serves
+// instantly and values in between accelerate.
+class HttpReplay {
+public:
+    bool Load(const std::wstring& path);
+    void SetTimeScale(double scale) { m_timeScale = scale; }
+    bool Next(const std::string& method, const std::string& host, const std::string& path, HttpExchange& out);
+    size_t Remaining();
+
+private:
+    std::mutex m_mutex;
+    std::vector<HttpExchange> m_exchanges;
+    std::vector<bool> m_consumed;
+    double m_timeScale = 0.0;
+};
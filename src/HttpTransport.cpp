@@ -0,0 +1,458 @@
+#include "HttpTransport.h"
+#include "Settings.h"
+#include "Platform.h"
+
+#include <mutex>
+
+#ifdef _WIN32
+#include "ProxyResolver.h"
+#include <condition_variable>
+#include <winhttp.h>
+#else
+#include <atomic>
+#include <cstring>
+#include <curl/curl.h>
+#endif
+
+#ifdef _WIN32
+
+// Two sessions for the life of the plugin so WinHTTP can keep DNS results and
+// TLS connections alive between polls. Requests run on the asynchronous one,
+// where a cancel only has to wake the waiting thread; proxy discovery keeps a
+// synchronous one. Proxies are applied per request from the ProxyResolver
+// cache, so the request session itself never runs discovery.
+static struct {
+    std::mutex mutex;
+    HINTERNET session = nullptr;
+    HINTERNET discovery = nullptr;
+} g_http;
+
+static HINTERNET OpenSession(DWORD flags)
+{
+    HINTERNET session = WinHttpOpen(L"claude-usage-taskbar/1.0",
+        WINHTTP_ACCESS_TYPE_NO_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, flags);
+    if (session)
+        WinHttpSetTimeouts(session, kHttpTimeoutMs, kHttpTimeoutMs, kHttpTimeoutMs, kHttpTimeoutMs);
+    return session;
+}
+
+static bool GetHttpSessions(HINTERNET& session, HINTERNET& discovery)
+{
+    std::lock_guard<std::mutex> lock(g_http.mutex);
+    if (!g_http.session) g_http.session = OpenSession(WINHTTP_FLAG_ASYNC);
+    if (!g_http.discovery) g_http.discovery = OpenSession(0);
+    session = g_http.session;
+    discovery = g_http.discovery;
+    return session && discovery;
+}
+
+void CloseHttpSession()
+{
+    StopProxyResolver();
+    std::lock_guard<std::mutex> lock(g_http.mutex);
+    for (HINTERNET* session : {&g_http.session, &g_http.discovery}) {
+        if (*session) {
+            WinHttpCloseHandle(*session);
+            *session = nullptr;
+        }
+    }
+}
+
+namespace {
+
+// The state one asynchronous request shares with its status callback. The
+// requesting thread starts one operation at a time and waits here for it to
+// complete, or for a cancel to wake it.
+struct AsyncCall {
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool done = false;
+    bool failed = false;
+    DWORD error = ERROR_SUCCESS;
+    DWORD bytes = 0;
+    bool closed = false;
+    bool cancelled = false;
+
+    void Begin()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = failed = false;
+        error = ERROR_SUCCESS;
+        bytes = 0;
+    }
+
+    // False when the operation failed or the request was cancelled.
+    bool Wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return done || cancelled; });
+        return done && !failed && !cancelled;
+    }
+
+    void Cancel()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+        changed.notify_all();
+    }
+
+    bool IsCancelled()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return cancelled;
+    }
+
+    // Closing the handle aborts whatever is pending; WinHTTP's last callback
+    // for it is HANDLE_CLOSING, after which this may go out of scope.
+    void Close(HINTERNET request)
+    {
+        WinHttpCloseHandle(request);
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return closed; });
+    }
+};
+
+} // namespace
+
+static void CALLBACK OnRequestStatus(HINTERNET, DWORD_PTR context, DWORD status, LPVOID info, DWORD infoLength)
+{
+    auto* call = reinterpret_cast<AsyncCall*>(context);
+    if (!call) return;
+    std::lock_guard<std::mutex> lock(call->mutex);
+    switch (status) {
+    case WINHTTP_CALLBACK_STATUS_SENDREQUEST_COMPLETE:
+    case WINHTTP_CALLBACK_STATUS_HEADERS_AVAILABLE:
+        call->done = true;
+        break;
+    case WINHTTP_CALLBACK_STATUS_DATA_AVAILABLE:
+        call->bytes = *static_cast<DWORD*>(info);
+        call->done = true;
+        break;
+    case WINHTTP_CALLBACK_STATUS_READ_COMPLETE:
+        call->bytes = infoLength;
+        call->done = true;
+        break;
+    case WINHTTP_CALLBACK_STATUS_REQUEST_ERROR:
+        call->error = static_cast<WINHTTP_ASYNC_RESULT*>(info)->dwError;
+        call->failed = true;
+        call->done = true;
+        break;
+    case WINHTTP_CALLBACK_STATUS_HANDLE_CLOSING:
+        call->closed = true;
+        break;
+    default:
+        return;
+    }
+    call->changed.notify_all();
+}
+
+HttpResponse SendHttpsRequest(
+    const wchar_t* host,
+    const wchar_t* path,
+    const wchar_t* method,
+    const wchar_t* headers,
+    std::string_view body,
+    bool captureHeaders,
+    uint32_t timeoutMs,
+    HedgeCancel* cancel)
+{
+    HttpResponse resp;
+
+    HINTERNET hSession, hDiscovery;
+    if (!GetHttpSessions(hSession, hDiscovery)) { resp.error = "WinHttpOpen failed"; return resp; }
+
+    HINTERNET hConnect = WinHttpConnect(hSession, host, INTERNET_DEFAULT_HTTPS_PORT, 0);
+    if (!hConnect) {
+        resp.error = "WinHttpConnect failed";
+        return resp;
+    }
+
+    HINTERNET hRequest = WinHttpOpenRequest(hConnect, method, path,
+        nullptr, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, WINHTTP_FLAG_SECURE);
+    if (!hRequest) {
+        resp.error = "WinHttpOpenRequest failed";
+        WinHttpCloseHandle(hConnect);
+        return resp;
+    }
+
+    AsyncCall call;
+    DWORD_PTR context = reinterpret_cast<DWORD_PTR>(&call);
+    if (!WinHttpSetOption(hRequest, WINHTTP_OPTION_CONTEXT_VALUE, &context, sizeof(context))
+        || WinHttpSetStatusCallback(hRequest, &OnRequestStatus,
+               WINHTTP_CALLBACK_FLAG_ALL_COMPLETIONS | WINHTTP_CALLBACK_FLAG_HANDLES, 0)
+            == WINHTTP_INVALID_STATUS_CALLBACK) {
+        resp.error = "WinHttpSetStatusCallback failed";
+        WinHttpCloseHandle(hRequest);
+        WinHttpCloseHandle(hConnect);
+        return resp;
+    }
+
+    // A cancel from the other hedged attempt only wakes this thread, which
+    // closes its own handles once nothing else can be using them.
+    bool armed = !cancel || cancel->Arm([&call] { call.Cancel(); });
+    auto finish = [&] {
+        if (cancel) cancel->Disarm();
+        call.Close(hRequest);
+        WinHttpCloseHandle(hConnect);
+        if (call.IsCancelled()) {
+            resp = HttpResponse();
+            resp.error = "Request cancelled";
+        }
+        return resp;
+    };
+    if (!armed) {
+        call.Cancel();
+        return finish();
+    }
+
+    auto proxy = ResolveProxy(hDiscovery, host);
+    if (call.IsCancelled()) return finish();
+    ApplyProxy(hRequest, proxy);
+    if (timeoutMs != kHttpTimeoutMs)
+        WinHttpSetTimeouts(hRequest, timeoutMs, timeoutMs, timeoutMs, timeoutMs);
+    if (headers)
+        WinHttpAddRequestHeaders(hRequest, headers, static_cast<DWORD>(-1), WINHTTP_ADDREQ_FLAG_ADD);
+
+    // Started is what the call returned; the error comes from GetLastError
+    // when it refused to start, from the callback when it failed later.
+    DWORD err = ERROR_SUCCESS;
+    auto complete = [&](BOOL started) {
+        if (!started) {
+            err = GetLastError();
+            return false;
+        }
+        if (!call.Wait()) {
+            err = call.error;
+            return false;
+        }
+        return true;
+    };
+    call.Begin();
+    bool received = complete(WinHttpSendRequest(hRequest,
+        WINHTTP_NO_ADDITIONAL_HEADERS, 0,
+        body.empty() ? WINHTTP_NO_REQUEST_DATA : const_cast<char*>(body.data()),
+        static_cast<DWORD>(body.size()),
+        static_cast<DWORD>(body.size()), context));
+    if (received) {
+        call.Begin();
+        received = complete(WinHttpReceiveResponse(hRequest, nullptr));
+    }
+    if (call.IsCancelled()) return finish();
+
+    if (!received) {
+        resp.error = "HTTP request failed (error ";
+        resp.error += std::to_string(err).c_str();
+        resp.error += ")";
+        if (err == ERROR_WINHTTP_CANNOT_CONNECT || err == ERROR_WINHTTP_NAME_NOT_RESOLVED)
+            ReportProxyFailure(host);
+        return finish();
+    }
+
+    DWORD statusCode = 0;
+    DWORD size = sizeof(statusCode);
+    WinHttpQueryHeaders(hRequest,
+        WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+        nullptr, &statusCode, &size, nullptr);
+    resp.statusCode = static_cast<int>(statusCode);
+
+    if (captureHeaders) {
+        DWORD headerBytes = 0;
+        WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_RAW_HEADERS_CRLF,
+            WINHTTP_HEADER_NAME_BY_INDEX, nullptr, &headerBytes, WINHTTP_NO_HEADER_INDEX);
+        if (headerBytes > 0) {
+            PollWString raw(headerBytes / sizeof(wchar_t), L'\0');
+            if (WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_RAW_HEADERS_CRLF,
+                    WINHTTP_HEADER_NAME_BY_INDEX, &raw[0], &headerBytes, WINHTTP_NO_HEADER_INDEX)) {
+                raw.resize(headerBytes / sizeof(wchar_t));
+                for (wchar_t c : raw) resp.headers.push_back(static_cast<char>(c));
+            }
+        }
+    }
+
+    // The read buffer must outlive the operation, so a cancel is only acted
+    // on after Close has waited for the handle to go.
+    for (;;) {
+        call.Begin();
+        if (!complete(WinHttpQueryDataAvailable(hRequest, nullptr)) || call.bytes == 0) break;
+        size_t used = resp.body.size();
+        DWORD bytesAvailable = call.bytes;
+        resp.body.resize(used + bytesAvailable);
+        call.Begin();
+        if (!complete(WinHttpReadData(hRequest, &resp.body[used], bytesAvailable, nullptr))) {
+            if (!call.IsCancelled()) resp.body.resize(used);
+            break;
+        }
+        resp.body.resize(used + call.bytes);
+    }
+    resp.success = (statusCode >= 200 && statusCode < 300);
+
+    return finish();
+}
+
+#else
+
+// One share for the life of the process so libcurl can keep DNS results, TLS
+// sessions and connections alive between polls. Proxies come from ProxyUrl
+// when set, otherwise from the usual https_proxy/no_proxy environment.
+static struct {
+    std::mutex mutex;
+    CURLSH* share = nullptr;
+    std::mutex locks[CURL_LOCK_DATA_LAST];
+} g_http;
+
+static void LockShare(CURL*, curl_lock_data data, curl_lock_access, void*)
+{
+    g_http.locks[data].lock();
+}
+
+static void UnlockShare(CURL*, curl_lock_data data, void*)
+{
+    g_http.locks[data].unlock();
+}
+
+static CURLSH* GetHttpShare()
+{
+    static std::once_flag initialized;
+    std::call_once(initialized, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+
+    std::lock_guard<std::mutex> lock(g_http.mutex);
+    if (!g_http.share) {
+        g_http.share = curl_share_init();
+        if (g_http.share) {
+            curl_share_setopt(g_http.share, CURLSHOPT_LOCKFUNC, &LockShare);
+            curl_share_setopt(g_http.share, CURLSHOPT_UNLOCKFUNC, &UnlockShare);
+            curl_share_setopt(g_http.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+            curl_share_setopt(g_http.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+            curl_share_setopt(g_http.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+        }
+    }
+    return g_http.share;
+}
+
+void CloseHttpSession()
+{
+    std::lock_guard<std::mutex> lock(g_http.mutex);
+    if (g_http.share) {
+        curl_share_cleanup(g_http.share);
+        g_http.share = nullptr;
+    }
+}
+
+static size_t AppendBody(char* data, size_t size, size_t count, void* out)
+{
+    static_cast<PollString*>(out)->append(data, size * count);
+    return size * count;
+}
+
+// Keeps only the final response's header block, as WinHTTP reports it.
+static size_t AppendHeader(char* data, size_t size, size_t count, void* out)
+{
+    auto& headers = *static_cast<PollString*>(out);
+    if (size * count >= 5 && memcmp(data, "HTTP/", 5) == 0) headers.clear();
+    headers.append(data, size * count);
+    return size * count;
+}
+
+static int CheckCancelled(void* aborted, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+{
+    return static_cast<std::atomic<bool>*>(aborted)->load() ? 1 : 0;
+}
+
+HttpResponse SendHttpsRequest(
+    const wchar_t* host,
+    const wchar_t* path,
+    const wchar_t* method,
+    const wchar_t* headers,
+    std::string_view body,
+    bool captureHeaders,
+    uint32_t timeoutMs,
+    HedgeCancel* cancel)
+{
+    HttpResponse resp;
+
+    CURLSH* share = GetHttpShare();
+    CURL* curl = share ? curl_easy_init() : nullptr;
+    if (!curl) { resp.error = "curl_easy_init failed"; return resp; }
+
+    // libcurl checks this from its progress callback, at least once a second
+    // and on every chunk of data.
+    std::atomic<bool> aborted{false};
+    if (cancel && !cancel->Arm([&aborted] { aborted = true; })) {
+        resp.error = "Request cancelled";
+        curl_easy_cleanup(curl);
+        return resp;
+    }
+
+    auto url = "https://" + WideToUtf8(host) + WideToUtf8(path);
+    auto verb = WideToUtf8(method);
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "claude-usage-taskbar/1.0");
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    // WinHTTP's timeouts are per phase; a connect limit plus a stall limit
+    // is the closest libcurl has.
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(timeoutMs));
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, static_cast<long>((timeoutMs + 999) / 1000));
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &AppendBody);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &resp.body);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, &CheckCancelled);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &aborted);
+    if (captureHeaders) {
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, &AppendHeader);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &resp.headers);
+    }
+
+    if (verb == "HEAD") {
+        curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    } else if (verb == "POST") {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.data());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(body.size()));
+    } else if (verb != "GET") {
+        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, verb.c_str());
+    }
+
+    auto settings = Settings::Instance().Get();
+    std::string proxy, bypass;
+    if (!settings->proxyUrl.empty()) {
+        proxy = WideToUtf8(settings->proxyUrl);
+        bypass = WideToUtf8(settings->proxyBypass);
+        for (char& c : bypass) if (c == ';') c = ',';
+        curl_easy_setopt(curl, CURLOPT_PROXY, proxy.c_str());
+        curl_easy_setopt(curl, CURLOPT_NOPROXY, bypass.c_str());
+    }
+
+    curl_slist* headerList = nullptr;
+    std::string block = headers ? WideToUtf8(headers) : std::string();
+    for (size_t pos = 0; pos < block.size();) {
+        size_t end = block.find("\r\n", pos);
+        if (end == std::string::npos) end = block.size();
+        if (end > pos) headerList = curl_slist_append(headerList, block.substr(pos, end - pos).c_str());
+        pos = end + 2;
+    }
+    // libcurl would otherwise add "Expect: 100-continue" to POSTs.
+    headerList = curl_slist_append(headerList, "Expect:");
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headerList);
+
+    CURLcode rc = curl_easy_perform(curl);
+    if (cancel) cancel->Disarm();
+
+    if (rc != CURLE_OK) {
+        resp.error = "HTTP request failed (";
+        resp.error += aborted ? "cancelled" : curl_easy_strerror(rc);
+        resp.error += ")";
+        resp.body.clear();
+    } else {
+        long statusCode = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &statusCode);
+        resp.statusCode = static_cast<int>(statusCode);
+        resp.success = statusCode >= 200 && statusCode < 300;
+    }
+
+    curl_slist_free_all(headerList);
+    curl_easy_cleanup(curl);
+    return resp;
+}
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "PollArena.h"
+#include "Hedge.h"
+
+#include <cstdint>
+#include <string_view>
+
+struct HttpResponse {
+    bool success = false;
+    int statusCode = 0;
+    PollString body;
+    PollString headers;
+    PollString error;
+};
+
+constexpr uint32_t kHttpTimeoutMs = 10000;
+
+// One HTTPS request on the process-wide session: WinHTTP on Windows, libcurl
+// with a shared DNS, TLS-session and connection cache elsewhere. headers is a
+// CRLF-separated block. An armed cancel aborts the request from another
+// thread. statusCode stays 0 when no HTTP response arrived.
+HttpResponse SendHttpsRequest(
+    const wchar_t* host,
+    const wchar_t* path,
+    const wchar_t* method,
+    const wchar_t* headers,
+    std::string_view body,
+    bool captureHeaders,
+    uint32_t timeoutMs = kHttpTimeoutMs,
+    HedgeCancel* cancel = nullptr);
+
+void CloseHttpSession();
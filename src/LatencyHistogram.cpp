@@ -0,0 +1,26 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+void LatencyHistogram::Add(uint64_t us)
+{
+    int bucket = 0;
+    for (uint64_t v = us >> 1; v && bucket < kBuckets - 1; v >>= 1) ++bucket;
+    ++counts[bucket];
+    ++count;
+    totalUs += us;
+    maxUs = (std::max)(maxUs, us);
+}
+
+uint64_t LatencyHistogram::Percentile(double pct) const
+{
+    if (!count) return 0;
+    auto rank = static_cast<uint64_t>(std::ceil(count * pct / 100.0));
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets - 1; ++i) {
+        seen += counts[i];
+        if (seen >= rank) return (std::min)((uint64_t(2) << i) - 1, maxUs);
+    }
+    return maxUs;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+// Power-of-two buckets of microseconds: bucket 0 holds anything under 2 us,
+// bucket i covers [2^i, 2^(i+1)) and the last one everything from about a
+// second up.
+struct LatencyHistogram {
+    static constexpr int kBuckets = 21;
+
+    uint64_t counts[kBuckets] = {};
+    uint64_t count = 0;
+    uint64_t totalUs = 0;
+    uint64_t maxUs = 0;
+
+    void Add(uint64_t us);
+    // Upper bound of the bucket holding the pct-th percentile, capped at the
+    // largest sample; 0 when empty.
+    uint64_t Percentile(double pct) const;
+    double MeanUs() const { return count ? static_cast<double>(totalUs) / count : 0.0; }
+};
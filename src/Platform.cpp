@@ -0,0 +1,584 @@
+#include "Platform.h"
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <shlobj.h>
+#else
+#include <cerrno>
+#include <cstdlib>
+#include <cwctype>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pwd.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+uint64_t PerfCounterUs(uint64_t ticks)
+{
+    static const uint64_t frequency = PerfFrequency();
+    return ticks / frequency * 1000000 + ticks % frequency * 1000000 / frequency;
+}
+
+#ifdef _WIN32
+
+uint64_t TickMs()
+{
+    return GetTickCount64();
+}
+
+uint64_t PerfCounter()
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return static_cast<uint64_t>(counter.QuadPart);
+}
+
+uint64_t PerfFrequency()
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return static_cast<uint64_t>(frequency.QuadPart);
+}
+
+int64_t UtcFromTm(std::tm& tm)
+{
+    return static_cast<int64_t>(_mkgmtime(&tm));
+}
+
+uint32_t CurrentProcessId()
+{
+    return GetCurrentProcessId();
+}
+
+void SleepMs(uint32_t ms)
+{
+    Sleep(ms);
+}
+
+std::wstring Utf8ToWide(std::string_view str)
+{
+    if (str.empty()) return {};
+    int len = MultiByteToWideChar(CP_UTF8, 0, str.data(), static_cast<int>(str.size()), nullptr, 0);
+    std::wstring result(len, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, str.data(), static_cast<int>(str.size()), result.data(), len);
+    return result;
+}
+
+std::string WideToUtf8(std::wstring_view str)
+{
+    if (str.empty()) return {};
+    int len = WideCharToMultiByte(CP_UTF8, 0, str.data(), static_cast<int>(str.size()), nullptr, 0, nullptr, nullptr);
+    std::string result(len, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, str.data(), static_cast<int>(str.size()), result.data(), len, nullptr, nullptr);
+    return result;
+}
+
+std::wstring HomeDirectory()
+{
+    wchar_t* profile = nullptr;
+    if (FAILED(SHGetKnownFolderPath(FOLDERID_Profile, 0, nullptr, &profile)) || !profile)
+        return L"";
+    std::wstring path(profile);
+    CoTaskMemFree(profile);
+    return path;
+}
+
+static uint64_t FileTimeValue(const FILETIME& ft)
+{
+    return (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+}
+
+FileStamp GetFileStamp(const std::wstring& path)
+{
+    FileStamp stamp;
+    WIN32_FILE_ATTRIBUTE_DATA attrs;
+    if (GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &attrs)) {
+        stamp.lastWrite = FileTimeValue(attrs.ftLastWriteTime);
+        stamp.size = (static_cast<uint64_t>(attrs.nFileSizeHigh) << 32) | attrs.nFileSizeLow;
+    }
+    return stamp;
+}
+
+int64_t FileStampUnixMs(const FileStamp& stamp)
+{
+    // FILETIME counts 100ns ticks from 1601.
+    return static_cast<int64_t>(stamp.lastWrite / 10000) - 11644473600000LL;
+}
+
+static bool EndsWith(const wchar_t* name, const wchar_t* suffix)
+{
+    size_t len = wcslen(name), suffixLen = wcslen(suffix);
+    return len >= suffixLen && _wcsicmp(name + len - suffixLen, suffix) == 0;
+}
+
+void EnumerateFiles(const std::wstring& dir, const wchar_t* suffix,
+    const std::function<void(const std::wstring& path, const FileStamp& stamp)>& onFile)
+{
+    WIN32_FIND_DATAW data;
+    HANDLE find = FindFirstFileExW((dir + L"\\*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch,
+        nullptr, FIND_FIRST_EX_LARGE_FETCH);
+    if (find == INVALID_HANDLE_VALUE) return;
+    do {
+        if (data.cFileName[0] == L'.' || (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) continue;
+        auto path = dir + L'\\' + data.cFileName;
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            EnumerateFiles(path, suffix, onFile);
+        } else if (EndsWith(data.cFileName, suffix)) {
+            FileStamp stamp;
+            stamp.lastWrite = FileTimeValue(data.ftLastWriteTime);
+            stamp.size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+            onFile(path, stamp);
+        }
+    } while (FindNextFileW(find, &data));
+    FindClose(find);
+}
+
+bool MappedFile::Open(const std::wstring& path)
+{
+    Close();
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size = {};
+    bool ok = GetFileSizeEx(file, &size) != FALSE;
+    if (ok && size.QuadPart > 0) {
+        m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* view = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (view) {
+            m_data = static_cast<const char*>(view);
+            m_size = static_cast<uint64_t>(size.QuadPart);
+        } else {
+            ok = false;
+        }
+    }
+    // The mapping keeps the file open.
+    CloseHandle(file);
+    if (!ok) Close();
+    return ok;
+}
+
+void MappedFile::Close()
+{
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_mapping) CloseHandle(m_mapping);
+    m_data = nullptr;
+    m_mapping = nullptr;
+    m_size = 0;
+}
+
+bool GetFileAgeMs(const std::wstring& path, uint64_t& ageMs)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attrs;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &attrs)) return false;
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    uint64_t nowMs = FileTimeValue(now) / 10000;
+    uint64_t writtenMs = FileTimeValue(attrs.ftLastWriteTime) / 10000;
+    ageMs = nowMs > writtenMs ? nowMs - writtenMs : 0;
+    return true;
+}
+
+bool TouchFile(const std::wstring& path)
+{
+    HANDLE file = CreateFileW(path.c_str(), FILE_WRITE_ATTRIBUTES,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    bool ok = SetFileTime(file, nullptr, nullptr, &now) != FALSE;
+    CloseHandle(file);
+    return ok;
+}
+
+bool ReplaceFileAtomically(const std::wstring& from, const std::wstring& to, bool durable)
+{
+    DWORD flags = MOVEFILE_REPLACE_EXISTING | (durable ? MOVEFILE_WRITE_THROUGH : 0);
+    return MoveFileExW(from.c_str(), to.c_str(), flags) != FALSE;
+}
+
+bool RemoveFile(const std::wstring& path)
+{
+    return DeleteFileW(path.c_str()) != FALSE;
+}
+
+bool MakeDirectory(const std::wstring& path, bool& alreadyExists)
+{
+    alreadyExists = false;
+    if (CreateDirectoryW(path.c_str(), nullptr)) return true;
+    alreadyExists = GetLastError() == ERROR_ALREADY_EXISTS;
+    return false;
+}
+
+bool RemoveEmptyDirectory(const std::wstring& path)
+{
+    return RemoveDirectoryW(path.c_str()) != FALSE;
+}
+
+std::wstring ReadIniString(const std::wstring& path, const wchar_t* section, const wchar_t* key, const wchar_t* fallback)
+{
+    wchar_t buf[MAX_PATH] = {};
+    GetPrivateProfileStringW(section, key, fallback, buf, MAX_PATH, path.c_str());
+    return buf;
+}
+
+int ReadIniInt(const std::wstring& path, const wchar_t* section, const wchar_t* key, int fallback)
+{
+    return static_cast<int>(GetPrivateProfileIntW(section, key, fallback, path.c_str()));
+}
+
+bool WriteIniString(const std::wstring& path, const wchar_t* section, const wchar_t* key, const std::wstring& value)
+{
+    return WritePrivateProfileStringW(section, key, value.c_str(), path.c_str()) != FALSE;
+}
+
+#else
+
+uint64_t TickMs()
+{
+    // Counts through suspend, like GetTickCount64.
+    timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000 + static_cast<uint64_t>(ts.tv_nsec) / 1000000;
+}
+
+uint64_t PerfCounter()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+uint64_t PerfFrequency()
+{
+    return 1000000000;
+}
+
+int64_t UtcFromTm(std::tm& tm)
+{
+    return static_cast<int64_t>(timegm(&tm));
+}
+
+uint32_t CurrentProcessId()
+{
+    return static_cast<uint32_t>(getpid());
+}
+
+void SleepMs(uint32_t ms)
+{
+    usleep(static_cast<useconds_t>(ms) * 1000);
+}
+
+std::wstring Utf8ToWide(std::string_view str)
+{
+    std::wstring out;
+    out.reserve(str.size());
+    for (size_t i = 0; i < str.size();) {
+        auto c = static_cast<unsigned char>(str[i]);
+        int extra = c < 0x80 ? 0 : c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : -1;
+        if (extra < 0 || str.size() - i <= static_cast<size_t>(extra)) {
+            out.push_back(0xFFFD);
+            ++i;
+            continue;
+        }
+        uint32_t cp = extra ? c & (0x3F >> extra) : c;
+        bool valid = true;
+        for (int k = 1; k <= extra; ++k) {
+            auto cc = static_cast<unsigned char>(str[i + k]);
+            if ((cc & 0xC0) != 0x80) valid = false;
+            cp = (cp << 6) | (cc & 0x3F);
+        }
+        if (!valid) {
+            out.push_back(0xFFFD);
+            ++i;
+            continue;
+        }
+        out.push_back(static_cast<wchar_t>(cp));
+        i += 1 + extra;
+    }
+    return out;
+}
+
+std::string WideToUtf8(std::wstring_view str)
+{
+    std::string out;
+    out.reserve(str.size());
+    for (wchar_t wc : str) {
+        auto cp = static_cast<uint32_t>(wc);
+        if (cp < 0x80) {
+            out.push_back(static_cast<char>(cp));
+        } else if (cp < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else if (cp < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+    }
+    return out;
+}
+
+std::wstring HomeDirectory()
+{
+    const char* home = getenv("HOME");
+    if (!home || !*home) {
+        auto* pw = getpwuid(getuid());
+        home = pw ? pw->pw_dir : nullptr;
+    }
+    return home ? Utf8ToWide(home) : L"";
+}
+
+FileStamp GetFileStamp(const std::wstring& path)
+{
+    FileStamp stamp;
+    struct stat st;
+    if (stat(NativePath(path).c_str(), &st) == 0) {
+        stamp.lastWrite = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        stamp.size = static_cast<uint64_t>(st.st_size);
+    }
+    return stamp;
+}
+
+int64_t FileStampUnixMs(const FileStamp& stamp)
+{
+    return static_cast<int64_t>(stamp.lastWrite / 1000000);
+}
+
+void EnumerateFiles(const std::wstring& dir, const wchar_t* suffix,
+    const std::function<void(const std::wstring& path, const FileStamp& stamp)>& onFile)
+{
+    auto native = NativePath(dir);
+    DIR* handle = opendir(native.c_str());
+    if (!handle) return;
+    auto suffixUtf8 = WideToUtf8(suffix);
+    while (dirent* entry = readdir(handle)) {
+        if (entry->d_name[0] == '.') continue;
+        auto child = native + '/' + entry->d_name;
+        struct stat st;
+        if (lstat(child.c_str(), &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            EnumerateFiles(Utf8ToWide(child), suffix, onFile);
+        } else if (S_ISREG(st.st_mode)) {
+            std::string_view name(entry->d_name);
+            if (name.size() < suffixUtf8.size() || name.substr(name.size() - suffixUtf8.size()) != suffixUtf8)
+                continue;
+            FileStamp stamp;
+            stamp.lastWrite = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+            stamp.size = static_cast<uint64_t>(st.st_size);
+            onFile(Utf8ToWide(child), stamp);
+        }
+    }
+    closedir(handle);
+}
+
+bool MappedFile::Open(const std::wstring& path)
+{
+    Close();
+    int fd = open(NativePath(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if (ok && st.st_size > 0) {
+        void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (view != MAP_FAILED) {
+            madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+            m_data = static_cast<const char*>(view);
+            m_size = static_cast<uint64_t>(st.st_size);
+        } else {
+            ok = false;
+        }
+    }
+    // The mapping keeps the file open.
+    close(fd);
+    return ok;
+}
+
+void MappedFile::Close()
+{
+    if (m_data) munmap(const_cast<char*>(m_data), static_cast<size_t>(m_size));
+    m_data = nullptr;
+    m_size = 0;
+}
+
+bool GetFileAgeMs(const std::wstring& path, uint64_t& ageMs)
+{
+    struct stat st;
+    if (stat(NativePath(path).c_str(), &st) != 0) return false;
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t diffMs = (now.tv_sec - st.st_mtim.tv_sec) * 1000 + (now.tv_nsec - st.st_mtim.tv_nsec) / 1000000;
+    ageMs = diffMs > 0 ? static_cast<uint64_t>(diffMs) : 0;
+    return true;
+}
+
+bool TouchFile(const std::wstring& path)
+{
+    return utimensat(AT_FDCWD, NativePath(path).c_str(), nullptr, 0) == 0;
+}
+
+static void SyncPath(const std::string& path, int flags)
+{
+    int fd = open(path.c_str(), flags | O_CLOEXEC);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+}
+
+bool ReplaceFileAtomically(const std::wstring& from, const std::wstring& to, bool durable)
+{
+    auto source = NativePath(from);
+    auto target = NativePath(to);
+    // The replacement keeps the old file's permissions, as MoveFileEx keeps
+    // its ACL; credentials stay private.
+    struct stat st;
+    if (stat(target.c_str(), &st) == 0) chmod(source.c_str(), st.st_mode & 07777);
+    if (durable) SyncPath(source, O_RDONLY);
+    if (rename(source.c_str(), target.c_str()) != 0) return false;
+    if (durable) {
+        auto slash = target.find_last_of('/');
+        SyncPath(slash == std::string::npos ? "." : target.substr(0, slash + 1), O_RDONLY | O_DIRECTORY);
+    }
+    return true;
+}
+
+bool RemoveFile(const std::wstring& path)
+{
+    return unlink(NativePath(path).c_str()) == 0;
+}
+
+bool MakeDirectory(const std::wstring& path, bool& alreadyExists)
+{
+    alreadyExists = false;
+    if (mkdir(NativePath(path).c_str(), 0700) == 0) return true;
+    alreadyExists = errno == EEXIST;
+    return false;
+}
+
+bool RemoveEmptyDirectory(const std::wstring& path)
+{
+    return rmdir(NativePath(path).c_str()) == 0;
+}
+
+static std::wstring Trim(const std::wstring& s)
+{
+    size_t begin = 0, end = s.size();
+    while (begin < end && iswspace(s[begin])) ++begin;
+    while (end > begin && iswspace(s[end - 1])) --end;
+    return s.substr(begin, end - begin);
+}
+
+static bool EqualsNoCase(const std::wstring& a, const wchar_t* b)
+{
+    size_t i = 0;
+    for (; i < a.size() && b[i]; ++i)
+        if (towlower(a[i]) != towlower(b[i])) return false;
+    return i == a.size() && !b[i];
+}
+
+static std::vector<std::wstring> ReadIniLines(const std::wstring& path)
+{
+    std::vector<std::wstring> lines;
+    std::ifstream file(NativePath(path), std::ios::binary);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        lines.push_back(Utf8ToWide(line));
+    }
+    return lines;
+}
+
+// Index of the section header line, or lines.size() when missing.
+static size_t FindSection(const std::vector<std::wstring>& lines, const wchar_t* section)
+{
+    for (size_t i = 0; i < lines.size(); ++i) {
+        auto line = Trim(lines[i]);
+        if (line.size() >= 2 && line.front() == L'[' && line.back() == L']'
+            && EqualsNoCase(Trim(line.substr(1, line.size() - 2)), section))
+            return i;
+    }
+    return lines.size();
+}
+
+static bool IsSectionHeader(const std::wstring& line)
+{
+    auto trimmed = Trim(line);
+    return !trimmed.empty() && trimmed.front() == L'[';
+}
+
+static bool SplitKey(const std::wstring& line, const wchar_t* key, std::wstring& value)
+{
+    auto eq = line.find(L'=');
+    if (eq == std::wstring::npos || !EqualsNoCase(Trim(line.substr(0, eq)), key)) return false;
+    value = Trim(line.substr(eq + 1));
+    if (value.size() >= 2 && (value.front() == L'"' || value.front() == L'\'') && value.back() == value.front())
+        value = value.substr(1, value.size() - 2);
+    return true;
+}
+
+std::wstring ReadIniString(const std::wstring& path, const wchar_t* section, const wchar_t* key, const wchar_t* fallback)
+{
+    auto lines = ReadIniLines(path);
+    for (size_t i = FindSection(lines, section) + 1; i < lines.size() && !IsSectionHeader(lines[i]); ++i) {
+        std::wstring value;
+        if (SplitKey(lines[i], key, value)) return value;
+    }
+    return fallback;
+}
+
+int ReadIniInt(const std::wstring& path, const wchar_t* section, const wchar_t* key, int fallback)
+{
+    auto value = ReadIniString(path, section, key, L"");
+    if (value.empty()) return fallback;
+    long parsed = wcstol(value.c_str(), nullptr, 10);
+    return parsed < 0 ? 0 : static_cast<int>(parsed);
+}
+
+bool WriteIniString(const std::wstring& path, const wchar_t* section, const wchar_t* key, const std::wstring& value)
+{
+    auto lines = ReadIniLines(path);
+    std::wstring entry = std::wstring(key) + L"=" + value;
+
+    size_t header = FindSection(lines, section);
+    if (header == lines.size()) {
+        lines.push_back(std::wstring(L"[") + section + L"]");
+        lines.push_back(entry);
+    } else {
+        size_t i = header + 1;
+        size_t insertAt = i;
+        bool replaced = false;
+        for (; i < lines.size() && !IsSectionHeader(lines[i]); ++i) {
+            std::wstring existing;
+            if (SplitKey(lines[i], key, existing)) {
+                lines[i] = entry;
+                replaced = true;
+                break;
+            }
+            if (!Trim(lines[i]).empty()) insertAt = i + 1;
+        }
+        if (!replaced) lines.insert(lines.begin() + insertAt, entry);
+    }
+
+    auto tmpPath = path + L".tmp";
+    {
+        std::ofstream file(NativePath(tmpPath), std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+        for (auto& line : lines) file << WideToUtf8(line) << '\n';
+        if (!file.good()) return false;
+    }
+    return ReplaceFileAtomically(tmpPath, path);
+}
+
+#endif
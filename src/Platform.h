@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <cstdio>
+#include <cwchar>
+#define _countof(a) (sizeof(a) / sizeof((a)[0]))
+#define swprintf_s swprintf
+#define sscanf_s sscanf
+#endif
+
+#ifdef _WIN32
+constexpr wchar_t kPathSeparator = L'\\';
+#else
+constexpr wchar_t kPathSeparator = L'/';
+#endif
+
+// Milliseconds since boot; the clock behind every *_tick field.
+uint64_t TickMs();
+// High-resolution monotonic counter for timing short spans, and its ticks
+// per second.
+uint64_t PerfCounter();
+uint64_t PerfFrequency();
+// A span of PerfCounter ticks in microseconds.
+uint64_t PerfCounterUs(uint64_t ticks);
+// Broken-down UTC to Unix seconds (_mkgmtime / timegm).
+int64_t UtcFromTm(std::tm& tm);
+uint32_t CurrentProcessId();
+void SleepMs(uint32_t ms);
+
+std::wstring Utf8ToWide(std::string_view str);
+std::string WideToUtf8(std::wstring_view str);
+
+// Paths are carried as wide strings everywhere. This is the spelling the
+// standard streams and C APIs take: the path itself on Windows, UTF-8
+// elsewhere.
+#ifdef _WIN32
+inline const std::wstring& NativePath(const std::wstring& path) { return path; }
+#else
+inline std::string NativePath(const std::wstring& path) { return WideToUtf8(path); }
+#endif
+
+std::wstring HomeDirectory();
+
+struct FileStamp {
+    uint64_t lastWrite = 0;
+    uint64_t size = 0;
+    bool operator==(const FileStamp& o) const { return lastWrite == o.lastWrite && size == o.size; }
+};
+
+// Zero stamp when the file does not exist.
+FileStamp GetFileStamp(const std::wstring& path);
+int64_t FileStampUnixMs(const FileStamp& stamp);
+// Walks dir recursively and reports every regular file whose name ends in
+// suffix.
+void EnumerateFiles(const std::wstring& dir, const wchar_t* suffix,
+    const std::function<void(const std::wstring& path, const FileStamp& stamp)>& onFile);
+bool GetFileAgeMs(const std::wstring& path, uint64_t& ageMs);
+// Sets the last-write time of a file or directory to now.
+bool TouchFile(const std::wstring& path);
+// Renames from over to in one step. durable also flushes the rename to disk
+// before returning.
+bool ReplaceFileAtomically(const std::wstring& from, const std::wstring& to, bool durable = false);
+bool RemoveFile(const std::wstring& path);
+// Fails with alreadyExists set when the path exists, so a directory can be
+// used as a lock.
+bool MakeDirectory(const std::wstring& path, bool& alreadyExists);
+bool RemoveEmptyDirectory(const std::wstring& path);
+
+// Private-profile style INI access: the Win32 profile APIs on Windows, a
+// small reader and writer for the same format elsewhere.
+std::wstring ReadIniString(const std::wstring& path, const wchar_t* section, const wchar_t* key, const wchar_t* fallback);
+int ReadIniInt(const std::wstring& path, const wchar_t* section, const wchar_t* key, int fallback);
+bool WriteIniString(const std::wstring& path, const wchar_t* section, const wchar_t* key, const std::wstring& value);
+
+// Read-only view of a whole file, shared with writers that keep appending.
+// Pages are read on first touch, so mapping a large file costs nothing until
+// its bytes are used. An empty file opens with no data.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::wstring& path);
+    void Close();
+    const char* Data() const { return m_data; }
+    uint64_t Size() const { return m_size; }
+
+private:
+    const char* m_data = nullptr;
+    uint64_t m_size = 0;
+#ifdef _WIN32
+    HANDLE m_mapping = nullptr;
+#endif
+};
@@ -2,15 +2,199 @@
 #include "Settings.h"
 #include "SettingsDialog.h"
 #include "Renderer.h"
+#include "ApiClient.h"
+#include "SnapshotStore.h"
+#include "UiWatchdog.h"
+#include "ProxyResolver.h"
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 
+#include <nlohmann/json.hpp>
+
+#include <cstring>
+#include <cctype>
+#include <cstdarg>
+#include <cwchar>
+#include <fstream>
+#include <vector>
+
+using json = nlohmann::json;
+
+// --- Window naming ---
+
+struct WindowPrefix {
+    const char* key;
+    const wchar_t* shortName;
+    const wchar_t* longName;
+    const wchar_t* id;
+};
+
+static const WindowPrefix kWindowPrefixes[] = {
+    {"five_hour", L"5h", L"Session (5hr)", L"5h"},
+    {"seven_day", L"7d", L"Weekly (7day)", L"7d"},
+};
+
+// "seven_day_opus" -> short "7d Opus", long "Weekly (7day) Opus", id "7d_opus"
+static void DescribeWindow(const char* key, std::wstring& shortName, std::wstring& longName, std::wstring& id)
+{
+    const char* suffix = key;
+    shortName.clear();
+    longName.clear();
+    id.clear();
+
+    for (auto& prefix : kWindowPrefixes) {
+        size_t len = strlen(prefix.key);
+        if (strncmp(key, prefix.key, len) == 0 && (key[len] == '\0' || key[len] == '_')) {
+            shortName = prefix.shortName;
+            longName = prefix.longName;
+            id = prefix.id;
+            suffix = key + len;
+            break;
+        }
+    }
+
+    bool wordStart = true;
+    std::wstring words;
+    for (const char* c = suffix; *c; ++c) {
+        if (*c == '_') {
+            wordStart = true;
+            continue;
+        }
+        if (wordStart) {
+            if (!words.empty()) words += L' ';
+            if (!id.empty()) id += L'_';
+        }
+        words += static_cast<wchar_t>(wordStart ? toupper(static_cast<unsigned char>(*c)) : *c);
+        id += static_cast<wchar_t>(tolower(static_cast<unsigned char>(*c)));
+        wordStart = false;
+    }
+
+    if (!words.empty()) {
+        if (!shortName.empty()) shortName += L' ';
+        shortName += words;
+        if (!longName.empty()) longName += L' ';
+        longName += words;
+    }
+}
+
+// Appends to a fixed buffer, truncating once it is full.
+static void AppendFormat(wchar_t* buf, size_t cap, size_t& len, const wchar_t* format, ...)
+{
+    if (len + 1 >= cap) return;
+    va_list args;
+    va_start(args, format);
+    int written = _vsnwprintf_s(buf + len, cap - len, _TRUNCATE, format, args);
+    va_end(args);
+    len = written < 0 ? cap - 1 : len + written;
+}
+
+// 950 -> "950", 12345 -> "12.3k", 4567890 -> "4.6M"
+static void FormatTokens(uint64_t tokens, wchar_t* out, size_t outLen)
+{
+    if (tokens < 1000)
+        _snwprintf_s(out, outLen, _TRUNCATE, L"%llu", static_cast<unsigned long long>(tokens));
+    else if (tokens < 1000000)
+        _snwprintf_s(out, outLen, _TRUNCATE, L"%.1fk", tokens / 1e3);
+    else
+        _snwprintf_s(out, outLen, _TRUNCATE, L"%.1fM", tokens / 1e6);
+}
+
+// "\nTop 5h: src-app \u00b7 opus-4 62%, lib \u00b7 sonnet-4 30%"
+static void AppendShares(wchar_t* buf, size_t cap, size_t& len, const wchar_t* window,
+    const AttributionShare* shares, int count)
+{
+    if (!count) return;
+    AppendFormat(buf, cap, len, L"\nTop %s:", window);
+    for (int i = 0; i < count; ++i)
+        AppendFormat(buf, cap, len, L"%s %s %.0f%%", i ? L"," : L"", shares[i].label, shares[i].pct);
+}
+
+// 850 -> "850 us", 12345 -> "12.3 ms", 1234567 -> "1.23 s"
+static void FormatMicros(uint64_t us, wchar_t* out, size_t outLen)
+{
+    if (us < 1000)
+        _snwprintf_s(out, outLen, _TRUNCATE, L"%llu us", static_cast<unsigned long long>(us));
+    else if (us < 1000000)
+        _snwprintf_s(out, outLen, _TRUNCATE, L"%.1f ms", us / 1e3);
+    else
+        _snwprintf_s(out, outLen, _TRUNCATE, L"%.2f s", us / 1e6);
+}
+
+static double Percent(uint64_t part, uint64_t whole)
+{
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+// --- Statistics ---
+
+// Counters the other modules keep for the life of the process. Resetting
+// the statistics stores them here and the stats report the difference.
+struct CounterSet {
+    HedgeStats hedge;
+    ProxyStats proxy;
+    RenderStats render;
+    SchedulerStats scheduler;
+    PollArenaStats arena;
+};
+
+static CounterSet g_statsBaseline;
+
+static CounterSet ReadCounters(WorkerThread& worker)
+{
+    CounterSet counters;
+    counters.hedge = GetHedgeStats();
+    counters.proxy = GetProxyStats();
+    counters.render = GetRenderStats();
+    counters.scheduler = Scheduler::Shared().GetStats();
+    counters.arena = worker.GetArenaStats();
+    return counters;
+}
+
+static CounterSet CountersSinceReset(WorkerThread& worker)
+{
+    auto counters = ReadCounters(worker);
+    auto& base = g_statsBaseline;
+    counters.hedge.requests -= base.hedge.requests;
+    counters.hedge.hedges -= base.hedge.hedges;
+    counters.hedge.hedgeWins -= base.hedge.hedgeWins;
+    counters.hedge.budgetDenied -= base.hedge.budgetDenied;
+    counters.proxy.resolutions -= base.proxy.resolutions;
+    counters.proxy.cacheHits -= base.proxy.cacheHits;
+    counters.proxy.failures -= base.proxy.failures;
+    counters.proxy.invalidations -= base.proxy.invalidations;
+    counters.proxy.totalResolveUs -= base.proxy.totalResolveUs;
+    counters.render.frames -= base.render.frames;
+    counters.render.layoutMisses -= base.render.layoutMisses;
+    counters.scheduler.wakeups -= base.scheduler.wakeups;
+    counters.scheduler.tasksRun -= base.scheduler.tasksRun;
+    counters.arena.polls -= base.arena.polls;
+    counters.arena.overflowPolls -= base.arena.overflowPolls;
+    return counters;
+}
+
+static json HistogramJson(const LatencyHistogram& histogram)
+{
+    return {
+        {"count", histogram.count}, {"mean_us", histogram.MeanUs()},
+        {"p50_us", histogram.Percentile(50)}, {"p95_us", histogram.Percentile(95)},
+        {"p99_us", histogram.Percentile(99)}, {"max_us", histogram.maxUs},
+        {"buckets", std::vector<uint64_t>(histogram.counts, histogram.counts + LatencyHistogram::kBuckets)},
+    };
+}
+
 // --- UsageItem ---
 
-UsageItem::UsageItem(const wchar_t* name, const wchar_t* id, const wchar_t* label)
-    : m_name(name), m_id(id), m_label(label)
+void UsageItem::Bind(const char* key, ClaudeUsagePlugin* owner)
 {
+    std::wstring shortName, longName, id;
+    DescribeWindow(key, shortName, longName, id);
+
+    strncpy_s(m_key, key, _TRUNCATE);
+    swprintf_s(m_name, L"%s Usage", shortName.c_str());
+    swprintf_s(m_id, L"claude_%s", id.c_str());
+    swprintf_s(m_longName, L"%s", longName.c_str());
+    m_owner = owner;
 }
 
 const wchar_t* UsageItem::GetItemName() const { return m_name; }
@@ -20,16 +204,25 @@ const wchar_t* UsageItem::GetItemValueText() const { return L"--"; }
 const wchar_t* UsageItem::GetItemValueSampleText() const { return L"100%"; }
 
 bool UsageItem::IsCustomDraw() const { return true; }
-int UsageItem::GetItemWidth() const { return Settings::Instance().Get().itemWidth; }
+int UsageItem::GetItemWidth() const { return Settings::Instance().Get()->itemWidth; }
 
 void UsageItem::DrawItem(void* hDC, int x, int y, int w, int h, bool dark_mode)
 {
-    RenderUsageItem(static_cast<HDC>(hDC), x, y, w, h,
-        dark_mode, m_label, m_pct, m_hasData, m_refreshing);
+    UiTimer timer(UiEntry::DrawItem);
+    int dpi = m_owner ? m_owner->GetTaskbarDpi() : 96;
+    ULONGLONG now = GetTickCount64();
+    double pct = m_bar.active ? m_bar.Sample(now) : m_pct;
+    int busyPhase = m_refreshing ? static_cast<int>((now / kBusyStepMs) % 3) + 1 : 0;
+    auto layoutMisses = GetRenderStats().layoutMisses;
+    RenderUsageItem(static_cast<HDC>(hDC), x, y, w, h, dpi, m_layout,
+        dark_mode, m_label, pct, m_hasData, busyPhase, m_stale, m_estimated);
+    timer.Mark(UiPhase::Render);
+    if (GetRenderStats().layoutMisses != layoutMisses) timer.Note(kUiNoteLayoutMiss);
 }
 
 int UsageItem::OnMouseEvent(MouseEventType type, int x, int y, void* hWnd, int flag)
 {
+    UiTimer timer(UiEntry::OnMouseEvent);
     if (type == MT_LCLICKED && m_owner) {
         m_owner->RequestRefresh();
         return 1;
@@ -37,11 +230,19 @@ int UsageItem::OnMouseEvent(MouseEventType type, int x, int y, void* hWnd, int f
     return 0;
 }
 
-void UsageItem::UpdateData(double pct, bool has_data, bool refreshing)
+void UsageItem::UpdateData(double pct, bool has_data, bool refreshing, bool stale, bool estimated)
 {
+    // A poll replacing an estimate is a correction, not movement.
+    if (has_data && (!m_hasData || (m_estimated && !estimated)))
+        m_bar.Snap(pct);
+    else if (has_data && pct != m_pct)
+        m_bar.Retarget(pct, GetTickCount64());
+
     m_pct = pct;
     m_hasData = has_data;
     m_refreshing = refreshing;
+    m_stale = stale;
+    m_estimated = estimated;
 }
 
 // --- ClaudeUsagePlugin ---
@@ -50,8 +251,6 @@ ClaudeUsagePlugin ClaudeUsagePlugin::m_instance;
 
 ClaudeUsagePlugin::ClaudeUsagePlugin()
 {
-    m_five_hour.SetOwner(this);
-    m_seven_day.SetOwner(this);
 }
 
 ClaudeUsagePlugin& ClaudeUsagePlugin::Instance()
@@ -59,73 +258,184 @@ ClaudeUsagePlugin& ClaudeUsagePlugin::Instance()
     return m_instance;
 }
 
-IPluginItem* ClaudeUsagePlugin::GetItem(int index)
+UsageItem* ClaudeUsagePlugin::FindItem(const char* key)
 {
-    switch (index)
-    {
-    case 0: return &m_five_hour;
-    case 1: return &m_seven_day;
-    default: return nullptr;
+    for (int i = 0; i < m_itemCount; ++i)
+        if (strcmp(m_items[i].GetKey(), key) == 0) return &m_items[i];
+    return nullptr;
+}
+
+void ClaudeUsagePlugin::BindItem(const char* key)
+{
+    if (m_itemCount >= kMaxUsageWindows || FindItem(key)) return;
+    m_items[m_itemCount++].Bind(key, this);
+}
+
+// TrafficMonitor enumerates items once at load, so the item list comes from
+// the two standard windows plus whatever the last persisted snapshot held.
+// Windows first seen at runtime get an item that shows up after a restart.
+void ClaudeUsagePlugin::EnsureItems()
+{
+    if (m_itemsReady) return;
+    m_itemsReady = true;
+
+    BindItem("five_hour");
+    BindItem("seven_day");
+
+    m_hasCached = LoadUsageSnapshot(Settings::Instance().GetSnapshotPath(), m_cached);
+    if (m_hasCached) {
+        for (int i = 0; i < m_cached.usage.count; ++i)
+            BindItem(m_cached.usage.windows[i].key);
     }
 }
 
+IPluginItem* ClaudeUsagePlugin::GetItem(int index)
+{
+    UiTimer timer(UiEntry::GetItem);
+    EnsureItems();
+    if (index < 0 || index >= m_itemCount) return nullptr;
+    return &m_items[index];
+}
+
+void ClaudeUsagePlugin::StartWorker()
+{
+    if (m_workerStarted) return;
+
+    EnsureItems();
+    if (m_hasCached)
+        m_worker.Seed(m_cached);
+
+    auto& settings = Settings::Instance();
+    UiWatchdog::Instance().Start(settings.GetUiWatchdogLogPath(), settings.Get()->uiBudgetMs);
+
+    m_worker.SetOnUpdate([this] { m_estimator.OnPoll(); });
+    m_worker.Start();
+    m_worker.WatchPresence();
+    StartTranscripts();
+    m_workerStarted = true;
+}
+
+void ClaudeUsagePlugin::StartTranscripts()
+{
+    auto& settings = Settings::Instance();
+    auto root = TranscriptScanner::RootFor(settings.GetEffectiveCredentialsPath());
+    m_session.Start(root);
+    m_estimator.Start(root, settings.GetTranscriptIndexPath(), settings.GetArchivePath(), m_worker);
+}
+
 void ClaudeUsagePlugin::DataRequired()
 {
-    if (!m_workerStarted) {
-        m_worker.Start();
-        m_workerStarted = true;
-    }
+    UiTimer timer(UiEntry::DataRequired);
+    StartWorker();
 
-    auto snap = m_worker.GetSnapshot();
-    bool has_data = snap.last_success_tick > 0;
+    auto& snap = m_snapshot;
+    if (m_worker.CopySnapshot(snap)) timer.Note(kUiNoteLockWait);
+    timer.Mark(UiPhase::Snapshot);
+    m_estimator.CopyEstimate(m_estimate);
+    m_session.CopyUsage(m_sessionUsage);
+    m_estimator.CopyAttribution(m_attribution);
+    timer.Mark(UiPhase::Transcripts);
+    bool has_data = snap.fetched_at > 0;
 
-    if (m_refreshing && snap.last_success_tick > m_refreshTick)
-        m_refreshing = false;
+    bool refreshing = snap.completed_generation < m_awaitGeneration;
 
-    m_five_hour.UpdateData(snap.five_hour_pct, has_data, m_refreshing);
-    m_seven_day.UpdateData(snap.seven_day_pct, has_data, m_refreshing);
+    for (int i = 0; i < snap.usage.count; ++i)
+        BindItem(snap.usage.windows[i].key);
 
-    if (has_data) {
+    // Between polls the 5h bar follows the transcripts; the next poll
+    // replaces the estimate with the real value.
+    bool estimating = m_estimate.valid && m_estimate.generation == snap.completed_generation
+        && !snap.stale && !snap.has_error && !refreshing;
+
+    for (int i = 0; i < m_itemCount; ++i) {
+        auto* window = snap.usage.Find(m_items[i].GetKey());
+        bool estimated = estimating && window && strcmp(window->key, "five_hour") == 0;
+        m_items[i].UpdateData(estimated ? m_estimate.pct : window ? window->pct : 0.0, has_data && window,
+            refreshing, snap.stale, estimated);
+    }
+
+    if (snap.last_success_tick > 0) {
         m_notifiedNoCredentials = false;
         m_notifiedAuthFailed = false;
     }
 
     if (snap.has_error && m_pApp) {
-        auto& msg = snap.error_msg;
-        if (msg.find(L"credentials") != std::wstring::npos && !m_notifiedNoCredentials) {
+        if (wcsstr(snap.error_msg, L"credentials") && !m_notifiedNoCredentials) {
             m_pApp->ShowNotifyMessage(L"Claude Usage: Credentials not found. Install Claude Code and run 'claude login'.");
             m_notifiedNoCredentials = true;
         }
-        if (msg.find(L"401") != std::wstring::npos && !m_notifiedAuthFailed) {
+        if (wcsstr(snap.error_msg, L"401") && !m_notifiedAuthFailed) {
             m_pApp->ShowNotifyMessage(L"Claude Usage: Authentication failed. Run 'claude login' to re-authenticate.");
             m_notifiedAuthFailed = true;
         }
     }
 
-    m_tooltip.clear();
+    auto now = static_cast<int64_t>(time(nullptr));
+
+    wchar_t* tip = m_tooltip;
+    const size_t cap = _countof(m_tooltip);
+    size_t& len = m_tooltipLen;
+    len = 0;
+    tip[0] = L'\0';
     if (has_data) {
-        wchar_t buf[256];
-        swprintf_s(buf, L"Session (5hr): %.0f%% \u2014 %s\nWeekly (7day): %.0f%% \u2014 %s",
-            snap.five_hour_pct, snap.five_hour_resets.c_str(),
-            snap.seven_day_pct, snap.seven_day_resets.c_str());
-        m_tooltip = buf;
+        for (int i = 0; i < m_itemCount; ++i) {
+            auto* window = snap.usage.Find(m_items[i].GetKey());
+            if (!window) continue;
+            wchar_t resets[48];
+            FormatResetsIn(window->resetsAt, now, resets, _countof(resets));
+            if (estimating && strcmp(window->key, "five_hour") == 0)
+                AppendFormat(tip, cap, len, L"%s%s: ~%.0f%% estimated, %.0f%% at last poll \u2014 %s",
+                    len ? L"\n" : L"", m_items[i].GetLongName(), m_estimate.pct, window->pct, resets);
+            else
+                AppendFormat(tip, cap, len, L"%s%s: %.0f%% \u2014 %s", len ? L"\n" : L"",
+                    m_items[i].GetLongName(), window->pct, resets);
+        }
     } else {
-        m_tooltip = L"Claude Usage: waiting for data...";
+        AppendFormat(tip, cap, len, L"Claude Usage: waiting for data...");
+    }
+
+    // The session line stays while the transcript is inside the 5h window.
+    auto& session = m_sessionUsage;
+    if (session.lastActivityMs > (now - 5 * 3600) * 1000) {
+        wchar_t total[16], input[16], output[16], cache[16];
+        FormatTokens(session.tokens.Total(), total, _countof(total));
+        FormatTokens(session.tokens.input, input, _countof(input));
+        FormatTokens(session.tokens.output, output, _countof(output));
+        FormatTokens(session.tokens.cacheCreation + session.tokens.cacheRead, cache, _countof(cache));
+        AppendFormat(tip, cap, len, L"\nClaude Code session: %s tokens \u2014 in %s, out %s, cache %s",
+            total, input, output, cache);
+    }
+
+    // Which projects and models the local tokens went to.
+    AppendShares(tip, cap, len, L"5h", m_attribution.fiveHour, m_attribution.fiveHourCount);
+    AppendShares(tip, cap, len, L"7d", m_attribution.sevenDay, m_attribution.sevenDayCount);
+
+    if (snap.offline)
+        AppendFormat(tip, cap, len, L"\n\u26A0 Offline \u2014 will refresh when the network returns");
+
+    if (snap.deferred_until > now)
+        AppendFormat(tip, cap, len, L"\n\u23F8 API budget used up \u2014 next update in %lldm",
+            static_cast<long long>((snap.deferred_until - now + 59) / 60));
+
+    if (m_worker.IsPaused())
+        AppendFormat(tip, cap, len, L"\n\u23F8 Polling paused \u2014 click to refresh once");
+
+    if (snap.stale && !snap.has_error) {
+        auto elapsed = (now - snap.fetched_at) / 60;
+        AppendFormat(tip, cap, len, L"\n\u23F3 Cached from %lldm ago, refreshing...",
+            static_cast<long long>(elapsed));
     }
 
     if (snap.has_error) {
-        auto elapsed = (GetTickCount64() - snap.last_success_tick) / 1000;
-        wchar_t errBuf[128];
-        if (snap.last_success_tick > 0) {
-            if (elapsed < 60)
-                swprintf_s(errBuf, L"\n\u26A0 Last updated %llds ago", elapsed);
-            else
-                swprintf_s(errBuf, L"\n\u26A0 Last updated %lldm ago", elapsed / 60);
-        } else {
-            swprintf_s(errBuf, L"\n\u26A0 %s", snap.error_msg.c_str());
-        }
-        m_tooltip += errBuf;
+        auto elapsed = now - snap.fetched_at;
+        if (!has_data)
+            AppendFormat(tip, cap, len, L"\n\u26A0 %s", snap.error_msg);
+        else if (elapsed < 60)
+            AppendFormat(tip, cap, len, L"\n\u26A0 Last updated %llds ago", static_cast<long long>(elapsed));
+        else
+            AppendFormat(tip, cap, len, L"\n\u26A0 Last updated %lldm ago", static_cast<long long>(elapsed / 60));
     }
+    timer.Mark(UiPhase::Tooltip);
 }
 
 const wchar_t* ClaudeUsagePlugin::GetInfo(PluginInfoIndex index)
@@ -144,42 +454,234 @@ const wchar_t* ClaudeUsagePlugin::GetInfo(PluginInfoIndex index)
 
 const wchar_t* ClaudeUsagePlugin::GetTooltipInfo()
 {
-    return m_tooltip.c_str();
+    UiTimer timer(UiEntry::GetTooltipInfo);
+    return m_tooltip;
 }
 
 void ClaudeUsagePlugin::OnInitialize(ITrafficMonitor* pApp)
 {
     m_pApp = pApp;
+
+    auto settings = Settings::Instance().Get();
+    if (!settings->replayTracePath.empty())
+        EnableHttpReplay(settings->replayTracePath, settings->replayTimeScalePct / 100.0);
+    else if (!settings->recordTracePath.empty())
+        EnableHttpRecording(settings->recordTracePath);
+
+    StartWorker();
+}
+
+int ClaudeUsagePlugin::GetTaskbarDpi() const
+{
+    return m_pApp ? m_pApp->GetDPI(ITrafficMonitor::DPI_TASKBAR) : 96;
 }
 
 void ClaudeUsagePlugin::RequestRefresh()
 {
-    m_refreshing = true;
-    m_refreshTick = m_worker.GetSnapshot().last_success_tick;
-    m_worker.RequestRefresh();
+    m_awaitGeneration = m_worker.RequestRefresh();
 }
 
 void ClaudeUsagePlugin::Shutdown()
 {
     if (m_workerStarted) {
+        m_session.Stop();
+        m_estimator.Stop();
         m_worker.Stop();
+        UiWatchdog::Instance().Stop();
         m_workerStarted = false;
     }
 }
 
 ITMPlugin::OptionReturn ClaudeUsagePlugin::ShowOptionsDialog(void* hParent)
 {
-    auto oldSettings = Settings::Instance().Get();
+    PluginSettings oldSettings = Settings::Instance().Get();
     ShowSettingsDialog(static_cast<HWND>(hParent));
-    auto& newSettings = Settings::Instance().Get();
+    auto newSettings = Settings::Instance().Get();
 
-    bool changed = (oldSettings.credentialsPath != newSettings.credentialsPath
-        || oldSettings.itemWidth != newSettings.itemWidth
-        || oldSettings.pollInterval != newSettings.pollInterval);
+    bool changed = (oldSettings.credentialsPath != newSettings->credentialsPath
+        || oldSettings.itemWidth != newSettings->itemWidth
+        || oldSettings.pollInterval != newSettings->pollInterval);
+
+    if (m_workerStarted && oldSettings.credentialsPath != newSettings->credentialsPath)
+        StartTranscripts();
 
     return changed ? OR_OPTION_CHANGED : OR_OPTION_UNCHANGED;
 }
 
+static const wchar_t* kCommandNames[] = {
+    L"Poll now (bypass cache)",
+    L"Show performance stats",
+    L"Dump trace to file",
+    L"Pause polling",
+    L"Reset statistics",
+};
+static_assert(_countof(kCommandNames) == ClaudeUsagePlugin::kCommandCount, "command names");
+
+int ClaudeUsagePlugin::GetCommandCount()
+{
+    return kCommandCount;
+}
+
+const wchar_t* ClaudeUsagePlugin::GetCommandName(int command_index)
+{
+    if (command_index < 0 || command_index >= kCommandCount) return nullptr;
+    return kCommandNames[command_index];
+}
+
+int ClaudeUsagePlugin::IsCommandChecked(int command_index)
+{
+    return command_index == kCommandPausePolling && m_worker.IsPaused();
+}
+
+void ClaudeUsagePlugin::OnPluginCommand(int command_index, void* hWnd, void* para)
+{
+    switch (command_index)
+    {
+    case kCommandPollNow:
+        m_awaitGeneration = m_worker.RequestRefresh(true);
+        break;
+    case kCommandShowStats:
+        MessageBoxW(static_cast<HWND>(hWnd), FormatPerformanceStats().c_str(),
+            L"Claude Usage \u2014 Performance", MB_OK | MB_ICONINFORMATION);
+        break;
+    case kCommandDumpTrace: {
+        // The counters go alongside so the trace can be read against them.
+        auto path = Settings::Instance().GetTraceDumpPath();
+        bool written = DumpRecentHttpTrace(path);
+        DumpDiagnostics(Settings::Instance().GetDiagnosticsPath());
+        auto message = (written ? L"Claude Usage: Trace written to " : L"Claude Usage: Could not write ") + path;
+        if (m_pApp) m_pApp->ShowNotifyMessage(message.c_str());
+        break;
+    }
+    case kCommandPausePolling:
+        m_worker.SetPaused(!m_worker.IsPaused());
+        break;
+    case kCommandResetStats:
+        ResetStatistics();
+        break;
+    default:
+        break;
+    }
+}
+
+std::wstring ClaudeUsagePlugin::FormatPerformanceStats()
+{
+    auto counters = CountersSinceReset(m_worker);
+    auto polls = m_worker.GetPollLatency();
+    auto budget = ApiGovernor::Shared().GetStats();
+    UiWatchdogStats ui;
+    UiWatchdog::Instance().CopyStats(ui);
+
+    wchar_t text[4096];
+    const size_t cap = _countof(text);
+    size_t len = 0;
+    text[0] = L'\0';
+    wchar_t p50[16], p95[16], p99[16], max[16];
+
+    FormatMicros(polls.Percentile(50), p50, _countof(p50));
+    FormatMicros(polls.Percentile(95), p95, _countof(p95));
+    FormatMicros(polls.Percentile(99), p99, _countof(p99));
+    FormatMicros(polls.maxUs, max, _countof(max));
+    AppendFormat(text, cap, len, L"Polls: %llu \u2014 p50 %s, p95 %s, p99 %s, max %s",
+        static_cast<unsigned long long>(polls.count), p50, p95, p99, max);
+    uint64_t firstDataMs = m_worker.GetSnapshot().first_data_ms;
+    if (firstDataMs)
+        AppendFormat(text, cap, len, L"\nFirst data: %llu ms after start", static_cast<unsigned long long>(firstDataMs));
+
+    auto& arena = counters.arena;
+    AppendFormat(text, cap, len, L"\nLast poll: %llu allocations, %.1f KB; peak %.1f KB, %llu of %llu polls spilled to the heap",
+        static_cast<unsigned long long>(arena.allocations), arena.bytes / 1024.0, arena.peakBytes / 1024.0,
+        static_cast<unsigned long long>(arena.overflowPolls), static_cast<unsigned long long>(arena.polls));
+
+    auto& hedge = counters.hedge;
+    AppendFormat(text, cap, len, L"\nHedged requests: %llu of %llu, %llu won, %llu held back by the budget",
+        static_cast<unsigned long long>(hedge.hedges), static_cast<unsigned long long>(hedge.requests),
+        static_cast<unsigned long long>(hedge.hedgeWins), static_cast<unsigned long long>(hedge.budgetDenied));
+    if (hedge.thresholdMs)
+        AppendFormat(text, cap, len, L"; hedging after %u ms", hedge.thresholdMs);
+
+    auto& proxy = counters.proxy;
+    uint64_t lookups = proxy.cacheHits + proxy.resolutions;
+    AppendFormat(text, cap, len, L"\nProxy cache: %.0f%% hit (%llu of %llu lookups), %llu failed resolutions",
+        Percent(proxy.cacheHits, lookups), static_cast<unsigned long long>(proxy.cacheHits),
+        static_cast<unsigned long long>(lookups), static_cast<unsigned long long>(proxy.failures));
+
+    if (budget.perHour)
+        AppendFormat(text, cap, len, L"\nAPI budget: %.0f of %.0f calls left at %u an hour%s",
+            budget.tokens, budget.capacity, budget.perHour, budget.shared ? L", shared" : L"");
+    else
+        AppendFormat(text, cap, len, L"\nAPI budget: off");
+
+    AppendFormat(text, cap, len, L"\nScheduler: %llu wake-ups, %llu tasks run",
+        static_cast<unsigned long long>(counters.scheduler.wakeups),
+        static_cast<unsigned long long>(counters.scheduler.tasksRun));
+
+    auto& render = counters.render;
+    AppendFormat(text, cap, len, L"\nDrawing: %llu frames, layout cache %.1f%% hit",
+        static_cast<unsigned long long>(render.frames), Percent(render.frames - render.layoutMisses, render.frames));
+
+    AppendFormat(text, cap, len, L"\n\nUI thread (p50 / p99 / max):");
+    for (int i = 0; i < static_cast<int>(UiEntry::Count); ++i) {
+        auto& entry = ui.entries[i];
+        if (!entry.count) continue;
+        FormatMicros(entry.Percentile(50), p50, _countof(p50));
+        FormatMicros(entry.Percentile(99), p99, _countof(p99));
+        FormatMicros(entry.maxUs, max, _countof(max));
+        AppendFormat(text, cap, len, L"\n  %hs: %s / %s / %s over %llu calls", UiEntryName(static_cast<UiEntry>(i)),
+            p50, p99, max, static_cast<unsigned long long>(entry.count));
+    }
+    if (ui.budgetMs)
+        AppendFormat(text, cap, len, L"\nOver the %u ms budget: %llu calls, %llu logged", ui.budgetMs,
+            static_cast<unsigned long long>(ui.overBudget), static_cast<unsigned long long>(ui.records));
+    return text;
+}
+
+bool ClaudeUsagePlugin::DumpDiagnostics(const std::wstring& path)
+{
+    auto counters = CountersSinceReset(m_worker);
+    auto budget = ApiGovernor::Shared().GetStats();
+    UiWatchdogStats ui;
+    UiWatchdog::Instance().CopyStats(ui);
+
+    json entries = json::object();
+    for (int i = 0; i < static_cast<int>(UiEntry::Count); ++i)
+        entries[UiEntryName(static_cast<UiEntry>(i))] = HistogramJson(ui.entries[i]);
+
+    auto& arena = counters.arena;
+    auto& hedge = counters.hedge;
+    auto& proxy = counters.proxy;
+    json dump = {
+        {"t", static_cast<int64_t>(time(nullptr))},
+        {"paused", m_worker.IsPaused()},
+        {"polls", HistogramJson(m_worker.GetPollLatency())},
+        {"first_data_ms", m_worker.GetSnapshot().first_data_ms},
+        {"arena", {{"polls", arena.polls}, {"allocations", arena.allocations}, {"bytes", arena.bytes},
+            {"heap_bytes", arena.heapBytes}, {"peak_bytes", arena.peakBytes}, {"overflow_polls", arena.overflowPolls}}},
+        {"hedge", {{"requests", hedge.requests}, {"hedges", hedge.hedges}, {"wins", hedge.hedgeWins},
+            {"budget_denied", hedge.budgetDenied}, {"threshold_ms", hedge.thresholdMs}}},
+        {"proxy", {{"resolutions", proxy.resolutions}, {"cache_hits", proxy.cacheHits}, {"failures", proxy.failures},
+            {"invalidations", proxy.invalidations}, {"resolve_us", proxy.totalResolveUs}}},
+        {"api_budget", {{"per_hour", budget.perHour}, {"capacity", budget.capacity}, {"tokens", budget.tokens},
+            {"calls", budget.calls}, {"shared", budget.shared}}},
+        {"scheduler", {{"wakeups", counters.scheduler.wakeups}, {"tasks", counters.scheduler.tasksRun}}},
+        {"render", {{"frames", counters.render.frames}, {"layout_misses", counters.render.layoutMisses}}},
+        {"ui", {{"budget_ms", ui.budgetMs}, {"over_budget", ui.overBudget}, {"records", ui.records},
+            {"entries", entries}}},
+    };
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+    file << dump.dump(2) << '\n';
+    return static_cast<bool>(file);
+}
+
+void ClaudeUsagePlugin::ResetStatistics()
+{
+    g_statsBaseline = ReadCounters(m_worker);
+    m_worker.ResetPollLatency();
+    UiWatchdog::Instance().Reset();
+}
+
 // --- DLL Export ---
 
 extern "C" __declspec(dllexport) ITMPlugin* TMPluginGetInstance()
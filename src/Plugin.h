@@ -1,6 +1,10 @@
 #pragma once
 #include "PluginInterface.h"
 #include "WorkerThread.h"
+#include "ApiClient.h"
+#include "Renderer.h"
+#include "SessionMeter.h"
+#include "TranscriptEstimator.h"
 #include <string>
 
 class ClaudeUsagePlugin;
@@ -8,8 +12,6 @@ class ClaudeUsagePlugin;
 class UsageItem : public IPluginItem
 {
 public:
-    UsageItem(const wchar_t* name, const wchar_t* id, const wchar_t* label);
-
     const wchar_t* GetItemName() const override;
     const wchar_t* GetItemId() const override;
     const wchar_t* GetItemLableText() const override;
@@ -20,22 +22,40 @@ public:
     void DrawItem(void* hDC, int x, int y, int w, int h, bool dark_mode) override;
     int OnMouseEvent(MouseEventType type, int x, int y, void* hWnd, int flag) override;
 
-    void SetOwner(ClaudeUsagePlugin* owner) { m_owner = owner; }
-    void UpdateData(double pct, bool has_data, bool refreshing);
+    void Bind(const char* key, ClaudeUsagePlugin* owner);
+    const char* GetKey() const { return m_key; }
+    const wchar_t* GetLongName() const { return m_longName; }
+    void UpdateData(double pct, bool has_data, bool refreshing, bool stale, bool estimated);
 
 private:
-    const wchar_t* m_name;
-    const wchar_t* m_id;
-    const wchar_t* m_label;
+    char m_key[kUsageWindowKeyLen] = {};
+    wchar_t m_name[64] = {};
+    wchar_t m_id[64] = {};
+    wchar_t m_longName[64] = {};
+    const wchar_t* m_label = L"";
     ClaudeUsagePlugin* m_owner = nullptr;
     double m_pct = 0.0;
     bool m_hasData = false;
     bool m_refreshing = false;
+    bool m_stale = false;
+    bool m_estimated = false;
+    RenderLayout m_layout;
+    BarAnimation m_bar;
 };
 
 class ClaudeUsagePlugin : public ITMPlugin
 {
 public:
+    // Right-click menu entries, in menu order.
+    enum Command {
+        kCommandPollNow,
+        kCommandShowStats,
+        kCommandDumpTrace,
+        kCommandPausePolling,
+        kCommandResetStats,
+        kCommandCount
+    };
+
     static ClaudeUsagePlugin& Instance();
 
     IPluginItem* GetItem(int index) override;
@@ -44,22 +64,49 @@ public:
     const wchar_t* GetTooltipInfo() override;
     OptionReturn ShowOptionsDialog(void* hParent) override;
     void OnInitialize(ITrafficMonitor* pApp) override;
+    int GetCommandCount() override;
+    const wchar_t* GetCommandName(int command_index) override;
+    void OnPluginCommand(int command_index, void* hWnd, void* para) override;
+    int IsCommandChecked(int command_index) override;
 
     void RequestRefresh();
     void Shutdown();
+    int GetTaskbarDpi() const;
+
+    // Read from counters the worker, renderer and UI timers already keep,
+    // since the last ResetStatistics.
+    std::wstring FormatPerformanceStats();
+    bool DumpDiagnostics(const std::wstring& path);
+    void ResetStatistics();
 
 private:
     ClaudeUsagePlugin();
+    void StartWorker();
+    void StartTranscripts();
+    void EnsureItems();
+    void BindItem(const char* key);
+    UsageItem* FindItem(const char* key);
 
     static ClaudeUsagePlugin m_instance;
-    UsageItem m_five_hour{L"5h Usage", L"claude_5h", L""};
-    UsageItem m_seven_day{L"7d Usage", L"claude_7d", L""};
+    UsageItem m_items[kMaxUsageWindows];
+    int m_itemCount = 0;
+    bool m_itemsReady = false;
+    UsageData m_cached;
+    bool m_hasCached = false;
     WorkerThread m_worker;
     bool m_workerStarted = false;
-    std::wstring m_tooltip;
+    SessionMeter m_session;
+    TranscriptEstimator m_estimator;
+    // DataRequired, GetTooltipInfo and DrawItem run on the UI thread every
+    // second; they work out of these fixed buffers and never allocate.
+    UsageData m_snapshot;
+    SessionUsage m_sessionUsage;
+    UsageEstimate m_estimate;
+    AttributionSummary m_attribution;
+    wchar_t m_tooltip[1024] = {};
+    size_t m_tooltipLen = 0;
     ITrafficMonitor* m_pApp = nullptr;
     bool m_notifiedNoCredentials = false;
     bool m_notifiedAuthFailed = false;
-    bool m_refreshing = false;
-    ULONGLONG m_refreshTick = 0;
+    uint64_t m_awaitGeneration = 0;
 };
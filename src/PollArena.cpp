@@ -0,0 +1,58 @@
+#include "PollArena.h"
+
+static thread_local std::pmr::memory_resource* t_pollResource = nullptr;
+
+void* PollArena::Upstream::do_allocate(size_t bytes, size_t align)
+{
+    this->bytes += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, align);
+}
+
+void PollArena::Upstream::do_deallocate(void* p, size_t bytes, size_t align)
+{
+    std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+}
+
+PollArena::PollArena()
+    : m_block(new std::byte[kReservedBytes])
+    , m_monotonic(m_block.get(), kReservedBytes, &m_upstream)
+{
+}
+
+void* PollArena::do_allocate(size_t bytes, size_t align)
+{
+    ++m_allocations;
+    m_bytes += bytes;
+    return m_monotonic.allocate(bytes, align);
+}
+
+void PollArena::Reset()
+{
+    ++m_stats.polls;
+    m_stats.allocations = m_allocations;
+    m_stats.bytes = m_bytes;
+    m_stats.heapBytes = m_upstream.bytes;
+    if (m_bytes > m_stats.peakBytes) m_stats.peakBytes = m_bytes;
+    if (m_upstream.bytes) ++m_stats.overflowPolls;
+
+    m_monotonic.release();
+    m_upstream.bytes = 0;
+    m_allocations = 0;
+    m_bytes = 0;
+}
+
+PollArenaScope::PollArenaScope(PollArena& arena)
+    : m_previous(t_pollResource)
+{
+    t_pollResource = &arena;
+}
+
+PollArenaScope::~PollArenaScope()
+{
+    t_pollResource = m_previous;
+}
+
+std::pmr::memory_resource* CurrentPollResource()
+{
+    return t_pollResource ? t_pollResource : std::pmr::get_default_resource();
+}
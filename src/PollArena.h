@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <type_traits>
+
+struct PollArenaStats {
+    uint64_t polls = 0;
+    // Last poll.
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t heapBytes = 0;
+    // Largest poll so far, and how many polls spilled past the reserved block.
+    uint64_t peakBytes = 0;
+    uint64_t overflowPolls = 0;
+};
+
+// Bump-pointer arena for one poll cycle. Requests are carved out of a block
+// reserved up front; Reset() rewinds it and returns anything that spilled to
+// the heap. Not thread-safe: bind it to the polling thread with
+// PollArenaScope.
+class PollArena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t kReservedBytes = 64 * 1024;
+
+    PollArena();
+
+    // Rewinds the arena and folds the finished cycle into the stats.
+    void Reset();
+    const PollArenaStats& GetStats() const { return m_stats; }
+
+private:
+    class Upstream : public std::pmr::memory_resource {
+    public:
+        uint64_t bytes = 0;
+
+    private:
+        void* do_allocate(size_t bytes, size_t align) override;
+        void do_deallocate(void* p, size_t bytes, size_t align) override;
+        bool do_is_equal(const memory_resource& other) const noexcept override { return this == &other; }
+    };
+
+    void* do_allocate(size_t bytes, size_t align) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const memory_resource& other) const noexcept override { return this == &other; }
+
+    std::unique_ptr<std::byte[]> m_block;
+    Upstream m_upstream;
+    std::pmr::monotonic_buffer_resource m_monotonic;
+    uint64_t m_allocations = 0;
+    uint64_t m_bytes = 0;
+    PollArenaStats m_stats;
+};
+
+// Makes `arena` the calling thread's poll resource until destroyed.
+class PollArenaScope {
+public:
+    explicit PollArenaScope(PollArena& arena);
+    ~PollArenaScope();
+    PollArenaScope(const PollArenaScope&) = delete;
+    PollArenaScope& operator=(const PollArenaScope&) = delete;
+
+private:
+    std::pmr::memory_resource* m_previous;
+};
+
+// The arena bound to this thread, or the default resource outside a poll.
+std::pmr::memory_resource* CurrentPollResource();
+
+// Default-constructs onto the current poll resource, so containers that
+// build their own allocators (nlohmann's DOM) land in the arena too.
+template <class T>
+class PollAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    PollAllocator() noexcept : m_resource(CurrentPollResource()) {}
+    template <class U>
+    PollAllocator(const PollAllocator<U>& other) noexcept : m_resource(other.resource()) {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(m_resource->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* p, size_t n) { m_resource->deallocate(p, n * sizeof(T), alignof(T)); }
+
+    PollAllocator select_on_container_copy_construction() const { return PollAllocator(); }
+    std::pmr::memory_resource* resource() const noexcept { return m_resource; }
+
+private:
+    std::pmr::memory_resource* m_resource;
+};
+
+template <class T, class U>
+bool operator==(const PollAllocator<T>& a, const PollAllocator<U>& b) noexcept
+{
+    return a.resource() == b.resource() || a.resource()->is_equal(*b.resource());
+}
+
+template <class T, class U>
+bool operator!=(const PollAllocator<T>& a, const PollAllocator<U>& b) noexcept
+{
+    return !(a == b);
+}
+
+using PollString = std::basic_string<char, std::char_traits<char>, PollAllocator<char>>;
+using PollWString = std::basic_string<wchar_t, std::char_traits<wchar_t>, PollAllocator<wchar_t>>;
@@ -0,0 +1,45 @@
+#include "PollPolicy.h"
+
+#include <algorithm>
+
+bool PollPolicy::OnEvent(PresenceEvent event)
+{
+    bool couldPoll = CanPoll();
+
+    switch (event) {
+    case PresenceEvent::SessionLocked: m_locked = true; break;
+    case PresenceEvent::SessionUnlocked: m_locked = false; break;
+    case PresenceEvent::DisplayOff: m_displayOff = true; break;
+    case PresenceEvent::DisplayOn: m_displayOff = false; break;
+    case PresenceEvent::OnBattery: m_onBattery = true; break;
+    case PresenceEvent::OnAcPower: m_onBattery = false; break;
+    case PresenceEvent::Suspending: m_suspending = true; break;
+    // The display-on notification that follows a resume can arrive late or
+    // not at all on some drivers, so resuming clears both.
+    case PresenceEvent::Resumed:
+        m_suspending = false;
+        m_displayOff = false;
+        break;
+    case PresenceEvent::NetworkLost: m_offline = true; break;
+    case PresenceEvent::NetworkRestored: m_offline = false; break;
+    }
+
+    return !couldPoll && CanPoll();
+}
+
+PollPlan PollPolicy::Plan(uint64_t intervalMs, uint64_t sinceLastPollMs) const
+{
+    PollPlan plan;
+    if (!CanPoll()) {
+        plan.suspended = true;
+        return plan;
+    }
+
+    uint64_t interval = m_onBattery ? intervalMs * kBatteryStretch : intervalMs;
+    if (sinceLastPollMs >= interval) return plan;
+
+    plan.delayMs = interval - sinceLastPollMs;
+    uint64_t divisor = m_onBattery ? kBatteryToleranceDivisor : kAcToleranceDivisor;
+    plan.toleranceMs = std::min(interval / divisor, kMaxToleranceMs);
+    return plan;
+}
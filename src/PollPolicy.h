@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+enum class PresenceEvent {
+    SessionLocked,
+    SessionUnlocked,
+    DisplayOff,
+    DisplayOn,
+    OnBattery,
+    OnAcPower,
+    Suspending,
+    Resumed,
+    NetworkLost,
+    NetworkRestored,
+};
+
+struct PollPlan {
+    bool suspended = false;
+    uint64_t delayMs = 0;
+    uint64_t toleranceMs = 0;
+};
+
+// Decides when the next poll is due from what the user can currently see.
+// Polling stops while the session is locked, the display is off, the
+// machine is suspending or the network is down, and stretches on battery.
+// Pure state: fed by PresenceMonitor and ConnectivityMonitor, and directly
+// by tests.
+class PollPolicy {
+public:
+    static constexpr uint64_t kBatteryStretch = 3;
+    // Allowed lateness as a fraction of the interval, so the OS can batch
+    // the wake-up with other timers.
+    static constexpr uint64_t kAcToleranceDivisor = 10;
+    static constexpr uint64_t kBatteryToleranceDivisor = 4;
+    static constexpr uint64_t kMaxToleranceMs = 5 * 60 * 1000;
+
+    // Returns true when polling just became possible again (taskbar visible
+    // and network up) and the data should be refreshed right away.
+    bool OnEvent(PresenceEvent event);
+
+    bool IsVisible() const { return !m_locked && !m_displayOff && !m_suspending; }
+    bool IsOnline() const { return !m_offline; }
+    bool CanPoll() const { return IsVisible() && IsOnline(); }
+    bool IsOnBattery() const { return m_onBattery; }
+
+    PollPlan Plan(uint64_t intervalMs, uint64_t sinceLastPollMs) const;
+
+private:
+    bool m_locked = false;
+    bool m_displayOff = false;
+    bool m_suspending = false;
+    bool m_onBattery = false;
+    bool m_offline = false;
+};
@@ -0,0 +1,123 @@
+#include "PresenceMonitor.h"
+
+#ifdef _WIN32
+
+#include <wtsapi32.h>
+
+static const wchar_t* kWindowClass = L"ClaudeUsagePresenceMonitor";
+
+// GUID_CONSOLE_DISPLAY_STATE and GUID_ACDC_POWER_SOURCE, spelled out so the
+// build does not depend on initguid.h ordering.
+static const GUID kConsoleDisplayState = {0x6fe69556, 0x704a, 0x47a0, {0x8f, 0x24, 0xc2, 0x8d, 0x93, 0x6f, 0xda, 0x47}};
+static const GUID kPowerSource = {0x5d3e9a59, 0xe9d5, 0x4b00, {0xa6, 0xbd, 0xff, 0x34, 0xff, 0x51, 0x65, 0x48}};
+
+static HINSTANCE ThisModule()
+{
+    HMODULE module = nullptr;
+    GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+        reinterpret_cast<LPCWSTR>(&ThisModule), &module);
+    return module;
+}
+
+bool PresenceMonitor::Start(Callback onEvent)
+{
+    Stop();
+
+    HINSTANCE instance = ThisModule();
+    WNDCLASSEXW wc = {};
+    wc.cbSize = sizeof(wc);
+    wc.lpfnWndProc = &PresenceMonitor::WndProc;
+    wc.hInstance = instance;
+    wc.lpszClassName = kWindowClass;
+    if (!RegisterClassExW(&wc) && GetLastError() != ERROR_CLASS_ALREADY_EXISTS) return false;
+
+    m_onEvent = std::move(onEvent);
+    m_hwnd = CreateWindowExW(0, kWindowClass, L"", 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr, instance, this);
+    if (!m_hwnd) {
+        m_onEvent = nullptr;
+        return false;
+    }
+
+    // Each power registration immediately delivers the current value, so the
+    // policy starts from the real display and power-source state.
+    WTSRegisterSessionNotification(m_hwnd, NOTIFY_FOR_THIS_SESSION);
+    m_displayNotify = RegisterPowerSettingNotification(m_hwnd, &kConsoleDisplayState, DEVICE_NOTIFY_WINDOW_HANDLE);
+    m_sourceNotify = RegisterPowerSettingNotification(m_hwnd, &kPowerSource, DEVICE_NOTIFY_WINDOW_HANDLE);
+    m_suspendNotify = RegisterSuspendResumeNotification(m_hwnd, DEVICE_NOTIFY_WINDOW_HANDLE);
+    return true;
+}
+
+void PresenceMonitor::Stop()
+{
+    if (!m_hwnd) return;
+
+    if (m_suspendNotify) UnregisterSuspendResumeNotification(m_suspendNotify);
+    if (m_sourceNotify) UnregisterPowerSettingNotification(m_sourceNotify);
+    if (m_displayNotify) UnregisterPowerSettingNotification(m_displayNotify);
+    m_suspendNotify = m_sourceNotify = m_displayNotify = nullptr;
+    WTSUnRegisterSessionNotification(m_hwnd);
+
+    DestroyWindow(m_hwnd);
+    m_hwnd = nullptr;
+    m_onEvent = nullptr;
+}
+
+bool PresenceMonitor::IsRunning() const
+{
+    return m_hwnd != nullptr;
+}
+
+void PresenceMonitor::OnPowerSetting(const POWERBROADCAST_SETTING& setting)
+{
+    if (setting.DataLength < sizeof(DWORD)) return;
+    DWORD value = *reinterpret_cast<const DWORD*>(setting.Data);
+
+    // Display: 0 off, 1 on, 2 dimmed. Power source: 0 AC, 1 battery, 2 UPS.
+    if (IsEqualGUID(setting.PowerSetting, kConsoleDisplayState))
+        m_onEvent(value == 0 ? PresenceEvent::DisplayOff : PresenceEvent::DisplayOn);
+    else if (IsEqualGUID(setting.PowerSetting, kPowerSource))
+        m_onEvent(value == 0 ? PresenceEvent::OnAcPower : PresenceEvent::OnBattery);
+}
+
+LRESULT CALLBACK PresenceMonitor::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    if (msg == WM_NCCREATE) {
+        auto* create = reinterpret_cast<CREATESTRUCTW*>(lParam);
+        SetWindowLongPtrW(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(create->lpCreateParams));
+    }
+
+    auto* self = reinterpret_cast<PresenceMonitor*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+    if (!self || !self->m_onEvent) return DefWindowProcW(hwnd, msg, wParam, lParam);
+
+    switch (msg) {
+    case WM_WTSSESSION_CHANGE:
+        if (wParam == WTS_SESSION_LOCK) self->m_onEvent(PresenceEvent::SessionLocked);
+        else if (wParam == WTS_SESSION_UNLOCK) self->m_onEvent(PresenceEvent::SessionUnlocked);
+        return 0;
+    case WM_POWERBROADCAST:
+        if (wParam == PBT_APMSUSPEND) self->m_onEvent(PresenceEvent::Suspending);
+        else if (wParam == PBT_APMRESUMEAUTOMATIC) self->m_onEvent(PresenceEvent::Resumed);
+        else if (wParam == PBT_POWERSETTINGCHANGE)
+            self->OnPowerSetting(*reinterpret_cast<const POWERBROADCAST_SETTING*>(lParam));
+        return TRUE;
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
+#else
+
+bool PresenceMonitor::Start(Callback)
+{
+    return false;
+}
+
+void PresenceMonitor::Stop()
+{
+}
+
+bool PresenceMonitor::IsRunning() const
+{
+    return false;
+}
+
+#endif
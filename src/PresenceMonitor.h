@@ -0,0 +1,36 @@
+#pragma once
+
+#include "PollPolicy.h"
+#include <functional>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+// Reports session lock/unlock, console display on/off, AC/battery and
+// suspend/resume through a message-only window. Start it on a thread that
+// pumps messages (the TrafficMonitor UI thread); the callback runs there.
+// Elsewhere there is no session to watch and Start() fails.
+class PresenceMonitor {
+public:
+    using Callback = std::function<void(PresenceEvent)>;
+
+    ~PresenceMonitor() { Stop(); }
+
+    bool Start(Callback onEvent);
+    void Stop();
+    bool IsRunning() const;
+
+private:
+#ifdef _WIN32
+    static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+    void OnPowerSetting(const POWERBROADCAST_SETTING& setting);
+
+    HWND m_hwnd = nullptr;
+    HPOWERNOTIFY m_displayNotify = nullptr;
+    HPOWERNOTIFY m_sourceNotify = nullptr;
+    HPOWERNOTIFY m_suspendNotify = nullptr;
+#endif
+    Callback m_onEvent;
+};
@@ -0,0 +1,174 @@
+#include "ProxyResolver.h"
+#include "Settings.h"
+
+#include <winsock2.h>
+#include <ws2ipdef.h>
+#include <iphlpapi.h>
+#include <netioapi.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+static struct {
+    std::mutex mutex;
+    std::map<std::wstring, ProxyChoice> byHost;
+    uint64_t settingsVersion = UINT64_MAX;
+    HANDLE notify = nullptr;
+    ProxyStats stats;
+} g_proxy;
+
+static VOID WINAPI OnInterfaceChange(PVOID, PMIB_IPINTERFACE_ROW, MIB_NOTIFICATION_TYPE)
+{
+    InvalidateProxyCache();
+}
+
+static std::wstring StripScheme(const std::wstring& url)
+{
+    auto sep = url.find(L"://");
+    auto rest = sep == std::wstring::npos ? url : url.substr(sep + 3);
+    while (!rest.empty() && rest.back() == L'/') rest.pop_back();
+    return rest;
+}
+
+static void TakeString(LPWSTR& s, std::wstring& out)
+{
+    if (!s) return;
+    out = s;
+    GlobalFree(s);
+    s = nullptr;
+}
+
+static bool Discover(HINTERNET session, const wchar_t* host, ProxyChoice& out)
+{
+    WINHTTP_CURRENT_USER_IE_PROXY_CONFIG ie = {};
+    bool haveIe = WinHttpGetIEProxyConfigForCurrentUser(&ie) != FALSE;
+
+    std::wstring autoConfigUrl, staticProxy, staticBypass;
+    bool autoDetect = haveIe ? ie.fAutoDetect != FALSE : true;
+    if (haveIe) {
+        TakeString(ie.lpszAutoConfigUrl, autoConfigUrl);
+        TakeString(ie.lpszProxy, staticProxy);
+        TakeString(ie.lpszProxyBypass, staticBypass);
+    }
+
+    bool ok = true;
+    if (autoDetect || !autoConfigUrl.empty()) {
+        WINHTTP_AUTOPROXY_OPTIONS options = {};
+        if (!autoConfigUrl.empty()) {
+            options.dwFlags = WINHTTP_AUTOPROXY_CONFIG_URL;
+            options.lpszAutoConfigUrl = autoConfigUrl.c_str();
+        } else {
+            options.dwFlags = WINHTTP_AUTOPROXY_AUTO_DETECT;
+            options.dwAutoDetectFlags = WINHTTP_AUTO_DETECT_TYPE_DHCP | WINHTTP_AUTO_DETECT_TYPE_DNS_A;
+        }
+        options.fAutoLogonIfChallenged = TRUE;
+
+        std::wstring url = std::wstring(L"https://") + host + L"/";
+        WINHTTP_PROXY_INFO info = {};
+        if (WinHttpGetProxyForUrl(session, url.c_str(), &options, &info)) {
+            std::wstring proxy, bypass;
+            TakeString(info.lpszProxy, proxy);
+            TakeString(info.lpszProxyBypass, bypass);
+            out.direct = info.dwAccessType != WINHTTP_ACCESS_TYPE_NAMED_PROXY || proxy.empty();
+            out.proxy = proxy;
+            out.bypass = bypass;
+            return true;
+        }
+        // WPAD is commonly absent; only a configured PAC URL failing counts.
+        ok = autoConfigUrl.empty();
+    }
+
+    out.direct = staticProxy.empty();
+    out.proxy = staticProxy;
+    out.bypass = staticBypass;
+    return ok;
+}
+
+ProxyChoice ResolveProxy(HINTERNET session, const wchar_t* host)
+{
+    auto settings = Settings::Instance().Get();
+
+    {
+        std::lock_guard<std::mutex> lock(g_proxy.mutex);
+        if (g_proxy.settingsVersion != settings->version) {
+            g_proxy.byHost.clear();
+            g_proxy.settingsVersion = settings->version;
+        }
+        auto it = g_proxy.byHost.find(host);
+        if (it != g_proxy.byHost.end()) {
+            ++g_proxy.stats.cacheHits;
+            return it->second;
+        }
+        if (!g_proxy.notify)
+            NotifyIpInterfaceChange(AF_UNSPEC, OnInterfaceChange, nullptr, FALSE, &g_proxy.notify);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ProxyChoice choice;
+    bool ok = true;
+    if (!settings->proxyUrl.empty()) {
+        choice.direct = false;
+        choice.proxy = StripScheme(settings->proxyUrl);
+        choice.bypass = settings->proxyBypass;
+    } else {
+        ok = Discover(session, host, choice);
+    }
+    auto us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count());
+
+    std::lock_guard<std::mutex> lock(g_proxy.mutex);
+    ++g_proxy.stats.resolutions;
+    if (!ok) ++g_proxy.stats.failures;
+    g_proxy.stats.totalResolveUs += us;
+    g_proxy.stats.lastResolveUs = us;
+    if (g_proxy.settingsVersion == settings->version)
+        g_proxy.byHost[host] = choice;
+    return choice;
+}
+
+bool ApplyProxy(HINTERNET request, const ProxyChoice& choice)
+{
+    WINHTTP_PROXY_INFO info = {};
+    if (choice.direct) {
+        info.dwAccessType = WINHTTP_ACCESS_TYPE_NO_PROXY;
+    } else {
+        info.dwAccessType = WINHTTP_ACCESS_TYPE_NAMED_PROXY;
+        info.lpszProxy = const_cast<LPWSTR>(choice.proxy.c_str());
+        info.lpszProxyBypass = choice.bypass.empty() ? nullptr : const_cast<LPWSTR>(choice.bypass.c_str());
+    }
+    return WinHttpSetOption(request, WINHTTP_OPTION_PROXY, &info, sizeof(info)) != FALSE;
+}
+
+void InvalidateProxyCache()
+{
+    std::lock_guard<std::mutex> lock(g_proxy.mutex);
+    if (g_proxy.byHost.empty()) return;
+    g_proxy.byHost.clear();
+    ++g_proxy.stats.invalidations;
+}
+
+void ReportProxyFailure(const wchar_t* host)
+{
+    if (!Settings::Instance().Get()->proxyUrl.empty()) return;
+    std::lock_guard<std::mutex> lock(g_proxy.mutex);
+    if (g_proxy.byHost.erase(host)) ++g_proxy.stats.invalidations;
+}
+
+void StopProxyResolver()
+{
+    HANDLE notify;
+    {
+        std::lock_guard<std::mutex> lock(g_proxy.mutex);
+        notify = g_proxy.notify;
+        g_proxy.notify = nullptr;
+        g_proxy.byHost.clear();
+    }
+    // Waits for an in-flight callback, so the lock must not be held here.
+    if (notify) CancelMibChangeNotify2(notify);
+}
+
+ProxyStats GetProxyStats()
+{
+    std::lock_guard<std::mutex> lock(g_proxy.mutex);
+    return g_proxy.stats;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <winhttp.h>
+
+struct ProxyChoice {
+    bool direct = true;
+    std::wstring proxy;
+    std::wstring bypass;
+};
+
+struct ProxyStats {
+    uint64_t resolutions = 0;
+    uint64_t cacheHits = 0;
+    uint64_t failures = 0;
+    uint64_t invalidations = 0;
+    uint64_t totalResolveUs = 0;
+    uint64_t lastResolveUs = 0;
+};
+
+// Resolves the proxy for a host once and reuses the answer until the network
+// or the proxy settings change. An explicit ProxyUrl in the ini skips
+// discovery entirely.
+ProxyChoice ResolveProxy(HINTERNET session, const wchar_t* host);
+bool ApplyProxy(HINTERNET request, const ProxyChoice& choice);
+void InvalidateProxyCache();
+// Drops a discovered answer for host after a connect failure.
+void ReportProxyFailure(const wchar_t* host);
+void StopProxyResolver();
+ProxyStats GetProxyStats();
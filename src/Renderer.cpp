@@ -18,14 +18,122 @@ static COLORREF BarColorForPct(double pct)
     return LerpColor(kBarOrange, kBarRed, (pct - 80.0) / 20.0);
 }
 
+static RenderStats g_stats;
+
+void BarAnimation::Retarget(double target, ULONGLONG now)
+{
+    from = Sample(now);
+    to = target;
+    startTick = now;
+    active = from != to;
+}
+
+void BarAnimation::Snap(double value)
+{
+    from = to = value;
+    active = false;
+}
+
+double BarAnimation::Sample(ULONGLONG now)
+{
+    if (!active) return to;
+
+    ULONGLONG elapsed = now - startTick;
+    if (elapsed >= kBarAnimationMs) {
+        active = false;
+        return to;
+    }
+
+    double t = 1.0 - static_cast<double>(elapsed) / kBarAnimationMs;
+    double eased = 1.0 - t * t * t;
+    return from + (to - from) * eased;
+}
+
+const RenderStats& GetRenderStats()
+{
+    return g_stats;
+}
+
+static int GlyphIndex(wchar_t c)
+{
+    if (c >= L'0' && c <= L'9') return c - L'0';
+    if (c == L'%') return 10;
+    if (c == L'.') return 11;
+    if (c == L'-') return 12;
+    if (c == L'~') return 13;
+    return -1;
+}
+
+static void BuildLayout(HDC hdc, HFONT font, int dpi, int w, int h, const wchar_t* label, RenderLayout& layout)
+{
+    layout.font = font;
+    layout.dpi = dpi;
+    layout.w = w;
+    layout.h = h;
+    layout.label = label;
+    layout.valid = true;
+    ++g_stats.layoutMisses;
+
+    bool hasLabel = label && label[0] != L'\0';
+    layout.labelLen = hasLabel ? static_cast<int>(wcslen(label)) : 0;
+
+    SIZE labelSize = {};
+    if (hasLabel)
+        GetTextExtentPoint32W(hdc, label, layout.labelLen, &labelSize);
+
+    SIZE maxPctSize;
+    GetTextExtentPoint32W(hdc, L"100%", 4, &maxPctSize);
+
+    static const wchar_t kGlyphs[kLayoutGlyphCount] = {
+        L'0', L'1', L'2', L'3', L'4', L'5', L'6', L'7', L'8', L'9', L'%', L'.', L'-', L'~'};
+    for (int i = 0; i < kLayoutGlyphCount; ++i) {
+        INT advance = 0;
+        GetCharWidth32W(hdc, kGlyphs[i], kGlyphs[i], &advance);
+        layout.glyphAdvance[i] = advance;
+    }
+
+    int labelGap = 3;
+    int barPctGap = 6;
+    layout.barX = hasLabel ? labelSize.cx + labelGap : 0;
+    int pctAreaX = w - maxPctSize.cx;
+    layout.barW = pctAreaX - layout.barX - barPctGap;
+    if (layout.barW < 10) layout.barW = 10;
+
+    layout.barH = h * 30 / 100;
+    if (layout.barH < 3) layout.barH = 3;
+    layout.barY = (h - layout.barH) / 2;
+    layout.textY = (h - maxPctSize.cy) / 2;
+}
+
+static int MeasurePct(const RenderLayout& layout, const wchar_t* text, int len)
+{
+    int width = 0;
+    for (int i = 0; i < len; ++i) {
+        int g = GlyphIndex(text[i]);
+        if (g >= 0) width += layout.glyphAdvance[g];
+    }
+    return width;
+}
+
 void RenderUsageItem(
     HDC hdc, int x, int y, int w, int h,
+    int dpi,
+    RenderLayout& layout,
     bool dark_mode,
     const wchar_t* label,
     double pct,
     bool has_data,
-    bool refreshing)
+    int busyPhase,
+    bool stale,
+    bool estimated)
 {
+    ++g_stats.frames;
+
+    HFONT font = static_cast<HFONT>(GetCurrentObject(hdc, OBJ_FONT));
+    if (!layout.valid || layout.font != font || layout.dpi != dpi
+        || layout.w != w || layout.h != h || layout.label != label)
+        BuildLayout(hdc, font, dpi, w, h, label, layout);
+
     RECT itemRect = {x, y, x + w, y + h};
     ExtTextOut(hdc, 0, 0, ETO_OPAQUE, &itemRect, nullptr, 0, nullptr);
 
@@ -35,60 +143,41 @@ void RenderUsageItem(
     COLORREF pctColor   = dark_mode ? kPctDark   : kPctLight;
     COLORREF trackColor = dark_mode ? kTrackDark  : kTrackLight;
 
-    bool hasLabel = label && label[0] != L'\0';
-
-    SIZE labelSize = {};
-    if (hasLabel)
-        GetTextExtentPoint32W(hdc, label, static_cast<int>(wcslen(label)), &labelSize);
+    bool refreshing = busyPhase > 0;
 
     wchar_t pctText[16];
     if (refreshing)
-        swprintf_s(pctText, L"...");
+        swprintf_s(pctText, L"%.*s", busyPhase, L"...");
     else if (has_data)
-        swprintf_s(pctText, L"%.0f%%", pct);
+        swprintf_s(pctText, estimated ? L"~%.0f%%" : L"%.0f%%", pct);
     else
         swprintf_s(pctText, L"--");
+    int pctLen = static_cast<int>(wcslen(pctText));
+    int pctX = x + w - MeasurePct(layout, pctText, pctLen);
 
-    SIZE pctSize;
-    GetTextExtentPoint32W(hdc, pctText, static_cast<int>(wcslen(pctText)), &pctSize);
-
-    SIZE maxPctSize;
-    GetTextExtentPoint32W(hdc, L"100%", 4, &maxPctSize);
-
-    int labelGap = 3;
-    int barPctGap = 6;
-    int barX = hasLabel ? x + labelSize.cx + labelGap : x;
-    int pctAreaX = x + w - maxPctSize.cx;
-    int pctX = pctAreaX + (maxPctSize.cx - pctSize.cx);
-    int barW = pctAreaX - barX - barPctGap;
-
-    if (barW < 10) barW = 10;
-
-    int barH = h * 30 / 100;
-    if (barH < 3) barH = 3;
-    int barY = y + (h - barH) / 2;
-
-    if (hasLabel) {
+    if (layout.labelLen > 0) {
         SetTextColor(hdc, labelColor);
-        RECT labelRect = {x, y, x + labelSize.cx, y + h};
-        DrawTextW(hdc, label, -1, &labelRect, DT_LEFT | DT_VCENTER | DT_SINGLELINE | DT_NOCLIP);
+        ExtTextOutW(hdc, x, y + layout.textY, 0, nullptr, label, layout.labelLen, nullptr);
     }
 
-    RECT trackRect = {barX, barY, barX + barW, barY + barH};
-    HBRUSH trackBrush = CreateSolidBrush(trackColor);
-    FillRect(hdc, &trackRect, trackBrush);
-    DeleteObject(trackBrush);
+    int barX = x + layout.barX;
+    int barY = y + layout.barY;
+    RECT trackRect = {barX, barY, barX + layout.barW, barY + layout.barH};
+    // The DC brush avoids creating a GDI object per fill.
+    HBRUSH dcBrush = static_cast<HBRUSH>(GetStockObject(DC_BRUSH));
+    SetDCBrushColor(hdc, trackColor);
+    FillRect(hdc, &trackRect, dcBrush);
 
     if (has_data && pct > 0.0) {
-        int fillW = static_cast<int>(barW * pct / 100.0);
+        int fillW = static_cast<int>(layout.barW * pct / 100.0);
         if (fillW < 1 && pct > 0.0) fillW = 1;
-        RECT fillRect = {barX, barY, barX + fillW, barY + barH};
-        HBRUSH fillBrush = CreateSolidBrush(BarColorForPct(pct));
-        FillRect(hdc, &fillRect, fillBrush);
-        DeleteObject(fillBrush);
+        RECT fillRect = {barX, barY, barX + fillW, barY + layout.barH};
+        COLORREF fillColor = BarColorForPct(pct);
+        if (stale) fillColor = LerpColor(fillColor, trackColor, 0.5);
+        SetDCBrushColor(hdc, fillColor);
+        FillRect(hdc, &fillRect, dcBrush);
     }
 
-    SetTextColor(hdc, pctColor);
-    RECT pctRect = {pctX, y, pctX + pctSize.cx, y + h};
-    DrawTextW(hdc, pctText, -1, &pctRect, DT_LEFT | DT_VCENTER | DT_SINGLELINE | DT_NOCLIP);
+    SetTextColor(hdc, stale && !refreshing ? labelColor : pctColor);
+    ExtTextOutW(hdc, pctX, y + layout.textY, 0, nullptr, pctText, pctLen, nullptr);
 }
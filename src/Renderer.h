@@ -13,10 +13,58 @@ constexpr COLORREF kLabelLight  = RGB(0x55, 0x55, 0x55);
 constexpr COLORREF kPctDark     = RGB(0xFF, 0xFF, 0xFF);
 constexpr COLORREF kPctLight    = RGB(0x00, 0x00, 0x00);
 
+constexpr int kLayoutGlyphCount = 14;  // '0'-'9', '%', '.', '-', '~'
+
+// Geometry and glyph advances that only change with the font, DPI, item size
+// or label. Offsets are relative to the item origin.
+struct RenderLayout {
+    HFONT font = nullptr;
+    int dpi = 0;
+    int w = 0;
+    int h = 0;
+    const wchar_t* label = nullptr;
+    bool valid = false;
+
+    int labelLen = 0;
+    int textY = 0;
+    int barX = 0;
+    int barY = 0;
+    int barW = 0;
+    int barH = 0;
+    int glyphAdvance[kLayoutGlyphCount] = {};
+};
+
+// Eased bar transition driven by GetTickCount64 from DrawItem. Once the
+// transition has run its course Sample() is a single branch.
+struct BarAnimation {
+    double from = 0.0;
+    double to = 0.0;
+    ULONGLONG startTick = 0;
+    bool active = false;
+
+    void Retarget(double target, ULONGLONG now);
+    void Snap(double value);
+    double Sample(ULONGLONG now);
+};
+
+constexpr ULONGLONG kBarAnimationMs = 1500;
+constexpr ULONGLONG kBusyStepMs = 400;
+
+struct RenderStats {
+    unsigned long long frames = 0;
+    unsigned long long layoutMisses = 0;
+};
+
+const RenderStats& GetRenderStats();
+
 void RenderUsageItem(
     HDC hdc, int x, int y, int w, int h,
+    int dpi,
+    RenderLayout& layout,
     bool dark_mode,
     const wchar_t* label,
     double pct,
     bool has_data,
-    bool refreshing);
+    int busyPhase,
+    bool stale,
+    bool estimated = false);
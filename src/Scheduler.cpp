@@ -0,0 +1,384 @@
+#include "Scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+
+void TimerWheel::Insert(int id, uint64_t dueMs)
+{
+    Erase(id);
+
+    uint64_t tick = dueMs / kTickMs;
+    if (tick < m_cursorTick) tick = m_cursorTick;
+    size_t slot = static_cast<size_t>(tick % kSlots);
+
+    if (static_cast<size_t>(id) >= m_slotOf.size()) m_slotOf.resize(id + 1, -1);
+    m_slots[slot].push_back({id, dueMs});
+    m_slotOf[id] = static_cast<int>(slot);
+    ++m_size;
+}
+
+void TimerWheel::Erase(int id)
+{
+    if (static_cast<size_t>(id) >= m_slotOf.size() || m_slotOf[id] < 0) return;
+
+    auto& slot = m_slots[m_slotOf[id]];
+    for (size_t i = 0; i < slot.size(); ++i) {
+        if (slot[i].id != id) continue;
+        slot[i] = slot.back();
+        slot.pop_back();
+        break;
+    }
+    m_slotOf[id] = -1;
+    --m_size;
+}
+
+void TimerWheel::Expire(uint64_t nowMs, std::vector<int>& out)
+{
+    uint64_t nowTick = nowMs / kTickMs;
+    if (m_size == 0 || nowTick < m_cursorTick) {
+        if (nowTick > m_cursorTick) m_cursorTick = nowTick;
+        return;
+    }
+
+    // Stop on the current tick so entries due later within it are revisited.
+    uint64_t span = std::min<uint64_t>(nowTick - m_cursorTick, kSlots - 1);
+    for (uint64_t t = nowTick - span; t <= nowTick && m_size > 0; ++t) {
+        auto& slot = m_slots[t % kSlots];
+        for (size_t i = 0; i < slot.size();) {
+            if (slot[i].dueMs > nowMs) {
+                ++i;
+                continue;
+            }
+            out.push_back(slot[i].id);
+            m_slotOf[slot[i].id] = -1;
+            slot[i] = slot.back();
+            slot.pop_back();
+            --m_size;
+        }
+    }
+    m_cursorTick = nowTick;
+}
+
+bool TimerWheel::NextDue(uint64_t& dueMs) const
+{
+    if (m_size == 0) return false;
+
+    bool found = false;
+    for (const auto& slot : m_slots) {
+        for (const auto& e : slot) {
+            if (!found || e.dueMs < dueMs) dueMs = e.dueMs;
+            found = true;
+        }
+    }
+    return found;
+}
+
+Scheduler& Scheduler::Shared()
+{
+    static Scheduler instance;
+    return instance;
+}
+
+uint64_t Scheduler::NowMs()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+#ifdef _WIN32
+
+Scheduler::Scheduler()
+{
+    m_timer = CreateThreadpoolTimer(&Scheduler::OnTimer, this, nullptr);
+    m_blockingWork = CreateThreadpoolWork(&Scheduler::OnBlockingWork, this, nullptr);
+}
+
+Scheduler::~Scheduler()
+{
+    if (m_timer) {
+        SetThreadpoolTimer(m_timer, nullptr, 0, 0);
+        WaitForThreadpoolTimerCallbacks(m_timer, TRUE);
+        CloseThreadpoolTimer(m_timer);
+    }
+    if (m_blockingWork) {
+        WaitForThreadpoolWorkCallbacks(m_blockingWork, TRUE);
+        CloseThreadpoolWork(m_blockingWork);
+    }
+}
+
+VOID CALLBACK Scheduler::OnTimer(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_TIMER)
+{
+    CallbackMayRunLong(instance);
+    static_cast<Scheduler*>(context)->Dispatch();
+}
+
+VOID CALLBACK Scheduler::OnBlockingWork(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_WORK)
+{
+    CallbackMayRunLong(instance);
+    static_cast<Scheduler*>(context)->DrainBlocking();
+}
+
+void Scheduler::DrainBlocking()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_blockingQueue.empty()) {
+        TaskId id = m_blockingQueue.front();
+        m_blockingQueue.erase(m_blockingQueue.begin());
+        RunLocked(id, lock);
+    }
+    m_blockingActive = false;
+}
+
+void Scheduler::QueueBlockingLocked(TaskId id)
+{
+    if (m_tasks[id].queued) return;
+    m_tasks[id].queued = true;
+    m_blockingQueue.push_back(id);
+    if (m_blockingActive || !m_blockingWork) return;
+    m_blockingActive = true;
+    SubmitThreadpoolWork(m_blockingWork);
+}
+
+void Scheduler::ArmLocked()
+{
+    if (!m_timer) return;
+
+    uint64_t dueMs;
+    if (!m_wheel.NextDue(dueMs)) {
+        SetThreadpoolTimer(m_timer, nullptr, 0, 0);
+        return;
+    }
+
+    uint64_t now = NowMs();
+    uint64_t delayMs = dueMs > now ? dueMs - now : 0;
+    ULARGE_INTEGER relative;
+    relative.QuadPart = static_cast<ULONGLONG>(-static_cast<LONGLONG>(delayMs * 10000));
+    FILETIME ft;
+    ft.dwLowDateTime = relative.LowPart;
+    ft.dwHighDateTime = relative.HighPart;
+    auto window = std::min<uint64_t>(WakeWindowLocked(dueMs), MAXDWORD);
+    SetThreadpoolTimer(m_timer, &ft, 0, static_cast<DWORD>(window));
+}
+
+#else
+
+Scheduler::Scheduler()
+{
+    m_driver = std::thread(&Scheduler::DriverLoop, this);
+    m_blockingDriver = std::thread(&Scheduler::BlockingLoop, this);
+}
+
+Scheduler::~Scheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_blockingWake.notify_one();
+    if (m_driver.joinable()) m_driver.join();
+    if (m_blockingDriver.joinable()) m_blockingDriver.join();
+}
+
+void Scheduler::DriverLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stop) {
+        uint64_t dueMs;
+        if (!m_wheel.NextDue(dueMs)) {
+            m_armedMs = UINT64_MAX;
+            m_wake.wait(lock);
+            continue;
+        }
+        // Sleep to the end of the window every scheduled task tolerates, so
+        // tasks due close together share one wake-up.
+        uint64_t wakeMs = dueMs + WakeWindowLocked(dueMs);
+        uint64_t now = NowMs();
+        if (wakeMs > now) {
+            m_armedMs = wakeMs;
+            m_wake.wait_for(lock, std::chrono::milliseconds(wakeMs - now));
+            continue;
+        }
+        m_armedMs = 0;
+        lock.unlock();
+        Dispatch();
+        lock.lock();
+    }
+}
+
+void Scheduler::BlockingLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stop) {
+        if (m_blockingQueue.empty()) {
+            m_blockingWake.wait(lock);
+            continue;
+        }
+        TaskId id = m_blockingQueue.front();
+        m_blockingQueue.erase(m_blockingQueue.begin());
+        RunLocked(id, lock);
+    }
+}
+
+void Scheduler::ArmLocked()
+{
+    // The driver re-reads the wheel whenever it wakes, so only a deadline
+    // earlier than the one it sleeps toward needs to wake it now.
+    uint64_t dueMs;
+    if (m_wheel.NextDue(dueMs) && dueMs + WakeWindowLocked(dueMs) < m_armedMs) m_wake.notify_one();
+}
+
+void Scheduler::QueueBlockingLocked(TaskId id)
+{
+    if (m_tasks[id].queued) return;
+    m_tasks[id].queued = true;
+    m_blockingQueue.push_back(id);
+    m_blockingWake.notify_one();
+}
+
+#endif
+
+Scheduler::TaskId Scheduler::Add(TaskPriority priority, std::function<void()> fn, bool blocking)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    TaskId id = 0;
+    while (id < static_cast<TaskId>(m_tasks.size())
+        && (m_tasks[id].live || m_tasks[id].running || m_tasks[id].queued))
+        ++id;
+    if (id == static_cast<TaskId>(m_tasks.size())) m_tasks.emplace_back();
+
+    auto& task = m_tasks[id];
+    task.fn = std::move(fn);
+    task.priority = priority;
+    task.blocking = blocking;
+    task.live = true;
+    task.scheduled = false;
+    return id;
+}
+
+void Scheduler::Remove(TaskId id)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (id < 0 || id >= static_cast<TaskId>(m_tasks.size())) return;
+
+    auto& task = m_tasks[id];
+    task.live = false;
+    if (task.scheduled) {
+        m_wheel.Erase(id);
+        task.scheduled = false;
+    }
+    // The run holds its own copy of fn, so a task may remove itself.
+    if (!(task.running && task.runner == std::this_thread::get_id()))
+        m_idle.wait(lock, [this, id] { return !m_tasks[id].running; });
+    m_tasks[id].fn = nullptr;
+    ArmLocked();
+}
+
+uint64_t Scheduler::WakeWindowLocked(uint64_t dueMs) const
+{
+    uint64_t latest = UINT64_MAX;
+    for (const auto& task : m_tasks) {
+        if (task.scheduled) latest = std::min(latest, task.dueMs + task.toleranceMs);
+    }
+    return latest > dueMs && latest != UINT64_MAX ? latest - dueMs : 0;
+}
+
+void Scheduler::SetDueLocked(TaskId id, uint64_t dueMs, uint64_t toleranceMs)
+{
+    auto& task = m_tasks[id];
+    task.dueMs = dueMs;
+    task.toleranceMs = toleranceMs;
+    task.scheduled = true;
+    m_wheel.Insert(id, dueMs);
+    ArmLocked();
+}
+
+void Scheduler::ScheduleIn(TaskId id, uint64_t delayMs, uint64_t toleranceMs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (id < 0 || id >= static_cast<TaskId>(m_tasks.size()) || !m_tasks[id].live) return;
+
+    uint64_t due = NowMs() + delayMs;
+    if (m_tasks[id].scheduled && m_tasks[id].dueMs <= due) return;
+    SetDueLocked(id, due, toleranceMs);
+}
+
+void Scheduler::Reschedule(TaskId id, uint64_t delayMs, uint64_t toleranceMs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (id < 0 || id >= static_cast<TaskId>(m_tasks.size()) || !m_tasks[id].live) return;
+
+    SetDueLocked(id, NowMs() + delayMs, toleranceMs);
+}
+
+void Scheduler::Cancel(TaskId id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (id < 0 || id >= static_cast<TaskId>(m_tasks.size()) || !m_tasks[id].scheduled) return;
+
+    m_wheel.Erase(id);
+    m_tasks[id].scheduled = false;
+    ArmLocked();
+}
+
+bool Scheduler::IsScheduled(TaskId id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (id < 0 || id >= static_cast<TaskId>(m_tasks.size())) return false;
+    auto& task = m_tasks[id];
+    return task.live && (task.scheduled || task.queued);
+}
+
+SchedulerStats Scheduler::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void Scheduler::Dispatch()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    ++m_stats.wakeups;
+    // A run already in progress re-checks the wheel before it returns.
+    if (m_dispatching) return;
+    m_dispatching = true;
+
+    std::vector<int> ready;
+    for (;;) {
+        ready.clear();
+        m_wheel.Expire(NowMs(), ready);
+        if (ready.empty()) break;
+
+        for (int id : ready) m_tasks[id].scheduled = false;
+        std::stable_sort(ready.begin(), ready.end(), [this](int a, int b) {
+            return m_tasks[a].priority < m_tasks[b].priority;
+        });
+
+        for (int id : ready) {
+            if (!m_tasks[id].live || m_tasks[id].scheduled) continue;
+            if (m_tasks[id].blocking) QueueBlockingLocked(id);
+            else RunLocked(id, lock);
+        }
+    }
+
+    m_dispatching = false;
+    ArmLocked();
+}
+
+void Scheduler::RunLocked(TaskId id, std::unique_lock<std::mutex>& lock)
+{
+    m_tasks[id].queued = false;
+    if (!m_tasks[id].live) return;
+
+    m_tasks[id].running = true;
+    m_tasks[id].runner = std::this_thread::get_id();
+    auto fn = m_tasks[id].fn;
+    lock.unlock();
+    fn();
+    lock.lock();
+    m_tasks[id].running = false;
+    m_tasks[id].runner = std::thread::id();
+    ++m_stats.tasksRun;
+    m_idle.notify_all();
+}
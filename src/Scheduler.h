@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+enum class TaskPriority { High = 0, Normal = 1, Low = 2 };
+
+// Hashed timing wheel keyed by small integer ids. Not thread-safe.
+class TimerWheel {
+public:
+    static constexpr uint64_t kTickMs = 50;
+    static constexpr size_t kSlots = 512;
+
+    void Insert(int id, uint64_t dueMs);
+    void Erase(int id);
+    // Appends every id due at or before nowMs to out and removes it.
+    void Expire(uint64_t nowMs, std::vector<int>& out);
+    bool NextDue(uint64_t& dueMs) const;
+    size_t Size() const { return m_size; }
+
+private:
+    struct Entry {
+        int id;
+        uint64_t dueMs;
+    };
+
+    std::vector<Entry> m_slots[kSlots];
+    std::vector<int> m_slotOf;
+    uint64_t m_cursorTick = 0;
+    size_t m_size = 0;
+};
+
+struct SchedulerStats {
+    uint64_t wakeups = 0;
+    uint64_t tasksRun = 0;
+};
+
+// Runs callbacks off a single shared timer; ready tasks run in priority order
+// within one wake-up. Short tasks run on the timer's thread, one at a time.
+// Tasks added as blocking (network calls, directory scans) run one at a time
+// on a lane of their own, so a slow request never holds up a short task; a
+// short task may run while a blocking one is in flight. No task may wait for
+// another task to finish.
+class Scheduler {
+public:
+    using TaskId = int;
+
+    static Scheduler& Shared();
+    static uint64_t NowMs();
+
+    Scheduler();
+    ~Scheduler();
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    TaskId Add(TaskPriority priority, std::function<void()> fn, bool blocking = false);
+    // Unschedules the task and waits for an in-flight run to finish, unless
+    // called from that run. Never call it from DllMain: the run may need the
+    // loader lock, and at process exit its thread is already gone.
+    void Remove(TaskId id);
+
+    // toleranceMs is how late the task may run so the wake-up can be
+    // coalesced with other system timers.
+    // Keeps an earlier due time if one is already set.
+    void ScheduleIn(TaskId id, uint64_t delayMs, uint64_t toleranceMs = 0);
+    // Replaces any existing due time.
+    void Reschedule(TaskId id, uint64_t delayMs, uint64_t toleranceMs = 0);
+    void Cancel(TaskId id);
+    // True while the task is due or waiting its turn on the blocking lane.
+    bool IsScheduled(TaskId id);
+
+    SchedulerStats GetStats();
+
+private:
+    struct Task {
+        std::function<void()> fn;
+        TaskPriority priority = TaskPriority::Normal;
+        bool blocking = false;
+        bool live = false;
+        bool scheduled = false;
+        // Waiting in the blocking lane's queue.
+        bool queued = false;
+        bool running = false;
+        std::thread::id runner;
+        uint64_t dueMs = 0;
+        uint64_t toleranceMs = 0;
+    };
+
+    void SetDueLocked(TaskId id, uint64_t dueMs, uint64_t toleranceMs);
+    // Slack after dueMs that every scheduled task can still absorb.
+    uint64_t WakeWindowLocked(uint64_t dueMs) const;
+    void Dispatch();
+    void ArmLocked();
+    void QueueBlockingLocked(TaskId id);
+    void RunLocked(TaskId id, std::unique_lock<std::mutex>& lock);
+
+    std::mutex m_mutex;
+    std::condition_variable m_idle;
+    std::vector<Task> m_tasks;
+    std::vector<TaskId> m_blockingQueue;
+    TimerWheel m_wheel;
+    bool m_dispatching = false;
+    SchedulerStats m_stats;
+
+#ifdef _WIN32
+    static VOID CALLBACK OnTimer(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_TIMER timer);
+    static VOID CALLBACK OnBlockingWork(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_WORK work);
+    void DrainBlocking();
+    PTP_TIMER m_timer = nullptr;
+    PTP_WORK m_blockingWork = nullptr;
+    bool m_blockingActive = false;
+#else
+    void DriverLoop();
+    void BlockingLoop();
+    std::thread m_driver;
+    std::thread m_blockingDriver;
+    std::condition_variable m_wake;
+    std::condition_variable m_blockingWake;
+    // When the driver next wakes on its own; 0 while it is dispatching.
+    uint64_t m_armedMs = 0;
+    bool m_stop = false;
+#endif
+};
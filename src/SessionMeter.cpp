@@ -0,0 +1,142 @@
+#include "SessionMeter.h"
+
+#include <algorithm>
+
+// Lets a burst of appended lines settle into one read.
+static const uint64_t kSettleMs = 250;
+static const uint64_t kRetryMs = 60 * 1000;
+
+// root/<project>/<session>.jsonl, not a subagent transcript further down.
+static bool IsSessionTranscript(const std::wstring& root, const std::wstring& path)
+{
+    if (path.size() <= root.size() + 1 || path.compare(0, root.size(), root) != 0) return false;
+    return std::count(path.begin() + root.size() + 1, path.end(), kPathSeparator) == 1;
+}
+
+void SessionMeter::Start(const std::wstring& root)
+{
+    Stop();
+    m_root = root;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_usage = SessionUsage();
+    m_rescan = true;
+    m_task = Scheduler::Shared().Add(TaskPriority::Low, [this] { Update(); }, true);
+    Scheduler::Shared().ScheduleIn(m_task, 0);
+}
+
+void SessionMeter::Stop()
+{
+    Scheduler::TaskId task;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        task = m_task;
+        m_task = -1;
+        m_changed.clear();
+    }
+    if (task >= 0) Scheduler::Shared().Remove(task);
+    m_watcher.Stop();
+    m_current.clear();
+    m_tails.clear();
+}
+
+void SessionMeter::CopyUsage(SessionUsage& out)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    out = m_usage;
+}
+
+void SessionMeter::OnChange(const std::wstring& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_task < 0) return;
+    if (path.empty()) m_rescan = true;
+    else m_changed = path;
+    Scheduler::Shared().ScheduleIn(m_task, kSettleMs, kSettleMs);
+}
+
+std::wstring SessionMeter::FindNewest() const
+{
+    std::wstring newest;
+    uint64_t newestWrite = 0;
+    EnumerateFiles(m_root, L".jsonl", [&](const std::wstring& path, const FileStamp& stamp) {
+        if (stamp.lastWrite < newestWrite || !IsSessionTranscript(m_root, path)) return;
+        newest = path;
+        newestWrite = stamp.lastWrite;
+    });
+    return newest;
+}
+
+uint64_t SessionMeter::ReadAppended(const std::wstring& path, FileTail& tail)
+{
+    MappedFile file;
+    if (!file.Open(path)) return 0;
+    // Rewritten rather than appended to; count it again from the start.
+    if (file.Size() < tail.offset) tail = FileTail();
+
+    const char* begin = file.Data() + tail.offset;
+    const char* end = file.Data() + file.Size();
+    const char* p = begin;
+    TranscriptUsageLine line;
+    for (const char* nl; p < end && (nl = FindNewline(p, end)) != end; p = nl + 1) {
+        if (!ParseTranscriptLine(std::string_view(p, nl - p), line)) continue;
+        tail.lastActivityMs = (std::max)(tail.lastActivityMs, line.timeMs);
+        if (!line.messageHash) {
+            tail.tokens += line.tokens;
+            ++tail.messages;
+            continue;
+        }
+        // A message streamed over several lines counts once, at its largest.
+        auto [it, inserted] = tail.seen.try_emplace(line.messageHash);
+        auto& counted = it->second;
+        if (inserted) ++tail.messages;
+        TokenCounts grown;
+        grown.input = (std::max)(counted.input, line.tokens.input) - counted.input;
+        grown.output = (std::max)(counted.output, line.tokens.output) - counted.output;
+        grown.cacheCreation = (std::max)(counted.cacheCreation, line.tokens.cacheCreation) - counted.cacheCreation;
+        grown.cacheRead = (std::max)(counted.cacheRead, line.tokens.cacheRead) - counted.cacheRead;
+        counted += grown;
+        tail.tokens += grown;
+    }
+    tail.offset += p - begin;
+    return p - begin;
+}
+
+void SessionMeter::Update()
+{
+    std::wstring changed;
+    bool rescan;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        changed.swap(m_changed);
+        rescan = m_rescan;
+        m_rescan = false;
+    }
+
+    if (!m_watcher.IsRunning()) {
+        if (!m_watcher.Start(m_root, [this](const std::wstring& path) { OnChange(path); })) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_rescan = true;
+            Scheduler::Shared().ScheduleIn(m_task, kRetryMs, kRetryMs);
+            return;
+        }
+        rescan = true;
+    }
+
+    if (rescan) {
+        auto newest = FindNewest();
+        if (!newest.empty()) changed = newest;
+    }
+    if (!changed.empty()) m_current = changed;
+    if (m_current.empty()) return;
+
+    auto& tail = m_tails[m_current];
+    uint64_t read = ReadAppended(m_current, tail);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_usage.tokens = tail.tokens;
+    m_usage.messages = tail.messages;
+    m_usage.lastActivityMs = tail.lastActivityMs;
+    m_usage.lastReadBytes = read;
+    m_usage.totalReadBytes += read;
+    ++m_usage.updates;
+}
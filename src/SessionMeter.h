@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Scheduler.h"
+#include "TranscriptScanner.h"
+#include "TranscriptWatcher.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+struct SessionUsage {
+    TokenCounts tokens;
+    uint64_t messages = 0;
+    // Unix ms of the newest counted line; 0 until there is one.
+    int64_t lastActivityMs = 0;
+    uint64_t updates = 0;
+    // Bytes read by the latest update and since Start.
+    uint64_t lastReadBytes = 0;
+    uint64_t totalReadBytes = 0;
+};
+
+// Running token counts for the Claude Code session in progress, taken to be
+// the transcript written most recently. Change notifications from the
+// transcripts root schedule an update that reads only the bytes appended
+// since the last one; each file keeps its own offset and totals, so moving
+// between two open sessions never re-reads either.
+class SessionMeter {
+public:
+    ~SessionMeter() { Stop(); }
+
+    // A root that does not exist yet is retried until it does.
+    void Start(const std::wstring& root);
+    void Stop();
+    void CopyUsage(SessionUsage& out);
+
+private:
+    struct FileTail {
+        uint64_t offset = 0;
+        TokenCounts tokens;
+        uint64_t messages = 0;
+        int64_t lastActivityMs = 0;
+        // Message hash to the counts already added for it.
+        std::unordered_map<uint64_t, TokenCounts> seen;
+    };
+
+    void OnChange(const std::wstring& path);
+    void Update();
+    std::wstring FindNewest() const;
+    uint64_t ReadAppended(const std::wstring& path, FileTail& tail);
+
+    std::mutex m_mutex;
+    Scheduler::TaskId m_task = -1;
+    std::wstring m_changed;
+    bool m_rescan = false;
+    SessionUsage m_usage;
+
+    // Only touched by the update task.
+    std::wstring m_root;
+    TranscriptWatcher m_watcher;
+    std::wstring m_current;
+    std::unordered_map<std::wstring, FileTail> m_tails;
+};
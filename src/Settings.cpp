@@ -1,5 +1,5 @@
 #include "Settings.h"
-#include <shlobj.h>
+#include "Platform.h"
 
 Settings& Settings::Instance()
 {
@@ -7,21 +7,118 @@ Settings& Settings::Instance()
     return s;
 }
 
+Settings::Snapshot::Snapshot(const Settings& owner)
+    : m_owner(owner)
+{
+    m_owner.m_readers.fetch_add(1);
+    m_settings = m_owner.m_current.load();
+}
+
+Settings::Snapshot::~Snapshot()
+{
+    if (m_owner.m_readers.fetch_sub(1) == 1 && m_owner.m_hasRetired.load(std::memory_order_relaxed))
+        m_owner.Reclaim();
+}
+
+Settings::Settings()
+    : m_owned(std::make_unique<const PluginSettings>())
+{
+    m_current.store(m_owned.get());
+}
+
+void Settings::Publish(PluginSettings next)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_publishMutex);
+        next.version = m_owned->version + 1;
+        m_retired.push_back(std::move(m_owned));
+        m_owned = std::make_unique<const PluginSettings>(std::move(next));
+        m_current.store(m_owned.get());
+        m_hasRetired.store(true);
+    }
+    Reclaim();
+}
+
+void Settings::Reclaim() const
+{
+    std::unique_lock<std::mutex> lock(m_publishMutex, std::try_to_lock);
+    if (!lock.owns_lock() || m_readers.load() != 0) return;
+    m_retired.clear();
+    m_hasRetired.store(false);
+}
+
+size_t Settings::RetainedSnapshots() const
+{
+    std::lock_guard<std::mutex> lock(m_publishMutex);
+    return m_retired.size();
+}
+
+#ifdef _WIN32
 void Settings::SetDllModule(HMODULE hModule)
 {
     m_hModule = hModule;
 }
+#endif
 
-std::wstring Settings::GetIniPath() const
+void Settings::SetBasePath(const std::wstring& stem)
+{
+    m_basePath = stem;
+}
+
+std::wstring Settings::GetModuleSiblingPath(const wchar_t* extension) const
 {
+    if (!m_basePath.empty()) return m_basePath + extension;
+
+#ifdef _WIN32
     wchar_t dllPath[MAX_PATH] = {};
     GetModuleFileNameW(m_hModule, dllPath, MAX_PATH);
     std::wstring path(dllPath);
     auto dot = path.rfind(L'.');
     if (dot != std::wstring::npos)
         path = path.substr(0, dot);
-    path += L".ini";
+#else
+    // A relative stem would drop state into whatever directory the process
+    // started in; without a base path nothing is persisted instead.
+    std::wstring path;
     return path;
+#endif
+    path += extension;
+    return path;
+}
+
+std::wstring Settings::GetIniPath() const
+{
+    return GetModuleSiblingPath(L".ini");
+}
+
+std::wstring Settings::GetSnapshotPath() const
+{
+    return GetModuleSiblingPath(L".snapshot.json");
+}
+
+std::wstring Settings::GetArchivePath() const
+{
+    return GetModuleSiblingPath(L".archive");
+}
+
+std::wstring Settings::GetTranscriptIndexPath() const
+{
+    return GetModuleSiblingPath(L".transcripts");
+}
+
+std::wstring Settings::GetUiWatchdogLogPath() const
+{
+    return GetModuleSiblingPath(L".slow.jsonl");
+}
+
+std::wstring Settings::GetDiagnosticsPath() const
+{
+    return GetModuleSiblingPath(L".diagnostics.json");
+}
+
+std::wstring Settings::GetTraceDumpPath() const
+{
+    return GetModuleSiblingPath(L".trace.jsonl");
 }
 
 void Settings::Load()
@@ -29,48 +126,72 @@ void Settings::Load()
     auto ini = GetIniPath();
     const wchar_t* section = L"Settings";
 
-    wchar_t buf[MAX_PATH] = {};
-    GetPrivateProfileStringW(section, L"CredentialsPath", L"", buf, MAX_PATH, ini.c_str());
-    m_settings.credentialsPath = buf;
+    PluginSettings settings;
+
+    settings.credentialsPath = ReadIniString(ini, section, L"CredentialsPath", L"");
+
+    settings.itemWidth = ReadIniInt(ini, section, L"ItemWidth", 160);
+    if (settings.itemWidth < 80) settings.itemWidth = 80;
+    if (settings.itemWidth > 400) settings.itemWidth = 400;
+
+    settings.pollInterval = ReadIniInt(ini, section, L"PollInterval", 60);
+    if (settings.pollInterval < 10) settings.pollInterval = 10;
+    if (settings.pollInterval > 3600) settings.pollInterval = 3600;
 
-    m_settings.itemWidth = GetPrivateProfileIntW(section, L"ItemWidth", 160, ini.c_str());
-    if (m_settings.itemWidth < 80) m_settings.itemWidth = 80;
-    if (m_settings.itemWidth > 400) m_settings.itemWidth = 400;
+    settings.minRefreshSpacing = ReadIniInt(ini, section, L"MinRefreshSpacing", 5);
+    if (settings.minRefreshSpacing < 0) settings.minRefreshSpacing = 0;
+    if (settings.minRefreshSpacing > 300) settings.minRefreshSpacing = 300;
 
-    m_settings.pollInterval = GetPrivateProfileIntW(section, L"PollInterval", 60, ini.c_str());
-    if (m_settings.pollInterval < 10) m_settings.pollInterval = 10;
-    if (m_settings.pollInterval > 3600) m_settings.pollInterval = 3600;
+    settings.hedgeBudgetPct = ReadIniInt(ini, section, L"HedgeBudget", 5);
+    if (settings.hedgeBudgetPct < 0) settings.hedgeBudgetPct = 0;
+    if (settings.hedgeBudgetPct > 50) settings.hedgeBudgetPct = 50;
+
+    settings.apiBudgetPerHour = ReadIniInt(ini, section, L"ApiBudget", 120);
+    if (settings.apiBudgetPerHour < 0) settings.apiBudgetPerHour = 0;
+    if (settings.apiBudgetPerHour > 3600) settings.apiBudgetPerHour = 3600;
+
+    settings.proxyUrl = ReadIniString(ini, section, L"ProxyUrl", L"");
+    settings.proxyBypass = ReadIniString(ini, section, L"ProxyBypass", L"");
+
+    const wchar_t* debugSection = L"Debug";
+    settings.recordTracePath = ReadIniString(ini, debugSection, L"RecordTrace", L"");
+    settings.replayTracePath = ReadIniString(ini, debugSection, L"ReplayTrace", L"");
+    settings.replayTimeScalePct = ReadIniInt(ini, debugSection, L"ReplayTimeScale", 100);
+    if (settings.replayTimeScalePct < 0) settings.replayTimeScalePct = 0;
+    settings.uiBudgetMs = ReadIniInt(ini, debugSection, L"UiBudgetMs", 8);
+    if (settings.uiBudgetMs < 0) settings.uiBudgetMs = 0;
+    if (settings.uiBudgetMs > 1000) settings.uiBudgetMs = 1000;
+
+    Publish(std::move(settings));
 }
 
 void Settings::Save()
 {
     auto ini = GetIniPath();
     const wchar_t* section = L"Settings";
+    auto settings = Get();
 
-    WritePrivateProfileStringW(section, L"CredentialsPath",
-        m_settings.credentialsPath.c_str(), ini.c_str());
-
-    WritePrivateProfileStringW(section, L"ItemWidth",
-        std::to_wstring(m_settings.itemWidth).c_str(), ini.c_str());
-
-    WritePrivateProfileStringW(section, L"PollInterval",
-        std::to_wstring(m_settings.pollInterval).c_str(), ini.c_str());
+    WriteIniString(ini, section, L"CredentialsPath", settings->credentialsPath);
+    WriteIniString(ini, section, L"ItemWidth", std::to_wstring(settings->itemWidth));
+    WriteIniString(ini, section, L"PollInterval", std::to_wstring(settings->pollInterval));
+    WriteIniString(ini, section, L"MinRefreshSpacing", std::to_wstring(settings->minRefreshSpacing));
+    WriteIniString(ini, section, L"HedgeBudget", std::to_wstring(settings->hedgeBudgetPct));
+    WriteIniString(ini, section, L"ApiBudget", std::to_wstring(settings->apiBudgetPerHour));
+    WriteIniString(ini, section, L"ProxyUrl", settings->proxyUrl);
+    WriteIniString(ini, section, L"ProxyBypass", settings->proxyBypass);
 }
 
 std::wstring Settings::GetDefaultCredentialsPath()
 {
-    wchar_t* profile = nullptr;
-    if (FAILED(SHGetKnownFolderPath(FOLDERID_Profile, 0, nullptr, &profile)) || !profile)
-        return L"";
-    std::wstring path(profile);
-    CoTaskMemFree(profile);
-    path += L"\\.claude\\.credentials.json";
-    return path;
+    auto home = HomeDirectory();
+    if (home.empty()) return L"";
+    return home + kPathSeparator + L".claude" + kPathSeparator + L".credentials.json";
 }
 
 std::wstring Settings::GetEffectiveCredentialsPath() const
 {
-    if (!m_settings.credentialsPath.empty())
-        return m_settings.credentialsPath;
+    auto settings = Get();
+    if (!settings->credentialsPath.empty())
+        return settings->credentialsPath;
     return GetDefaultCredentialsPath();
 }
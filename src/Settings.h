@@ -1,32 +1,98 @@
 #pragma once
 
+#include <string>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
-#include <string>
+#endif
 
 struct PluginSettings {
     std::wstring credentialsPath;
     int itemWidth = 160;
     int pollInterval = 60;
+    int minRefreshSpacing = 5;
+    int hedgeBudgetPct = 5;
+    int apiBudgetPerHour = 120;
+    std::wstring proxyUrl;
+    std::wstring proxyBypass;
+    std::wstring recordTracePath;
+    std::wstring replayTracePath;
+    int replayTimeScalePct = 100;
+    // UI entry points slower than this are logged; 0 turns the log off.
+    int uiBudgetMs = 8;
+    uint64_t version = 0;
 };
 
+// Settings are published as immutable snapshots. Readers pin the current
+// one with Get() and never lock; a replaced snapshot is freed by whichever
+// Publish() or last departing reader finds no pinned snapshots left, so
+// hold a Snapshot only for the span of a read.
 class Settings {
 public:
+    class Snapshot {
+    public:
+        explicit Snapshot(const Settings& owner);
+        ~Snapshot();
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        const PluginSettings& operator*() const { return *m_settings; }
+        const PluginSettings* operator->() const { return m_settings; }
+        operator const PluginSettings&() const { return *m_settings; }
+
+    private:
+        const Settings& m_owner;
+        const PluginSettings* m_settings;
+    };
+
     static Settings& Instance();
 
+#ifdef _WIN32
     void SetDllModule(HMODULE hModule);
+#endif
+    // Directory and file stem the .ini, snapshot and archive live beside;
+    // the plugin DLL's own path unless set. Off Windows there is no such
+    // default, and the paths below are empty until this is called.
+    void SetBasePath(const std::wstring& stem);
     void Load();
     void Save();
 
-    const PluginSettings& Get() const { return m_settings; }
-    PluginSettings& GetMutable() { return m_settings; }
+    Snapshot Get() const { return Snapshot(*this); }
+    void Publish(PluginSettings next);
+    // Replaced snapshots still waiting for their readers to leave.
+    size_t RetainedSnapshots() const;
 
     std::wstring GetEffectiveCredentialsPath() const;
     std::wstring GetIniPath() const;
+    std::wstring GetSnapshotPath() const;
+    std::wstring GetArchivePath() const;
+    std::wstring GetTranscriptIndexPath() const;
+    std::wstring GetUiWatchdogLogPath() const;
+    std::wstring GetDiagnosticsPath() const;
+    std::wstring GetTraceDumpPath() const;
     static std::wstring GetDefaultCredentialsPath();
 
 private:
-    Settings() = default;
+    Settings();
+    std::wstring GetModuleSiblingPath(const wchar_t* extension) const;
+    // Frees the replaced snapshots if no reader is left; never blocks.
+    void Reclaim() const;
+#ifdef _WIN32
     HMODULE m_hModule = nullptr;
-    PluginSettings m_settings;
+#endif
+    std::wstring m_basePath;
+    std::atomic<const PluginSettings*> m_current;
+    // Readers count themselves in before loading m_current, so a count of
+    // zero seen after a swap means nobody can still hold a replaced one.
+    mutable std::atomic<uint32_t> m_readers{0};
+    mutable std::atomic<bool> m_hasRetired{false};
+    mutable std::mutex m_publishMutex;
+    std::unique_ptr<const PluginSettings> m_owned;
+    mutable std::vector<std::unique_ptr<const PluginSettings>> m_retired;
 };
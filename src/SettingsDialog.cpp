@@ -43,7 +43,7 @@ static void OnBrowse(HWND hDlg)
 
 static bool OnOK()
 {
-    auto& settings = Settings::Instance().GetMutable();
+    PluginSettings settings = Settings::Instance().Get();
 
     wchar_t buf[MAX_PATH] = {};
     GetWindowTextW(hCredPath, buf, MAX_PATH);
@@ -71,6 +71,7 @@ static bool OnOK()
     }
     settings.pollInterval = p;
 
+    Settings::Instance().Publish(std::move(settings));
     Settings::Instance().Save();
     return true;
 }
@@ -129,9 +130,9 @@ bool ShowSettingsDialog(HWND hParent)
         (screenW - winW) / 2, (screenH - winH) / 2, winW, winH,
         hParent, nullptr, GetModuleHandle(nullptr), nullptr);
 
-    auto& s = Settings::Instance().Get();
-    auto displayPath = s.credentialsPath.empty()
-        ? Settings::GetDefaultCredentialsPath() : s.credentialsPath;
+    auto s = Settings::Instance().Get();
+    auto displayPath = s->credentialsPath.empty()
+        ? Settings::GetDefaultCredentialsPath() : s->credentialsPath;
 
     int y = kMargin;
     int contentW = kClientW - kMargin * 2;
@@ -163,7 +164,7 @@ bool ShowSettingsDialog(HWND hParent)
     CreateWindowW(L"STATIC", L"Item Width:", WS_CHILD | WS_VISIBLE,
         kMargin, y + 3, labelW, kLabelH, hDlg, nullptr, nullptr, nullptr);
     wchar_t widthStr[16];
-    swprintf_s(widthStr, L"%d", s.itemWidth);
+    swprintf_s(widthStr, L"%d", s->itemWidth);
     hItemWidth = CreateWindowW(L"EDIT", widthStr,
         WS_CHILD | WS_VISIBLE | WS_BORDER | ES_NUMBER,
         numEditX, y, numEditW, kEditH, hDlg, (HMENU)ID_ITEM_WIDTH, nullptr, nullptr);
@@ -172,7 +173,7 @@ bool ShowSettingsDialog(HWND hParent)
     CreateWindowW(L"STATIC", L"Poll Interval (sec):", WS_CHILD | WS_VISIBLE,
         kMargin, y + 3, labelW, kLabelH, hDlg, nullptr, nullptr, nullptr);
     wchar_t pollStr[16];
-    swprintf_s(pollStr, L"%d", s.pollInterval);
+    swprintf_s(pollStr, L"%d", s->pollInterval);
     hPollInterval = CreateWindowW(L"EDIT", pollStr,
         WS_CHILD | WS_VISIBLE | WS_BORDER | ES_NUMBER,
         numEditX, y, numEditW, kEditH, hDlg, (HMENU)ID_POLL_INTERVAL, nullptr, nullptr);
@@ -0,0 +1,63 @@
+#include "SnapshotStore.h"
+#include "Platform.h"
+
+#include <nlohmann/json.hpp>
+#include <fstream>
+#include <sstream>
+
+using json = nlohmann::json;
+
+static const int kSnapshotVersion = 2;
+
+bool SaveUsageSnapshot(const std::wstring& path, const UsageData& data)
+{
+    json windows = json::array();
+    for (int i = 0; i < data.usage.count; ++i) {
+        auto& w = data.usage.windows[i];
+        windows.push_back({{"key", w.key}, {"pct", w.pct}, {"resets_at", w.resetsAt}});
+    }
+
+    json j = {
+        {"version", kSnapshotVersion},
+        {"fetched_at", data.fetched_at},
+        {"windows", std::move(windows)},
+    };
+
+    auto tmpPath = path + L".tmp";
+    {
+        std::ofstream file(NativePath(tmpPath), std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+        file << j.dump();
+        if (!file.good()) return false;
+    }
+    return ReplaceFileAtomically(tmpPath, path);
+}
+
+bool LoadUsageSnapshot(const std::wstring& path, UsageData& out)
+{
+    std::ifstream file(NativePath(path), std::ios::binary);
+    if (!file.is_open()) return false;
+    std::ostringstream ss;
+    ss << file.rdbuf();
+
+    try {
+        auto j = json::parse(ss.str());
+        if (j.value("version", 0) != kSnapshotVersion) return false;
+
+        UsageData data;
+        data.fetched_at = j.at("fetched_at").get<int64_t>();
+        for (auto& w : j.at("windows")) {
+            auto* window = data.usage.Add(w.at("key").get_ref<const std::string&>().c_str());
+            if (!window) continue;
+            window->pct = w.at("pct").get<double>();
+            window->resetsAt = w.at("resets_at").get<int64_t>();
+        }
+        if (data.fetched_at <= 0) return false;
+
+        data.stale = true;
+        out = data;
+        return true;
+    } catch (const json::exception&) {
+        return false;
+    }
+}
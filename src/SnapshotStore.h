@@ -0,0 +1,7 @@
+#pragma once
+
+#include "WorkerThread.h"
+#include <string>
+
+bool SaveUsageSnapshot(const std::wstring& path, const UsageData& data);
+bool LoadUsageSnapshot(const std::wstring& path, UsageData& out);
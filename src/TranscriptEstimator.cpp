@@ -0,0 +1,174 @@
+#include "TranscriptEstimator.h"
+
+#include <ctime>
+
+// Lets a burst of appended lines settle into one scan.
+static const uint64_t kSettleMs = 1000;
+// Calibrates anyway if the first poll has not finished by then.
+static const uint64_t kFirstScanDelayMs = 60 * 1000;
+
+void TranscriptEstimator::Start(const std::wstring& transcriptsRoot, const std::wstring& indexPath,
+    const std::wstring& archivePath, WorkerThread& worker)
+{
+    Stop();
+    m_worker = &worker;
+    m_root = transcriptsRoot;
+    m_scanner = std::make_unique<TranscriptScanner>(transcriptsRoot);
+    m_indexPath = indexPath;
+    m_archivePath = archivePath;
+    m_estimator = UsageEstimator();
+    m_generation = 0;
+    m_calibrated = false;
+    m_fiveHourUsage.Clear();
+    m_sevenDayUsage.Clear();
+    m_home = HomeDirectory();
+    m_indexDirty = false;
+    m_indexSavedTick = 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_changed = false;
+    m_estimate = UsageEstimate();
+    m_attribution = AttributionSummary();
+    m_task = Scheduler::Shared().Add(TaskPriority::Low, [this] { Update(); }, true);
+    // The first pass waits for OnPoll so it queues behind the first poll.
+    Scheduler::Shared().ScheduleIn(m_task, kFirstScanDelayMs, kFirstScanDelayMs / 2);
+}
+
+void TranscriptEstimator::Stop()
+{
+    Scheduler::TaskId task;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        task = m_task;
+        m_task = -1;
+    }
+    if (task >= 0) Scheduler::Shared().Remove(task);
+    m_watcher.Stop();
+    if (m_scanner && m_indexDirty) m_scanner->SaveIndex(m_indexPath);
+    m_indexDirty = false;
+    m_scanner.reset();
+    m_worker = nullptr;
+}
+
+void TranscriptEstimator::OnPoll()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_task >= 0) Scheduler::Shared().Reschedule(m_task, 0);
+}
+
+void TranscriptEstimator::OnChange()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_task < 0) return;
+    m_changed = true;
+    Scheduler::Shared().ScheduleIn(m_task, kSettleMs, kSettleMs);
+}
+
+void TranscriptEstimator::CopyEstimate(UsageEstimate& out)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    out = m_estimate;
+}
+
+void TranscriptEstimator::CopyAttribution(AttributionSummary& out)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    out = m_attribution;
+}
+
+int TranscriptEstimator::Describe(const UsageAttribution& window, AttributionShare* out) const
+{
+    AttributionRow rows[kAttributionTop];
+    int count = static_cast<int>(window.Top(rows, kAttributionTop));
+    for (int i = 0; i < count; ++i) {
+        auto label = Utf8ToWide(ProjectLabel(m_scanner->ProjectName(rows[i].project), m_home)) + L" \u00b7 "
+            + Utf8ToWide(ModelLabel(m_scanner->ModelName(rows[i].model)));
+        swprintf_s(out[i].label, _countof(out[i].label), L"%s", label.c_str());
+        out[i].pct = 100.0 * rows[i].weight / window.Total();
+    }
+    return count;
+}
+
+double TranscriptEstimator::WindowTokens(int64_t resetsAt, int64_t toMs) const
+{
+    return QuotaWeight(m_scanner->Sum((resetsAt - kFiveHourWindowSec) * 1000, toMs));
+}
+
+void TranscriptEstimator::Calibrate(int64_t nowSec)
+{
+    UsageArchiveReader reader;
+    std::vector<ArchiveSample> polls;
+    if (!reader.Load(m_archivePath)
+        || !reader.Query("five_hour", nowSec - kTranscriptRetentionMs / 1000, nowSec, polls))
+        return;
+    TokenTimeline timeline;
+    timeline.Build(m_scanner->Entries());
+    m_estimator.Replay(polls, timeline);
+}
+
+void TranscriptEstimator::Update()
+{
+    bool changed;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        changed = m_changed;
+        m_changed = false;
+    }
+    // Watch before scanning so nothing written during the scan is missed.
+    bool watching = m_watcher.IsRunning() || m_watcher.Start(m_root, [this](const std::wstring&) { OnChange(); });
+
+    auto nowMs = static_cast<int64_t>(time(nullptr)) * 1000;
+    TranscriptScanStats scan;
+    if (!m_calibrated) {
+        // The first pass reads every recent transcript the index does not
+        // already cover; later ones only what was appended.
+        m_scanner->LoadIndex(m_indexPath);
+        scan = m_scanner->Scan(nowMs);
+        Calibrate(nowMs / 1000);
+        m_calibrated = true;
+        m_added = m_scanner->Entries();
+    } else {
+        m_added.clear();
+        if (changed || !watching) scan = m_scanner->Scan(nowMs, 1, &m_added);
+    }
+    if (scan.bytesRead) m_indexDirty = true;
+
+    // Saved here as well as in Stop, so a crash loses little of the first
+    // pass; spaced out because each save rewrites the whole index.
+    uint64_t sinceSaveMs = TickMs() - m_indexSavedTick;
+    uint64_t nextSaveMs = 0;
+    if (m_indexDirty && (!m_indexSavedTick || sinceSaveMs >= kIndexSaveIntervalMs)) {
+        m_scanner->SaveIndex(m_indexPath);
+        m_indexDirty = false;
+        m_indexSavedTick = TickMs();
+    } else if (m_indexDirty) {
+        nextSaveMs = kIndexSaveIntervalMs - sinceSaveMs;
+    }
+    for (auto* window : {&m_fiveHourUsage, &m_sevenDayUsage}) {
+        window->Advance(nowMs);
+        for (auto& entry : m_added) window->Add(entry);
+    }
+
+    m_worker->CopySnapshot(m_snapshot);
+    auto* window = m_snapshot.usage.Find("five_hour");
+    if (m_snapshot.completed_generation != m_generation) {
+        m_generation = m_snapshot.completed_generation;
+        if (window && !m_snapshot.stale && !m_snapshot.has_error)
+            m_estimator.OnPoll(window->pct, window->resetsAt, WindowTokens(window->resetsAt, nowMs));
+    }
+
+    UsageEstimate next;
+    next.generation = m_generation;
+    if (window)
+        next.valid = m_estimator.Estimate(WindowTokens(window->resetsAt, nowMs), nowMs / 1000, next.pct);
+
+    AttributionSummary attribution;
+    attribution.fiveHourCount = Describe(m_fiveHourUsage, attribution.fiveHour);
+    attribution.sevenDayCount = Describe(m_sevenDayUsage, attribution.sevenDay);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_estimate = next;
+    m_attribution = attribution;
+    if (!watching) Scheduler::Shared().ScheduleIn(m_task, kEstimateIntervalMs, kEstimateIntervalMs / 2);
+    if (nextSaveMs) Scheduler::Shared().ScheduleIn(m_task, nextSaveMs, kIndexSaveIntervalMs / 4);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Scheduler.h"
+#include "TranscriptScanner.h"
+#include "TranscriptWatcher.h"
+#include "UsageAttribution.h"
+#include "UsageEstimator.h"
+#include "WorkerThread.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct UsageEstimate {
+    // Completed poll the estimate extends.
+    uint64_t generation = 0;
+    double pct = 0.0;
+    bool valid = false;
+};
+
+constexpr int kAttributionTop = 3;
+
+struct AttributionShare {
+    // Project and model, e.g. "src-app \u00b7 opus-4".
+    wchar_t label[64] = {};
+    // Of the local tokens in the window, by quota weight.
+    double pct = 0.0;
+};
+
+struct AttributionSummary {
+    AttributionShare fiveHour[kAttributionTop];
+    int fiveHourCount = 0;
+    AttributionShare sevenDay[kAttributionTop];
+    int sevenDayCount = 0;
+};
+
+// Keeps a UsageEstimator fed: calibrates it from the archived 5h history
+// once the worker's first poll is in, so the full first pass never delays
+// that poll. After that it rescans when the TranscriptWatcher reports a
+// change, and refreshes the estimate after every poll; only without a
+// watcher does it fall back to rescanning every kEstimateIntervalMs. The
+// same scans feed the 5h and 7d attribution windows, which publish their
+// heaviest projects and models alongside. The index is saved after scans
+// that read new bytes, at most every kIndexSaveIntervalMs.
+class TranscriptEstimator {
+public:
+    static constexpr uint64_t kEstimateIntervalMs = 15 * 1000;
+    static constexpr uint64_t kIndexSaveIntervalMs = 5 * 60 * 1000;
+
+    ~TranscriptEstimator() { Stop(); }
+
+    void Start(const std::wstring& transcriptsRoot, const std::wstring& indexPath,
+        const std::wstring& archivePath, WorkerThread& worker);
+    void Stop();
+    // Runs the next update now; safe from any thread.
+    void OnPoll();
+    void CopyEstimate(UsageEstimate& out);
+    void CopyAttribution(AttributionSummary& out);
+
+private:
+    void OnChange();
+    void Update();
+    void Calibrate(int64_t nowSec);
+    double WindowTokens(int64_t resetsAt, int64_t toMs) const;
+    int Describe(const UsageAttribution& window, AttributionShare* out) const;
+
+    std::mutex m_mutex;
+    Scheduler::TaskId m_task = -1;
+    // The watcher saw transcripts change since the last scan.
+    bool m_changed = false;
+    UsageEstimate m_estimate;
+    AttributionSummary m_attribution;
+
+    // Only touched by the update task.
+    WorkerThread* m_worker = nullptr;
+    std::wstring m_root;
+    TranscriptWatcher m_watcher;
+    std::unique_ptr<TranscriptScanner> m_scanner;
+    bool m_indexDirty = false;
+    uint64_t m_indexSavedTick = 0;
+    UsageData m_snapshot;
+    std::wstring m_indexPath;
+    std::wstring m_archivePath;
+    UsageEstimator m_estimator;
+    uint64_t m_generation = 0;
+    bool m_calibrated = false;
+    UsageAttribution m_fiveHourUsage{5 * 60 * 1000, 60};
+    UsageAttribution m_sevenDayUsage{3600 * 1000, 7 * 24};
+    std::vector<TranscriptEntry> m_added;
+    std::wstring m_home;
+};
@@ -0,0 +1,518 @@
+#include "TranscriptScanner.h"
+#include "Varint.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#if defined(__SSE2__) || (defined(_M_X64) && !defined(_M_ARM64EC)) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSCRIPT_SSE2 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+static const char kIndexMagic[4] = {'C', 'U', 'T', '1'};
+
+const char* FindNewline(const char* p, const char* end)
+{
+#ifdef TRANSCRIPT_SSE2
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; end - p >= 32; p += 32) {
+        auto a = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), newline);
+        auto b = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16)), newline);
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(a)) | (static_cast<uint32_t>(_mm_movemask_epi8(b)) << 16);
+        if (!mask) continue;
+#ifdef _MSC_VER
+        unsigned long bit;
+        _BitScanForward(&bit, mask);
+        return p + bit;
+#else
+        return p + __builtin_ctz(mask);
+#endif
+    }
+#endif
+    auto* hit = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+    return hit ? hit : end;
+}
+
+// Transcripts are written by JSON.stringify, so a key is always followed
+// directly by its value.
+static std::string_view StringAfter(std::string_view line, size_t pos)
+{
+    if (pos == std::string_view::npos) return {};
+    auto close = line.find('"', pos);
+    return close == std::string_view::npos ? std::string_view() : line.substr(pos, close - pos);
+}
+
+// Reads the counters at the top level of the usage object opening at open.
+// Returns the offset just past the object, or npos when the line ends first.
+static size_t ParseUsageObject(std::string_view text, size_t open, TokenCounts& out)
+{
+    out = {};
+    int depth = 0;
+    for (size_t i = open; i < text.size(); ++i) {
+        char c = text[i];
+        if (c == '{') {
+            ++depth;
+        } else if (c == '}') {
+            if (--depth == 0) return i + 1;
+        } else if (c == '"') {
+            size_t start = ++i;
+            for (; i < text.size() && text[i] != '"'; ++i)
+                if (text[i] == '\\') ++i;
+            if (i + 1 >= text.size() || depth != 1 || text[i + 1] != ':') continue;
+
+            auto key = text.substr(start, i - start);
+            uint64_t* field = key == "input_tokens" ? &out.input
+                : key == "output_tokens" ? &out.output
+                : key == "cache_creation_input_tokens" ? &out.cacheCreation
+                : key == "cache_read_input_tokens" ? &out.cacheRead
+                : nullptr;
+            if (!field) continue;
+            uint64_t value = 0;
+            for (i += 2; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i)
+                value = value * 10 + static_cast<uint64_t>(text[i] - '0');
+            *field = value;
+            --i;
+        }
+    }
+    return std::string_view::npos;
+}
+
+static bool Digits(std::string_view s, size_t pos, size_t count, int& out)
+{
+    out = 0;
+    if (pos + count > s.size()) return false;
+    for (size_t i = pos; i < pos + count; ++i) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        out = out * 10 + (s[i] - '0');
+    }
+    return true;
+}
+
+// Civil date to days since 1970-01-01, proleptic Gregorian.
+static int64_t DaysFromCivil(int y, int m, int d)
+{
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// "2026-01-02T03:04:05.678Z"
+static bool ParseTimestampMs(std::string_view s, int64_t& out)
+{
+    int y, mo, d, h, mi, sec, ms = 0;
+    if (!Digits(s, 0, 4, y) || !Digits(s, 5, 2, mo) || !Digits(s, 8, 2, d) || !Digits(s, 11, 2, h)
+        || !Digits(s, 14, 2, mi) || !Digits(s, 17, 2, sec))
+        return false;
+    if (s.size() > 19 && s[19] == '.') Digits(s, 20, 3, ms);
+    out = ((DaysFromCivil(y, mo, d) * 24 + h) * 60 + mi) * 60000LL + sec * 1000LL + ms;
+    return true;
+}
+
+// Most bytes belong to lines without usage, mainly tool output. Finds a key
+// by memchr on one of its bytes, which on long content runs far ahead of a
+// byte-at-a-time search. The anchor is the key's last byte that is not JSON
+// punctuation, so it is rarer than '"' or ':'.
+class KeySearch {
+public:
+    explicit KeySearch(std::string_view key)
+        : m_key(key)
+        , m_anchor(key.size() - 1)
+    {
+        while (m_anchor > 0 && (key[m_anchor] == '"' || key[m_anchor] == ':')) --m_anchor;
+    }
+
+    size_t Find(std::string_view text, size_t from = 0) const
+    {
+        if (text.size() < m_key.size()) return std::string_view::npos;
+        const char* base = text.data();
+        const char* p = base + from + m_anchor;
+        const char* end = base + text.size() - (m_key.size() - 1 - m_anchor);
+        while (p < end) {
+            p = static_cast<const char*>(memchr(p, m_key[m_anchor], end - p));
+            if (!p) break;
+            if (memcmp(p - m_anchor, m_key.data(), m_key.size()) == 0) return p - m_anchor - base;
+            ++p;
+        }
+        return std::string_view::npos;
+    }
+
+    // Offset just past the key, where its value starts.
+    size_t ValueAt(std::string_view text) const
+    {
+        auto pos = Find(text);
+        return pos == std::string_view::npos ? pos : pos + m_key.size();
+    }
+
+    size_t FindLast(std::string_view text) const
+    {
+        size_t last = std::string_view::npos;
+        for (size_t pos = Find(text); pos != std::string_view::npos; pos = Find(text, pos + m_key.size()))
+            last = pos;
+        return last;
+    }
+
+private:
+    std::string_view m_key;
+    size_t m_anchor;
+};
+
+static uint64_t Fnv1a(uint64_t hash, std::string_view s)
+{
+    for (unsigned char c : s) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool ParseTranscriptLine(std::string_view line, TranscriptUsageLine& out)
+{
+    static const KeySearch usageKey("\"usage\":{");
+    static const KeySearch assistantKey("\"type\":\"assistant\"");
+    static const KeySearch idKey("\"id\":\"");
+    static const KeySearch modelKey("\"model\":\"");
+    static const KeySearch requestKey("\"requestId\":\"");
+    static const std::string_view timestampKey = "\"timestamp\":\"";
+
+    // Usage comes last inside the message, after its content.
+    auto usage = usageKey.FindLast(line);
+    if (usage == std::string_view::npos) return false;
+    auto end = ParseUsageObject(line, usage + 8, out.tokens);
+    if (end == std::string_view::npos || !out.tokens.Total()) return false;
+    // Tool results echo a subagent's usage inside user lines; those tokens
+    // are logged again by the subagent's own assistant lines. The line type
+    // normally follows the message.
+    if (assistantKey.Find(line, end) == std::string_view::npos
+        && assistantKey.Find(line.substr(0, usage)) == std::string_view::npos)
+        return false;
+
+    auto timestamp = line.rfind(timestampKey);
+    if (timestamp == std::string_view::npos
+        || !ParseTimestampMs(StringAfter(line, timestamp + timestampKey.size()), out.timeMs))
+        return false;
+    out.model = StringAfter(line, modelKey.ValueAt(line));
+
+    auto id = StringAfter(line, idKey.ValueAt(line));
+    out.messageHash = 0;
+    if (!id.empty()) {
+        uint64_t hash = Fnv1a(14695981039346656037ULL, id);
+        hash = Fnv1a(Fnv1a(hash, "|"), StringAfter(line.substr(end), requestKey.ValueAt(line.substr(end))));
+        out.messageHash = hash ? hash : 1;
+    }
+    return true;
+}
+
+TranscriptScanner::TranscriptScanner(std::wstring root)
+    : m_root(std::move(root))
+{
+}
+
+std::wstring TranscriptScanner::RootFor(const std::wstring& credentialsPath)
+{
+    auto slash = credentialsPath.find_last_of(L"\\/");
+    if (slash == std::wstring::npos) return L"projects";
+    return credentialsPath.substr(0, slash + 1) + L"projects";
+}
+
+uint32_t TranscriptScanner::Intern(std::vector<std::string>& names, std::unordered_map<std::string, uint32_t>& ids,
+    std::string_view name)
+{
+    auto [it, inserted] = ids.emplace(std::string(name), static_cast<uint32_t>(names.size()));
+    if (inserted) names.push_back(it->first);
+    return it->second;
+}
+
+namespace {
+
+struct ScanJob {
+    const std::wstring* path;
+    uint64_t offset;
+};
+
+struct ScanResult {
+    bool ok = false;
+    uint64_t offset = 0;
+    uint64_t lines = 0;
+    std::vector<std::string> models;
+    std::vector<TranscriptEntry> entries;
+};
+
+}
+
+static void ScanFile(const ScanJob& job, int64_t cutoffMs, ScanResult& result)
+{
+    MappedFile file;
+    result.offset = job.offset;
+    if (!file.Open(*job.path)) return;
+    result.ok = true;
+    if (file.Size() <= job.offset) return;
+
+    const char* base = file.Data();
+    const char* end = base + file.Size();
+    const char* p = base + job.offset;
+    TranscriptUsageLine line;
+    for (const char* nl; (nl = FindNewline(p, end)) != end; p = nl + 1) {
+        ++result.lines;
+        if (!ParseTranscriptLine(std::string_view(p, static_cast<size_t>(nl - p)), line) || line.timeMs < cutoffMs)
+            continue;
+
+        TranscriptEntry entry;
+        entry.timeMs = line.timeMs;
+        entry.messageHash = line.messageHash;
+        entry.tokens = line.tokens;
+        auto model = std::find(result.models.begin(), result.models.end(), line.model);
+        entry.model = static_cast<uint32_t>(model - result.models.begin());
+        if (model == result.models.end()) result.models.emplace_back(line.model);
+        result.entries.push_back(entry);
+    }
+    // A trailing partial line is picked up once its newline lands.
+    result.offset = static_cast<uint64_t>(p - base);
+}
+
+TranscriptScanStats TranscriptScanner::Scan(int64_t nowMs, unsigned threads, std::vector<TranscriptEntry>* added)
+{
+    auto started = std::chrono::steady_clock::now();
+    TranscriptScanStats stats;
+    int64_t cutoffMs = nowMs - kTranscriptRetentionMs;
+
+    std::unordered_map<std::wstring, FileState> files;
+    std::vector<std::pair<const std::wstring*, FileState*>> changed;
+    EnumerateFiles(m_root, L".jsonl", [&](const std::wstring& path, const FileStamp& stamp) {
+        ++stats.files;
+        auto known = m_files.find(path);
+        FileState state;
+        if (known != m_files.end()) {
+            state = known->second;
+            if (state.stamp == stamp) {
+                files.emplace(path, state);
+                return;
+            }
+            // Rewritten rather than appended: read it again and let the
+            // message hashes drop what was already counted.
+            if (stamp.size < state.offset) state.offset = 0;
+        } else {
+            auto rest = path.substr(m_root.size() + 1);
+            state.project = Intern(m_projects, m_projectIds, WideToUtf8(rest.substr(0, rest.find_first_of(L"\\/"))));
+            // Untouched since before the window; nothing in it can count.
+            if (FileStampUnixMs(stamp) < cutoffMs) state.offset = stamp.size;
+        }
+        state.stamp = stamp;
+        auto it = files.emplace(path, state).first;
+        if (state.offset < stamp.size) changed.emplace_back(&it->first, &it->second);
+    });
+
+    std::vector<ScanJob> jobs;
+    jobs.reserve(changed.size());
+    for (auto& [path, state] : changed) jobs.push_back({path, state->offset});
+    std::vector<ScanResult> results(jobs.size());
+
+    unsigned workers = threads ? threads : (std::max)(1u, std::thread::hardware_concurrency());
+    workers = (std::min)(workers, static_cast<unsigned>(jobs.size()));
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < jobs.size();)
+            ScanFile(jobs[i], cutoffMs, results[i]);
+    };
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < workers; ++i) pool.emplace_back(work);
+    if (workers) work();
+    for (auto& t : pool) t.join();
+    stats.threads = workers;
+
+    // Merging in enumeration order keeps duplicate resolution deterministic.
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        auto& result = results[i];
+        auto* state = changed[i].second;
+        if (!result.ok) continue;
+        ++stats.filesRead;
+        stats.bytesRead += result.offset - state->offset;
+        stats.lines += result.lines;
+        state->offset = result.offset;
+
+        std::vector<uint32_t> models;
+        for (auto& name : result.models) models.push_back(Intern(m_models, m_modelIds, name));
+        for (auto& entry : result.entries) {
+            if (entry.messageHash) {
+                auto [seen, inserted] = m_seen.emplace(entry.messageHash, m_entries.size());
+                if (!inserted) {
+                    // Lines logged while the message streamed may carry
+                    // partial counts; keep the largest of each.
+                    auto& first = m_entries[seen->second];
+                    auto before = first.tokens;
+                    auto& tokens = first.tokens;
+                    tokens.input = (std::max)(tokens.input, entry.tokens.input);
+                    tokens.output = (std::max)(tokens.output, entry.tokens.output);
+                    tokens.cacheCreation = (std::max)(tokens.cacheCreation, entry.tokens.cacheCreation);
+                    tokens.cacheRead = (std::max)(tokens.cacheRead, entry.tokens.cacheRead);
+                    ++stats.duplicates;
+                    if (added && tokens.Total() != before.Total()) {
+                        added->push_back(first);
+                        auto& grown = added->back().tokens;
+                        grown.input -= before.input;
+                        grown.output -= before.output;
+                        grown.cacheCreation -= before.cacheCreation;
+                        grown.cacheRead -= before.cacheRead;
+                    }
+                    continue;
+                }
+            }
+            entry.model = models[entry.model];
+            entry.project = state->project;
+            m_entries.push_back(entry);
+            if (added) added->push_back(entry);
+            ++stats.entries;
+        }
+    }
+
+    m_files = std::move(files);
+    Prune(cutoffMs);
+    stats.elapsedUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started).count());
+    return stats;
+}
+
+void TranscriptScanner::Prune(int64_t cutoffMs)
+{
+    auto keep = std::remove_if(m_entries.begin(), m_entries.end(),
+        [cutoffMs](const TranscriptEntry& e) { return e.timeMs < cutoffMs; });
+    if (keep == m_entries.end()) return;
+    m_entries.erase(keep, m_entries.end());
+    IndexEntries();
+}
+
+void TranscriptScanner::IndexEntries()
+{
+    m_seen.clear();
+    for (size_t i = 0; i < m_entries.size(); ++i)
+        if (m_entries[i].messageHash) m_seen.emplace(m_entries[i].messageHash, i);
+}
+
+TokenCounts TranscriptScanner::Sum(int64_t fromMs, int64_t toMs) const
+{
+    TokenCounts sum;
+    for (auto& e : m_entries)
+        if (e.timeMs >= fromMs && e.timeMs < toMs) sum += e.tokens;
+    return sum;
+}
+
+static void PutString(std::string& out, const std::string& s)
+{
+    PutVarint(out, s.size());
+    out += s;
+}
+
+static bool GetString(const std::string& in, size_t& pos, std::string& s)
+{
+    uint64_t len;
+    if (!GetVarint(in, pos, in.size(), len) || len > in.size() - pos) return false;
+    s.assign(in, pos, static_cast<size_t>(len));
+    pos += static_cast<size_t>(len);
+    return true;
+}
+
+bool TranscriptScanner::SaveIndex(const std::wstring& path) const
+{
+    std::string out(kIndexMagic, sizeof(kIndexMagic));
+    for (auto* names : {&m_models, &m_projects}) {
+        PutVarint(out, names->size());
+        for (auto& name : *names) PutString(out, name);
+    }
+    PutVarint(out, m_files.size());
+    for (auto& [file, state] : m_files) {
+        PutString(out, WideToUtf8(file));
+        PutVarint(out, state.stamp.lastWrite);
+        PutVarint(out, state.stamp.size);
+        PutVarint(out, state.offset);
+        PutVarint(out, state.project);
+    }
+    PutVarint(out, m_entries.size());
+    for (auto& e : m_entries) {
+        PutVarint(out, static_cast<uint64_t>(e.timeMs));
+        PutVarint(out, e.messageHash);
+        for (uint64_t v : {e.tokens.input, e.tokens.output, e.tokens.cacheCreation, e.tokens.cacheRead})
+            PutVarint(out, v);
+        PutVarint(out, e.model);
+        PutVarint(out, e.project);
+    }
+
+    auto tmpPath = path + L".tmp";
+    {
+        std::ofstream file(NativePath(tmpPath), std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+        file.write(out.data(), static_cast<std::streamsize>(out.size()));
+        if (!file.good()) return false;
+    }
+    return ReplaceFileAtomically(tmpPath, path);
+}
+
+bool TranscriptScanner::LoadIndex(const std::wstring& path)
+{
+    std::ifstream file(NativePath(path), std::ios::binary);
+    if (!file.is_open()) return false;
+    std::ostringstream ss;
+    ss << file.rdbuf();
+    auto in = ss.str();
+    if (in.size() < sizeof(kIndexMagic) || memcmp(in.data(), kIndexMagic, sizeof(kIndexMagic)) != 0) return false;
+
+    size_t pos = sizeof(kIndexMagic);
+    std::vector<std::string> models, projects;
+    std::unordered_map<std::wstring, FileState> files;
+    std::vector<TranscriptEntry> entries;
+    uint64_t count;
+    for (auto* names : {&models, &projects}) {
+        if (!GetVarint(in, pos, in.size(), count)) return false;
+        for (uint64_t i = 0; i < count; ++i) {
+            std::string name;
+            if (!GetString(in, pos, name)) return false;
+            names->push_back(std::move(name));
+        }
+    }
+    if (!GetVarint(in, pos, in.size(), count)) return false;
+    for (uint64_t i = 0; i < count; ++i) {
+        std::string name;
+        FileState state;
+        uint64_t project;
+        if (!GetString(in, pos, name) || !GetVarint(in, pos, in.size(), state.stamp.lastWrite)
+            || !GetVarint(in, pos, in.size(), state.stamp.size) || !GetVarint(in, pos, in.size(), state.offset)
+            || !GetVarint(in, pos, in.size(), project) || project >= projects.size())
+            return false;
+        state.project = static_cast<uint32_t>(project);
+        files.emplace(Utf8ToWide(name), state);
+    }
+    if (!GetVarint(in, pos, in.size(), count)) return false;
+    for (uint64_t i = 0; i < count; ++i) {
+        TranscriptEntry e;
+        uint64_t t, model, project;
+        if (!GetVarint(in, pos, in.size(), t) || !GetVarint(in, pos, in.size(), e.messageHash) || !GetVarint(in, pos, in.size(), e.tokens.input)
+            || !GetVarint(in, pos, in.size(), e.tokens.output) || !GetVarint(in, pos, in.size(), e.tokens.cacheCreation)
+            || !GetVarint(in, pos, in.size(), e.tokens.cacheRead) || !GetVarint(in, pos, in.size(), model) || !GetVarint(in, pos, in.size(), project)
+            || model >= models.size() || project >= projects.size())
+            return false;
+        e.timeMs = static_cast<int64_t>(t);
+        e.model = static_cast<uint32_t>(model);
+        e.project = static_cast<uint32_t>(project);
+        entries.push_back(e);
+    }
+
+    m_models = std::move(models);
+    m_projects = std::move(projects);
+    m_modelIds.clear();
+    m_projectIds.clear();
+    for (uint32_t i = 0; i < m_models.size(); ++i) m_modelIds.emplace(m_models[i], i);
+    for (uint32_t i = 0; i < m_projects.size(); ++i) m_projectIds.emplace(m_projects[i], i);
+    m_files = std::move(files);
+    m_entries = std::move(entries);
+    IndexEntries();
+    return true;
+}
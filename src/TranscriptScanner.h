@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Platform.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct TokenCounts {
+    uint64_t input = 0;
+    uint64_t output = 0;
+    uint64_t cacheCreation = 0;
+    uint64_t cacheRead = 0;
+
+    uint64_t Total() const { return input + output + cacheCreation + cacheRead; }
+    TokenCounts& operator+=(const TokenCounts& o)
+    {
+        input += o.input;
+        output += o.output;
+        cacheCreation += o.cacheCreation;
+        cacheRead += o.cacheRead;
+        return *this;
+    }
+};
+
+// The parts of one transcript line that matter for accounting. model points
+// into the line.
+struct TranscriptUsageLine {
+    int64_t timeMs = 0;
+    // Message and request id hashed together; 0 when the line has no id.
+    uint64_t messageHash = 0;
+    std::string_view model;
+    TokenCounts tokens;
+};
+
+// Picks the usage block out of an assistant line without parsing the rest,
+// which is mostly message content. False for every other line.
+bool ParseTranscriptLine(std::string_view line, TranscriptUsageLine& out);
+// First '\n' in [p, end), or end.
+const char* FindNewline(const char* p, const char* end);
+
+struct TranscriptEntry {
+    int64_t timeMs = 0;
+    uint64_t messageHash = 0;
+    TokenCounts tokens;
+    uint32_t model = 0;
+    uint32_t project = 0;
+};
+
+struct TranscriptScanStats {
+    uint32_t files = 0;
+    uint32_t filesRead = 0;
+    uint32_t threads = 0;
+    uint64_t bytesRead = 0;
+    uint64_t lines = 0;
+    uint64_t entries = 0;
+    uint64_t duplicates = 0;
+    uint64_t elapsedUs = 0;
+};
+
+// Long enough to cover the 7-day window with a day to spare.
+constexpr int64_t kTranscriptRetentionMs = 8LL * 24 * 3600 * 1000;
+
+// Token usage from Claude Code's JSONL transcripts under root, one
+// directory per project. Files are memory-mapped and scanned in parallel;
+// each file's read offset is remembered, so a rescan only reads appended
+// bytes, and the index carries offsets and entries across restarts. Only
+// entries inside the retention window are kept, and messages logged more
+// than once (one line per content block, or copied into a resumed session)
+// count once. Not thread-safe; one owner drives it.
+class TranscriptScanner {
+public:
+    explicit TranscriptScanner(std::wstring root);
+    // Transcripts live in projects/ beside the credentials file.
+    static std::wstring RootFor(const std::wstring& credentialsPath);
+
+    bool LoadIndex(const std::wstring& path);
+    bool SaveIndex(const std::wstring& path) const;
+    // threads 0 uses every core. added, when given, receives what this scan
+    // counted: each new entry, and for a message seen before an entry with
+    // only the growth of its counts.
+    TranscriptScanStats Scan(int64_t nowMs, unsigned threads = 0, std::vector<TranscriptEntry>* added = nullptr);
+
+    const std::vector<TranscriptEntry>& Entries() const { return m_entries; }
+    TokenCounts Sum(int64_t fromMs, int64_t toMs) const;
+    const std::string& ModelName(uint32_t id) const { return m_models[id]; }
+    const std::string& ProjectName(uint32_t id) const { return m_projects[id]; }
+
+private:
+    struct FileState {
+        FileStamp stamp;
+        uint64_t offset = 0;
+        uint32_t project = 0;
+    };
+
+    uint32_t Intern(std::vector<std::string>& names, std::unordered_map<std::string, uint32_t>& ids,
+        std::string_view name);
+    void Prune(int64_t cutoffMs);
+    void IndexEntries();
+
+    std::wstring m_root;
+    std::unordered_map<std::wstring, FileState> m_files;
+    std::vector<TranscriptEntry> m_entries;
+    // Message hash to its entry.
+    std::unordered_map<uint64_t, size_t> m_seen;
+    std::vector<std::string> m_models;
+    std::unordered_map<std::string, uint32_t> m_modelIds;
+    std::vector<std::string> m_projects;
+    std::unordered_map<std::string, uint32_t> m_projectIds;
+};
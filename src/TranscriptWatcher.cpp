@@ -0,0 +1,254 @@
+#include "TranscriptWatcher.h"
+
+#ifndef _WIN32
+#include "Platform.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+static const wchar_t kTranscriptSuffix[] = L".jsonl";
+
+#ifdef _WIN32
+
+static const DWORD kNotifyFilter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME
+    | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+
+bool TranscriptWatcher::Start(const std::wstring& root, Callback onChange)
+{
+    Stop();
+
+    m_dir = CreateFileW(root.c_str(), FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (m_dir == INVALID_HANDLE_VALUE) return false;
+
+    m_event = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    m_root = root;
+    m_onChange = std::move(onChange);
+
+    if (!m_event || !Arm()
+        || !RegisterWaitForSingleObject(&m_wait, m_event, OnSignaled, this, INFINITE, WT_EXECUTEDEFAULT)) {
+        Stop();
+        return false;
+    }
+    return true;
+}
+
+void TranscriptWatcher::Stop()
+{
+    if (m_wait) {
+        UnregisterWaitEx(m_wait, INVALID_HANDLE_VALUE);
+        m_wait = nullptr;
+    }
+    if (m_dir != INVALID_HANDLE_VALUE) {
+        DWORD bytes = 0;
+        if (CancelIoEx(m_dir, &m_overlapped))
+            GetOverlappedResult(m_dir, &m_overlapped, &bytes, TRUE);
+        CloseHandle(m_dir);
+        m_dir = INVALID_HANDLE_VALUE;
+    }
+    if (m_event) {
+        CloseHandle(m_event);
+        m_event = nullptr;
+    }
+    m_root.clear();
+    m_onChange = nullptr;
+    m_failed = false;
+}
+
+bool TranscriptWatcher::IsRunning() const
+{
+    return m_dir != INVALID_HANDLE_VALUE && !m_failed;
+}
+
+bool TranscriptWatcher::Arm()
+{
+    m_overlapped = {};
+    m_overlapped.hEvent = m_event;
+    return ReadDirectoryChangesW(m_dir, m_buffer, sizeof(m_buffer), TRUE,
+        kNotifyFilter, nullptr, &m_overlapped, nullptr) != FALSE;
+}
+
+static bool IsSessionTranscript(const wchar_t* name, size_t len)
+{
+    const size_t suffixLen = _countof(kTranscriptSuffix) - 1;
+    if (len <= suffixLen || CompareStringOrdinal(name + len - suffixLen, static_cast<int>(suffixLen),
+            kTranscriptSuffix, static_cast<int>(suffixLen), TRUE) != CSTR_EQUAL)
+        return false;
+    size_t separators = 0;
+    for (size_t i = 0; i < len; ++i) separators += name[i] == L'\\';
+    return separators == 1;
+}
+
+void TranscriptWatcher::Collect(DWORD bytes, std::vector<std::wstring>& paths) const
+{
+    // A zero-length completion means the buffer overflowed.
+    if (bytes == 0) {
+        paths.emplace_back();
+        return;
+    }
+
+    // Each append shows up as several records; report a file once.
+    auto* base = reinterpret_cast<const BYTE*>(m_buffer);
+    for (DWORD offset = 0;;) {
+        auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(base + offset);
+        size_t len = info->FileNameLength / sizeof(WCHAR);
+        if (info->Action != FILE_ACTION_REMOVED && info->Action != FILE_ACTION_RENAMED_OLD_NAME
+            && IsSessionTranscript(info->FileName, len)) {
+            auto path = m_root + L'\\' + std::wstring(info->FileName, len);
+            if (paths.empty() || paths.back() != path) paths.push_back(std::move(path));
+        }
+        if (info->NextEntryOffset == 0) return;
+        offset += info->NextEntryOffset;
+    }
+}
+
+VOID CALLBACK TranscriptWatcher::OnSignaled(PVOID context, BOOLEAN)
+{
+    auto* self = static_cast<TranscriptWatcher*>(context);
+
+    // A failed read (a dropped notification, the root going away) may have
+    // hidden changes, so ask the caller to look again.
+    DWORD bytes = 0;
+    std::vector<std::wstring> paths;
+    if (GetOverlappedResult(self->m_dir, &self->m_overlapped, &bytes, FALSE))
+        self->Collect(bytes, paths);
+    else
+        paths.emplace_back();
+
+    // If the watch cannot be re-armed it would never signal again; report it
+    // stopped so the owner starts a new one.
+    if (!self->Arm())
+        self->m_failed = true;
+
+    if (self->m_onChange)
+        for (auto& path : paths) self->m_onChange(path);
+}
+
+#else
+
+static const uint32_t kRootMask = IN_CREATE | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+static const uint32_t kProjectMask = IN_CREATE | IN_MODIFY | IN_MOVED_TO | IN_ONLYDIR;
+
+static bool IsTranscriptName(const std::string& name)
+{
+    static const std::string suffix = WideToUtf8(kTranscriptSuffix);
+    return name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void TranscriptWatcher::AddProject(const std::string& name)
+{
+    int wd = inotify_add_watch(m_inotify, (NativePath(m_root) + '/' + name).c_str(), kProjectMask);
+    if (wd >= 0) m_projects[wd] = name;
+}
+
+bool TranscriptWatcher::Start(const std::wstring& root, Callback onChange)
+{
+    Stop();
+
+    auto native = NativePath(root);
+    m_root = root;
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify < 0 || (m_rootWatch = inotify_add_watch(m_inotify, native.c_str(), kRootMask)) < 0
+        || pipe2(m_stopPipe, O_CLOEXEC) != 0) {
+        Stop();
+        return false;
+    }
+
+    // IN_ONLYDIR turns away anything that is not a directory.
+    if (DIR* dir = opendir(native.c_str())) {
+        while (dirent* entry = readdir(dir))
+            if (entry->d_name[0] != '.' && (entry->d_type == DT_DIR || entry->d_type == DT_UNKNOWN))
+                AddProject(entry->d_name);
+        closedir(dir);
+    }
+
+    m_onChange = std::move(onChange);
+    m_thread = std::thread(&TranscriptWatcher::WatchLoop, this);
+    return true;
+}
+
+void TranscriptWatcher::WatchLoop()
+{
+    auto root = NativePath(m_root);
+    alignas(inotify_event) char buf[4096];
+    std::vector<std::string> paths;
+    for (;;) {
+        pollfd fds[2] = {{m_inotify, POLLIN, 0}, {m_stopPipe[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) continue;
+        if (fds[1].revents) return;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        bool lost = false;
+        paths.clear();
+        ssize_t len;
+        while ((len = read(m_inotify, buf, sizeof(buf))) > 0) {
+            for (char* p = buf; p < buf + len;) {
+                auto* event = reinterpret_cast<inotify_event*>(p);
+                p += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    lost = true;
+                    continue;
+                }
+                // The root was deleted, moved or unmounted: its watch is dead
+                // or points elsewhere, so nothing more will arrive from it.
+                if (event->wd == m_rootWatch && (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))) {
+                    m_failed = true;
+                    continue;
+                }
+                if (event->mask & IN_IGNORED) {
+                    m_projects.erase(event->wd);
+                    continue;
+                }
+                if (!event->len) continue;
+                std::string name = event->name;
+                if (event->wd == m_rootWatch) {
+                    // A new project may already hold its first transcript.
+                    if (event->mask & IN_ISDIR) {
+                        AddProject(name);
+                        lost = true;
+                    }
+                    continue;
+                }
+                auto project = m_projects.find(event->wd);
+                if (project == m_projects.end() || (event->mask & IN_ISDIR) || !IsTranscriptName(name)) continue;
+                auto path = root + '/' + project->second + '/' + name;
+                if (paths.empty() || paths.back() != path) paths.push_back(std::move(path));
+            }
+        }
+
+        if (m_onChange) {
+            if (lost || m_failed) m_onChange(std::wstring());
+            for (auto& path : paths) m_onChange(Utf8ToWide(path));
+        }
+        if (m_failed) return;
+    }
+}
+
+void TranscriptWatcher::Stop()
+{
+    if (m_thread.joinable()) {
+        char stop = 1;
+        (void)!write(m_stopPipe[1], &stop, 1);
+        m_thread.join();
+    }
+    for (int* fd : {&m_inotify, &m_stopPipe[0], &m_stopPipe[1]}) {
+        if (*fd >= 0) close(*fd);
+        *fd = -1;
+    }
+    m_rootWatch = -1;
+    m_projects.clear();
+    m_root.clear();
+    m_onChange = nullptr;
+    m_failed = false;
+}
+
+bool TranscriptWatcher::IsRunning() const
+{
+    return m_thread.joinable() && !m_failed;
+}
+
+#endif
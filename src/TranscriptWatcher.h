@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <functional>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <thread>
+#include <unordered_map>
+#endif
+
+// Watches the transcripts root and reports each session transcript
+// (root/<project>/<session>.jsonl) as it is created or appended to: on a
+// thread-pool thread on Windows, on an inotify thread elsewhere. An empty
+// path means events were dropped and the caller should look again itself.
+// Files deeper down, such as subagent transcripts, are not reported.
+class TranscriptWatcher {
+public:
+    using Callback = std::function<void(const std::wstring& path)>;
+
+    ~TranscriptWatcher() { Stop(); }
+
+    bool Start(const std::wstring& root, Callback onChange);
+    void Stop();
+    // False once the watch has broken and can no longer report changes.
+    bool IsRunning() const;
+
+private:
+    std::wstring m_root;
+    Callback m_onChange;
+    std::atomic<bool> m_failed{false};
+
+#ifdef _WIN32
+    static VOID CALLBACK OnSignaled(PVOID context, BOOLEAN timedOut);
+    bool Arm();
+    void Collect(DWORD bytes, std::vector<std::wstring>& paths) const;
+
+    HANDLE m_dir = INVALID_HANDLE_VALUE;
+    HANDLE m_event = nullptr;
+    HANDLE m_wait = nullptr;
+    OVERLAPPED m_overlapped = {};
+    DWORD m_buffer[4096] = {};
+#else
+    void WatchLoop();
+    void AddProject(const std::string& name);
+    std::thread m_thread;
+    int m_inotify = -1;
+    int m_stopPipe[2] = {-1, -1};
+    int m_rootWatch = -1;
+    // Project watch descriptor to its directory name.
+    std::unordered_map<int, std::string> m_projects;
+#endif
+};
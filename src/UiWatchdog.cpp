@@ -0,0 +1,154 @@
+#include "UiWatchdog.h"
+#include "Platform.h"
+
+#include <nlohmann/json.hpp>
+
+#include <ctime>
+#include <fstream>
+
+using json = nlohmann::json;
+
+static const char* kEntryNames[] = {"GetItem", "DataRequired", "GetTooltipInfo", "DrawItem", "OnMouseEvent"};
+static const char* kPhaseNames[] = {"snapshot", "transcripts", "tooltip", "render"};
+static_assert(_countof(kEntryNames) == static_cast<size_t>(UiEntry::Count), "entry names");
+static_assert(_countof(kPhaseNames) == static_cast<size_t>(UiPhase::Count), "phase names");
+
+const char* UiEntryName(UiEntry entry)
+{
+    return kEntryNames[static_cast<int>(entry)];
+}
+
+const char* UiPhaseName(UiPhase phase)
+{
+    return kPhaseNames[static_cast<int>(phase)];
+}
+
+UiWatchdog& UiWatchdog::Instance()
+{
+    static UiWatchdog watchdog;
+    return watchdog;
+}
+
+void UiWatchdog::Start(const std::wstring& logPath, uint32_t budgetMs)
+{
+    Stop();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_logPath = logPath;
+    m_budgetUs = uint64_t(budgetMs) * 1000;
+    m_stats.budgetMs = budgetMs;
+    m_task = Scheduler::Shared().Add(TaskPriority::Low, [this] { Flush(); });
+}
+
+void UiWatchdog::Stop()
+{
+    Scheduler::TaskId task;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        task = m_task;
+        m_task = -1;
+    }
+    if (task >= 0) Scheduler::Shared().Remove(task);
+    Flush();
+}
+
+void UiWatchdog::Record(UiEntry entry, uint64_t us, const uint64_t* phaseUs, uint32_t notes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.entries[static_cast<int>(entry)].Add(us);
+    if (!m_budgetUs || us <= m_budgetUs) return;
+
+    ++m_stats.overBudget;
+    uint64_t now = TickMs();
+    if (m_task < 0 || m_hasPending || (m_recorded && now - m_lastRecordMs < kRecordIntervalMs)) {
+        ++m_suppressed;
+        return;
+    }
+
+    m_pending.unixTime = static_cast<int64_t>(time(nullptr));
+    m_pending.entry = entry;
+    m_pending.us = us;
+    for (int i = 0; i < static_cast<int>(UiPhase::Count); ++i) m_pending.phaseUs[i] = phaseUs ? phaseUs[i] : 0;
+    m_pending.notes = notes;
+    m_pending.suppressed = m_suppressed;
+    m_suppressed = 0;
+    m_hasPending = true;
+    m_recorded = true;
+    m_lastRecordMs = now;
+    Scheduler::Shared().ScheduleIn(m_task, 0);
+}
+
+void UiWatchdog::CopyStats(UiWatchdogStats& out)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    out = m_stats;
+}
+
+void UiWatchdog::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t budgetMs = m_stats.budgetMs;
+    m_stats = UiWatchdogStats();
+    m_stats.budgetMs = budgetMs;
+    m_suppressed = 0;
+}
+
+void UiWatchdog::Flush()
+{
+    UiSlowCall call;
+    std::wstring path;
+    uint32_t budgetMs;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_hasPending) return;
+        call = m_pending;
+        m_hasPending = false;
+        path = m_logPath;
+        budgetMs = m_stats.budgetMs;
+    }
+    if (path.empty()) return;
+
+    json line = {
+        {"t", call.unixTime}, {"entry", UiEntryName(call.entry)},
+        {"ms", call.us / 1000.0}, {"budget_ms", budgetMs},
+    };
+    json phases = json::object();
+    for (int i = 0; i < static_cast<int>(UiPhase::Count); ++i)
+        if (call.phaseUs[i]) phases[kPhaseNames[i]] = call.phaseUs[i] / 1000.0;
+    if (!phases.empty()) line["phases"] = phases;
+    json notes = json::array();
+    if (call.notes & kUiNoteLockWait) notes.push_back("lock_wait");
+    if (call.notes & kUiNoteLayoutMiss) notes.push_back("layout_miss");
+    if (!notes.empty()) line["notes"] = notes;
+    if (call.suppressed) line["suppressed"] = call.suppressed;
+
+    std::ofstream file(NativePath(path), std::ios::binary | std::ios::app);
+    if (!file.is_open()) return;
+    file << line.dump() << '\n';
+    if (!file) return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_stats.records;
+}
+
+UiTimer::UiTimer(UiEntry entry)
+    : m_entry(entry)
+    , m_start(PerfCounter())
+    , m_mark(m_start)
+{
+}
+
+UiTimer::~UiTimer()
+{
+    uint64_t now = PerfCounter();
+    uint64_t phaseUs[static_cast<int>(UiPhase::Count)];
+    for (int i = 0; i < static_cast<int>(UiPhase::Count); ++i)
+        phaseUs[i] = m_phaseTicks[i] ? PerfCounterUs(m_phaseTicks[i]) : 0;
+    UiWatchdog::Instance().Record(m_entry, PerfCounterUs(now - m_start), phaseUs, m_notes);
+}
+
+void UiTimer::Mark(UiPhase phase)
+{
+    uint64_t now = PerfCounter();
+    m_phaseTicks[static_cast<int>(phase)] += now - m_mark;
+    m_mark = now;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "LatencyHistogram.h"
+#include "Scheduler.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// TrafficMonitor calls these on its UI thread.
+enum class UiEntry { GetItem, DataRequired, GetTooltipInfo, DrawItem, OnMouseEvent, Count };
+// Where a call's time went, charged with UiTimer::Mark.
+enum class UiPhase { Snapshot, Transcripts, Tooltip, Render, Count };
+
+constexpr uint32_t kUiNoteLockWait = 1;     // waited for the worker's snapshot lock
+constexpr uint32_t kUiNoteLayoutMiss = 2;   // the renderer rebuilt its cached layout
+
+const char* UiEntryName(UiEntry entry);
+const char* UiPhaseName(UiPhase phase);
+
+struct UiSlowCall {
+    int64_t unixTime = 0;
+    UiEntry entry = UiEntry::DataRequired;
+    uint64_t us = 0;
+    uint64_t phaseUs[static_cast<int>(UiPhase::Count)] = {};
+    uint32_t notes = 0;
+    // Over-budget calls since the previous record that were not written.
+    uint64_t suppressed = 0;
+};
+
+struct UiWatchdogStats {
+    LatencyHistogram entries[static_cast<int>(UiEntry::Count)];
+    uint32_t budgetMs = 0;
+    uint64_t overBudget = 0;
+    uint64_t records = 0;
+};
+
+// Latency histograms for every UI entry point, plus a record of calls that
+// ran past the budget. Recording takes an uncontended lock and never
+// allocates; the record is written by a scheduler task, at most one per
+// kRecordIntervalMs so a stall that repeats every frame logs once a minute.
+class UiWatchdog {
+public:
+    static constexpr uint64_t kRecordIntervalMs = 60 * 1000;
+
+    static UiWatchdog& Instance();
+
+    // Appends over-budget calls to logPath as JSON lines. A budget of 0
+    // keeps the histograms but writes nothing.
+    void Start(const std::wstring& logPath, uint32_t budgetMs);
+    void Stop();
+
+    void Record(UiEntry entry, uint64_t us, const uint64_t* phaseUs, uint32_t notes);
+    void CopyStats(UiWatchdogStats& out);
+    void Reset();
+
+private:
+    void Flush();
+
+    std::mutex m_mutex;
+    std::wstring m_logPath;
+    uint64_t m_budgetUs = 0;
+    Scheduler::TaskId m_task = -1;
+    UiWatchdogStats m_stats;
+    UiSlowCall m_pending;
+    bool m_hasPending = false;
+    uint64_t m_suppressed = 0;
+    uint64_t m_lastRecordMs = 0;
+    bool m_recorded = false;
+};
+
+// Times one entry point from construction to destruction.
+class UiTimer {
+public:
+    explicit UiTimer(UiEntry entry);
+    ~UiTimer();
+    UiTimer(const UiTimer&) = delete;
+    UiTimer& operator=(const UiTimer&) = delete;
+
+    // Charges the time since the previous mark (or the start) to phase.
+    void Mark(UiPhase phase);
+    void Note(uint32_t note) { m_notes |= note; }
+
+private:
+    UiEntry m_entry;
+    uint64_t m_start;
+    uint64_t m_mark;
+    uint64_t m_phaseTicks[static_cast<int>(UiPhase::Count)] = {};
+    uint32_t m_notes = 0;
+};
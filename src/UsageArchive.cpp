@@ -0,0 +1,561 @@
+#include "UsageArchive.h"
+#include "Platform.h"
+#include "Varint.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+static const char kMagic[4] = {'C', 'U', 'A', '1'};
+static const char kFrameSeries = 'S';
+static const char kFrameBlock = 'B';
+static const int64_t kRollupResolutions[2] = {kArchiveHour, kArchiveDay};
+
+static uint64_t ZigZag(int64_t v)
+{
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+static int64_t UnZigZag(uint64_t v)
+{
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+static int64_t ToCenti(double pct)
+{
+    return static_cast<int64_t>(std::llround(pct * 100.0));
+}
+
+static int64_t BucketStart(int64_t t, int64_t resolution)
+{
+    int64_t r = t % resolution;
+    return t - (r < 0 ? r + resolution : r);
+}
+
+static std::string ReadAll(const std::wstring& path)
+{
+    std::ifstream file(NativePath(path), std::ios::binary);
+    if (!file.is_open()) return {};
+    std::ostringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+struct Frame {
+    char type;
+    size_t begin;
+    size_t end;
+};
+
+// Returns the offset just past the last complete frame, or 0 without a header.
+static size_t ScanFrames(const std::string& data, std::vector<Frame>& frames)
+{
+    if (data.size() < sizeof(kMagic) || memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) return 0;
+
+    size_t pos = sizeof(kMagic);
+    while (pos < data.size()) {
+        size_t p = pos + 1;
+        uint64_t len;
+        if (!GetVarint(data, p, data.size(), len) || len > data.size() - p) break;
+        frames.push_back({data[pos], p, p + static_cast<size_t>(len)});
+        pos = p + static_cast<size_t>(len);
+    }
+    return pos;
+}
+
+static void AppendFrame(std::string& out, char type, const std::string& payload)
+{
+    out.push_back(type);
+    PutVarint(out, payload.size());
+    out += payload;
+}
+
+static bool ParseSeries(const std::string& d, const Frame& f, int& id, std::string& key)
+{
+    size_t p = f.begin;
+    uint64_t v;
+    if (!GetVarint(d, p, f.end, v)) return false;
+    id = static_cast<int>(v);
+    key.assign(d, p, f.end - p);
+    return true;
+}
+
+struct BlockHeader {
+    int series = 0;
+    uint32_t count = 0;
+    int64_t firstT = 0;
+    int64_t lastT = 0;
+    size_t rollups = 0;
+    size_t columns = 0;
+};
+
+static bool ParseBlockHeader(const std::string& d, const Frame& f, BlockHeader& h)
+{
+    size_t p = f.begin;
+    uint64_t series, count, firstT, span, rollupLen;
+    if (!GetVarint(d, p, f.end, series) || !GetVarint(d, p, f.end, count)
+        || !GetVarint(d, p, f.end, firstT) || !GetVarint(d, p, f.end, span)
+        || !GetVarint(d, p, f.end, rollupLen) || rollupLen > f.end - p || count == 0)
+        return false;
+
+    h.series = static_cast<int>(series);
+    h.count = static_cast<uint32_t>(count);
+    h.firstT = UnZigZag(firstT);
+    h.lastT = h.firstT + static_cast<int64_t>(span);
+    h.rollups = p;
+    h.columns = p + static_cast<size_t>(rollupLen);
+    return true;
+}
+
+struct RollupAcc {
+    uint32_t count = 0;
+    int64_t min = 0;
+    int64_t max = 0;
+    int64_t sum = 0;
+
+    void Add(int64_t centi)
+    {
+        if (count == 0 || centi < min) min = centi;
+        if (count == 0 || centi > max) max = centi;
+        sum += centi;
+        ++count;
+    }
+
+    void Merge(const RollupAcc& o)
+    {
+        if (o.count == 0) return;
+        if (count == 0 || o.min < min) min = o.min;
+        if (count == 0 || o.max > max) max = o.max;
+        sum += o.sum;
+        count += o.count;
+    }
+};
+
+static std::string EncodeBlock(int seriesId, const std::vector<ArchiveSample>& samples)
+{
+    auto firstT = samples.front().t;
+    auto lastT = samples.back().t;
+
+    std::string rollups;
+    for (auto resolution : kRollupResolutions) {
+        std::vector<std::pair<int64_t, RollupAcc>> buckets;
+        for (auto& s : samples) {
+            auto start = BucketStart(s.t, resolution);
+            if (buckets.empty() || buckets.back().first != start) buckets.push_back({start, {}});
+            buckets.back().second.Add(ToCenti(s.pct));
+        }
+        PutVarint(rollups, buckets.size());
+        auto base = BucketStart(firstT, resolution);
+        for (auto& b : buckets) {
+            PutVarint(rollups, static_cast<uint64_t>((b.first - base) / resolution));
+            PutVarint(rollups, b.second.count);
+            PutVarint(rollups, ZigZag(b.second.min));
+            PutVarint(rollups, static_cast<uint64_t>(b.second.max - b.second.min));
+            PutVarint(rollups, ZigZag(b.second.sum));
+        }
+    }
+
+    std::string times;
+    int64_t prevDelta = 0;
+    for (size_t i = 1; i < samples.size(); ++i) {
+        int64_t delta = samples[i].t - samples[i - 1].t;
+        PutVarint(times, ZigZag(i == 1 ? delta : delta - prevDelta));
+        prevDelta = delta;
+    }
+
+    std::string pcts;
+    int64_t prevCenti = 0;
+    for (auto& s : samples) {
+        int64_t centi = ToCenti(s.pct);
+        PutVarint(pcts, ZigZag(centi - prevCenti));
+        prevCenti = centi;
+    }
+
+    std::string resets;
+    int64_t prevReset = 0;
+    for (size_t i = 0; i < samples.size();) {
+        size_t run = 1;
+        while (i + run < samples.size() && samples[i + run].resetsAt == samples[i].resetsAt) ++run;
+        PutVarint(resets, ZigZag(samples[i].resetsAt - prevReset));
+        PutVarint(resets, run);
+        prevReset = samples[i].resetsAt;
+        i += run;
+    }
+
+    std::string payload;
+    PutVarint(payload, static_cast<uint64_t>(seriesId));
+    PutVarint(payload, samples.size());
+    PutVarint(payload, ZigZag(firstT));
+    PutVarint(payload, static_cast<uint64_t>(lastT - firstT));
+    PutVarint(payload, rollups.size());
+    payload += rollups;
+    PutVarint(payload, times.size());
+    payload += times;
+    PutVarint(payload, pcts.size());
+    payload += pcts;
+    payload += resets;
+    return payload;
+}
+
+static bool DecodeColumns(const std::string& d, const BlockHeader& h, size_t end, std::vector<ArchiveSample>& out)
+{
+    size_t base = out.size();
+    out.resize(base + h.count);
+    auto* samples = out.data() + base;
+
+    size_t p = h.columns;
+    uint64_t len, v;
+    if (!GetVarint(d, p, end, len) || len > end - p) return false;
+    size_t timesEnd = p + static_cast<size_t>(len);
+    samples[0].t = h.firstT;
+    int64_t delta = 0;
+    for (uint32_t i = 1; i < h.count; ++i) {
+        if (!GetVarint(d, p, timesEnd, v)) return false;
+        delta = i == 1 ? UnZigZag(v) : delta + UnZigZag(v);
+        samples[i].t = samples[i - 1].t + delta;
+    }
+    p = timesEnd;
+
+    if (!GetVarint(d, p, end, len) || len > end - p) return false;
+    size_t pctsEnd = p + static_cast<size_t>(len);
+    int64_t centi = 0;
+    for (uint32_t i = 0; i < h.count; ++i) {
+        if (!GetVarint(d, p, pctsEnd, v)) return false;
+        centi += UnZigZag(v);
+        samples[i].pct = centi / 100.0;
+    }
+    p = pctsEnd;
+
+    int64_t reset = 0;
+    for (uint32_t i = 0; i < h.count;) {
+        uint64_t run;
+        if (!GetVarint(d, p, end, v) || !GetVarint(d, p, end, run) || run == 0 || run > h.count - i) return false;
+        reset += UnZigZag(v);
+        for (uint64_t r = 0; r < run; ++r) samples[i++].resetsAt = reset;
+    }
+    return true;
+}
+
+static bool DecodeRollups(const std::string& d, const BlockHeader& h, int64_t resolution,
+    int64_t fromBucket, int64_t to, std::map<int64_t, RollupAcc>& out)
+{
+    size_t p = h.rollups;
+    for (auto res : kRollupResolutions) {
+        uint64_t n;
+        if (!GetVarint(d, p, h.columns, n)) return false;
+        auto base = BucketStart(h.firstT, res);
+        for (uint64_t i = 0; i < n; ++i) {
+            uint64_t index, count, min, range, sum;
+            if (!GetVarint(d, p, h.columns, index) || !GetVarint(d, p, h.columns, count)
+                || !GetVarint(d, p, h.columns, min) || !GetVarint(d, p, h.columns, range)
+                || !GetVarint(d, p, h.columns, sum))
+                return false;
+            if (res != resolution) continue;
+
+            auto start = base + static_cast<int64_t>(index) * res;
+            if (start < fromBucket || start > to) continue;
+            RollupAcc acc;
+            acc.count = static_cast<uint32_t>(count);
+            acc.min = UnZigZag(min);
+            acc.max = acc.min + static_cast<int64_t>(range);
+            acc.sum = UnZigZag(sum);
+            out[start].Merge(acc);
+        }
+        if (res == resolution) return true;
+    }
+    return false;
+}
+
+static const size_t kWalRecordBytes = 24;
+
+static void PutWalRecord(std::string& out, const std::string& key, const ArchiveSample& s)
+{
+    out.push_back(static_cast<char>(key.size()));
+    out += key;
+    char raw[kWalRecordBytes];
+    memcpy(raw, &s.t, 8);
+    memcpy(raw + 8, &s.pct, 8);
+    memcpy(raw + 16, &s.resetsAt, 8);
+    out.append(raw, sizeof(raw));
+}
+
+template <typename Fn>
+static void ForEachWalRecord(const std::string& wal, Fn&& fn)
+{
+    size_t p = 0;
+    while (p < wal.size()) {
+        size_t keyLen = static_cast<uint8_t>(wal[p]);
+        if (wal.size() - p < 1 + keyLen + kWalRecordBytes) break;
+        std::string key(wal, p + 1, keyLen);
+        ArchiveSample s;
+        const char* raw = wal.data() + p + 1 + keyLen;
+        memcpy(&s.t, raw, 8);
+        memcpy(&s.pct, raw + 8, 8);
+        memcpy(&s.resetsAt, raw + 16, 8);
+        fn(key, s);
+        p += 1 + keyLen + kWalRecordBytes;
+    }
+}
+
+bool UsageArchiveWriter::Open(const std::wstring& path)
+{
+    Close();
+    m_series.clear();
+    m_nextId = 0;
+    m_path = path;
+
+    auto data = ReadAll(path);
+    std::vector<Frame> frames;
+    size_t valid = ScanFrames(data, frames);
+    if (!data.empty() && valid == 0) return false;
+
+    if (data.empty() || valid < data.size()) {
+        // Start fresh, or drop a frame torn by a crash mid-append.
+        std::ofstream file(NativePath(path), std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+        if (data.empty())
+            file.write(kMagic, sizeof(kMagic));
+        else
+            file.write(data.data(), valid);
+        if (!file.good()) return false;
+    }
+
+    std::map<int, Series*> byId;
+    for (auto& f : frames) {
+        if (f.type == kFrameSeries) {
+            int id;
+            std::string key;
+            if (!ParseSeries(data, f, id, key)) continue;
+            auto& series = m_series[key];
+            series.id = id;
+            byId[id] = &series;
+            m_nextId = std::max(m_nextId, id + 1);
+        } else if (f.type == kFrameBlock) {
+            BlockHeader h;
+            if (!ParseBlockHeader(data, f, h)) continue;
+            auto it = byId.find(h.series);
+            if (it != byId.end()) it->second->lastT = std::max(it->second->lastT, h.lastT);
+        }
+    }
+
+    m_file.open(NativePath(path), std::ios::binary | std::ios::app);
+    if (!m_file.is_open()) return false;
+
+    // Samples already sealed into a block before a crash are skipped.
+    ForEachWalRecord(ReadAll(path + L".wal"), [this](const std::string& key, const ArchiveSample& s) {
+        auto& series = GetSeries(key);
+        auto last = series.pending.empty() ? series.lastT : series.pending.back().t;
+        if (s.t > last) series.pending.push_back(s);
+    });
+    return RewriteWal();
+}
+
+void UsageArchiveWriter::Close()
+{
+    if (m_file.is_open()) m_file.close();
+    if (m_wal.is_open()) m_wal.close();
+}
+
+UsageArchiveWriter::Series& UsageArchiveWriter::GetSeries(const std::string& key)
+{
+    auto it = m_series.find(key);
+    if (it != m_series.end()) return it->second;
+
+    auto& series = m_series[key];
+    series.id = m_nextId++;
+
+    std::string payload, frame;
+    PutVarint(payload, static_cast<uint64_t>(series.id));
+    payload += key;
+    AppendFrame(frame, kFrameSeries, payload);
+    m_file.write(frame.data(), frame.size());
+    m_file.flush();
+    return series;
+}
+
+bool UsageArchiveWriter::Append(const char* key, const ArchiveSample& sample)
+{
+    if (!IsOpen() || !key || !*key || strlen(key) > 255) return false;
+
+    auto& series = GetSeries(key);
+    auto last = series.pending.empty() ? series.lastT : series.pending.back().t;
+    if (sample.t <= last) return false;
+    series.pending.push_back(sample);
+
+    if (static_cast<int>(series.pending.size()) >= kBlockSamples)
+        return WriteBlock(series) && RewriteWal();
+
+    std::string record;
+    PutWalRecord(record, key, sample);
+    m_wal.write(record.data(), record.size());
+    m_wal.flush();
+    return m_wal.good();
+}
+
+bool UsageArchiveWriter::Flush()
+{
+    if (!IsOpen()) return false;
+
+    bool ok = true;
+    for (auto& entry : m_series) {
+        if (!entry.second.pending.empty()) ok = WriteBlock(entry.second) && ok;
+    }
+    return RewriteWal() && ok;
+}
+
+bool UsageArchiveWriter::WriteBlock(Series& series)
+{
+    std::string frame;
+    AppendFrame(frame, kFrameBlock, EncodeBlock(series.id, series.pending));
+    m_file.write(frame.data(), frame.size());
+    m_file.flush();
+    if (!m_file.good()) return false;
+
+    series.lastT = series.pending.back().t;
+    series.pending.clear();
+    return true;
+}
+
+bool UsageArchiveWriter::RewriteWal()
+{
+    if (m_wal.is_open()) m_wal.close();
+
+    std::string records;
+    for (auto& entry : m_series) {
+        for (auto& s : entry.second.pending) PutWalRecord(records, entry.first, s);
+    }
+
+    m_wal.open(NativePath(m_path + L".wal"), std::ios::binary | std::ios::trunc);
+    if (!m_wal.is_open()) return false;
+    m_wal.write(records.data(), records.size());
+    m_wal.flush();
+    return m_wal.good();
+}
+
+bool UsageArchiveReader::Load(const std::wstring& path)
+{
+    m_data = ReadAll(path);
+    m_ids.clear();
+    m_blocks.clear();
+    m_tail.clear();
+
+    std::vector<Frame> frames;
+    if (ScanFrames(m_data, frames) == 0) return false;
+
+    std::map<int, int64_t> lastT;
+    for (auto& f : frames) {
+        if (f.type == kFrameSeries) {
+            int id;
+            std::string key;
+            if (ParseSeries(m_data, f, id, key)) m_ids[key] = id;
+        } else if (f.type == kFrameBlock) {
+            BlockHeader h;
+            if (!ParseBlockHeader(m_data, f, h)) continue;
+            m_blocks.push_back({h.series, h.count, h.firstT, h.lastT, h.rollups, h.columns, f.end});
+            auto& last = lastT.emplace(h.series, INT64_MIN).first->second;
+            last = std::max(last, h.lastT);
+        }
+    }
+
+    ForEachWalRecord(ReadAll(path + L".wal"), [&](const std::string& key, const ArchiveSample& s) {
+        auto id = m_ids.find(key);
+        if (id != m_ids.end()) {
+            auto last = lastT.find(id->second);
+            if (last != lastT.end() && s.t <= last->second) return;
+        }
+        auto& tail = m_tail[key];
+        if (tail.empty() || s.t > tail.back().t) tail.push_back(s);
+    });
+    return true;
+}
+
+std::vector<std::string> UsageArchiveReader::Keys() const
+{
+    std::vector<std::string> keys;
+    for (auto& entry : m_ids) keys.push_back(entry.first);
+    for (auto& entry : m_tail) {
+        if (!m_ids.count(entry.first)) keys.push_back(entry.first);
+    }
+    return keys;
+}
+
+size_t UsageArchiveReader::SampleCount() const
+{
+    size_t count = 0;
+    for (auto& b : m_blocks) count += b.count;
+    for (auto& entry : m_tail) count += entry.second.size();
+    return count;
+}
+
+bool UsageArchiveReader::Query(const std::string& key, int64_t from, int64_t to,
+    std::vector<ArchiveSample>& out) const
+{
+    out.clear();
+    auto id = m_ids.find(key);
+    auto tail = m_tail.find(key);
+    if (id == m_ids.end() && tail == m_tail.end()) return false;
+
+    if (id != m_ids.end()) {
+        std::vector<ArchiveSample> block;
+        for (auto& b : m_blocks) {
+            if (b.series != id->second || b.lastT < from || b.firstT > to) continue;
+            BlockHeader h;
+            h.count = b.count;
+            h.firstT = b.firstT;
+            h.columns = b.columns;
+            block.clear();
+            if (!DecodeColumns(m_data, h, b.end, block)) return false;
+            for (auto& s : block) {
+                if (s.t >= from && s.t <= to) out.push_back(s);
+            }
+        }
+    }
+    if (tail != m_tail.end()) {
+        for (auto& s : tail->second) {
+            if (s.t >= from && s.t <= to) out.push_back(s);
+        }
+    }
+    return true;
+}
+
+bool UsageArchiveReader::QueryRollup(const std::string& key, int64_t from, int64_t to, int64_t resolution,
+    std::vector<ArchiveRollup>& out) const
+{
+    out.clear();
+    if (resolution != kArchiveHour && resolution != kArchiveDay) return false;
+    auto id = m_ids.find(key);
+    auto tail = m_tail.find(key);
+    if (id == m_ids.end() && tail == m_tail.end()) return false;
+
+    auto fromBucket = BucketStart(from, resolution);
+    std::map<int64_t, RollupAcc> buckets;
+    if (id != m_ids.end()) {
+        for (auto& b : m_blocks) {
+            if (b.series != id->second || b.lastT < fromBucket || b.firstT > to) continue;
+            BlockHeader h;
+            h.firstT = b.firstT;
+            h.rollups = b.rollups;
+            h.columns = b.columns;
+            if (!DecodeRollups(m_data, h, resolution, fromBucket, to, buckets)) return false;
+        }
+    }
+    if (tail != m_tail.end()) {
+        for (auto& s : tail->second) {
+            auto start = BucketStart(s.t, resolution);
+            if (start >= fromBucket && start <= to) buckets[start].Add(ToCenti(s.pct));
+        }
+    }
+
+    out.reserve(buckets.size());
+    for (auto& entry : buckets) {
+        ArchiveRollup r;
+        r.bucketStart = entry.first;
+        r.count = entry.second.count;
+        r.min = entry.second.min / 100.0;
+        r.max = entry.second.max / 100.0;
+        r.mean = static_cast<double>(entry.second.sum) / entry.second.count / 100.0;
+        out.push_back(r);
+    }
+    return true;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <cstdint>
+
+constexpr int64_t kArchiveHour = 3600;
+constexpr int64_t kArchiveDay = 86400;
+
+struct ArchiveSample {
+    int64_t t = 0;
+    double pct = 0.0;
+    int64_t resetsAt = 0;
+};
+
+struct ArchiveRollup {
+    int64_t bucketStart = 0;
+    uint32_t count = 0;
+    double min = 0.0;
+    double max = 0.0;
+    double mean = 0.0;
+};
+
+// Append-only columnar archive of poll results, one series per usage window.
+// Samples are journalled to "<archive>.wal" until kBlockSamples accumulate,
+// then encoded as a block: delta-of-delta timestamps, delta-coded
+// centi-percent utilization and run-length reset epochs, preceded by 1h and
+// 1d min/max/sum partials so rollup queries never decode the columns.
+class UsageArchiveWriter {
+public:
+    static constexpr int kBlockSamples = 64;
+
+    ~UsageArchiveWriter() { Close(); }
+
+    bool Open(const std::wstring& path);
+    void Close();
+    bool IsOpen() const { return m_file.is_open(); }
+
+    // Samples must arrive in time order per key; older ones are dropped.
+    bool Append(const char* key, const ArchiveSample& sample);
+    // Encodes every pending sample, even partial blocks.
+    bool Flush();
+
+private:
+    struct Series {
+        int id = 0;
+        int64_t lastT = INT64_MIN;
+        std::vector<ArchiveSample> pending;
+    };
+
+    Series& GetSeries(const std::string& key);
+    bool WriteBlock(Series& series);
+    bool RewriteWal();
+
+    std::wstring m_path;
+    std::ofstream m_file;
+    std::ofstream m_wal;
+    std::map<std::string, Series> m_series;
+    int m_nextId = 0;
+};
+
+class UsageArchiveReader {
+public:
+    bool Load(const std::wstring& path);
+
+    std::vector<std::string> Keys() const;
+    size_t SampleCount() const;
+    size_t ArchiveBytes() const { return m_data.size(); }
+
+    // Samples with from <= t <= to, in time order.
+    bool Query(const std::string& key, int64_t from, int64_t to, std::vector<ArchiveSample>& out) const;
+    // kArchiveHour or kArchiveDay buckets overlapping [from, to].
+    bool QueryRollup(const std::string& key, int64_t from, int64_t to, int64_t resolution,
+        std::vector<ArchiveRollup>& out) const;
+
+private:
+    struct Block {
+        int series = 0;
+        uint32_t count = 0;
+        int64_t firstT = 0;
+        int64_t lastT = 0;
+        size_t rollups = 0;
+        size_t columns = 0;
+        size_t end = 0;
+    };
+
+    std::string m_data;
+    std::map<std::string, int> m_ids;
+    std::vector<Block> m_blocks;
+    std::map<std::string, std::vector<ArchiveSample>> m_tail;
+};
@@ -0,0 +1,161 @@
+#include "UsageAttribution.h"
+#include "UsageEstimator.h"
+
+#include <cmath>
+
+static const size_t kInitialSlots = 16;
+
+uint64_t AttributionWeight(const TokenCounts& tokens)
+{
+    return static_cast<uint64_t>(std::llround(QuotaWeight(tokens) * 100));
+}
+
+UsageAttribution::UsageAttribution(int64_t bucketMs, uint32_t buckets)
+    : m_bucketMs(bucketMs)
+    , m_slots(kInitialSlots)
+    , m_buckets(buckets)
+{
+}
+
+static uint64_t SlotHash(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return key;
+}
+
+uint32_t UsageAttribution::FindOrAddRow(uint64_t key)
+{
+    size_t mask = m_slots.size() - 1;
+    for (size_t i = SlotHash(key) & mask;; i = (i + 1) & mask) {
+        auto& slot = m_slots[i];
+        if (slot.key == key) return slot.row;
+        if (slot.key != kEmptySlot) continue;
+
+        // Past 70% full the probe runs get long; grow and place it again.
+        if ((m_rows.size() + 1) * 10 > m_slots.size() * 7) {
+            Grow();
+            return FindOrAddRow(key);
+        }
+        AttributionRow row;
+        row.project = static_cast<uint32_t>(key >> 32);
+        row.model = static_cast<uint32_t>(key);
+        slot.key = key;
+        slot.row = static_cast<uint32_t>(m_rows.size());
+        m_rows.push_back(row);
+        return slot.row;
+    }
+}
+
+void UsageAttribution::Grow()
+{
+    std::vector<Slot> slots(m_slots.size() * 2);
+    size_t mask = slots.size() - 1;
+    for (auto& slot : m_slots) {
+        if (slot.key == kEmptySlot) continue;
+        size_t i = SlotHash(slot.key) & mask;
+        while (slots[i].key != kEmptySlot) i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+    m_slots.swap(slots);
+}
+
+void UsageAttribution::Expire(Bucket& bucket)
+{
+    for (auto& [row, weight] : bucket.amounts) {
+        m_rows[row].weight -= weight;
+        m_total -= weight;
+    }
+    bucket.amounts.clear();
+    bucket.index = INT64_MIN;
+}
+
+void UsageAttribution::Add(const TranscriptEntry& contribution)
+{
+    int64_t index = contribution.timeMs / m_bucketMs;
+    uint64_t weight = AttributionWeight(contribution.tokens);
+    if (index < m_oldest || !weight) return;
+
+    auto& bucket = m_buckets[static_cast<size_t>(index % static_cast<int64_t>(m_buckets.size()))];
+    if (bucket.index != index) {
+        // The slot already belongs to a later bucket, so this one is gone.
+        if (bucket.index > index) return;
+        Expire(bucket);
+        bucket.index = index;
+    }
+
+    uint32_t row = FindOrAddRow(static_cast<uint64_t>(contribution.project) << 32 | contribution.model);
+    // Lines arrive a session at a time, so a run usually hits one key.
+    if (!bucket.amounts.empty() && bucket.amounts.back().first == row)
+        bucket.amounts.back().second += weight;
+    else
+        bucket.amounts.emplace_back(row, weight);
+    m_rows[row].weight += weight;
+    m_total += weight;
+}
+
+void UsageAttribution::Advance(int64_t nowMs)
+{
+    auto buckets = static_cast<int64_t>(m_buckets.size());
+    int64_t oldest = nowMs / m_bucketMs - (buckets - 1);
+    if (oldest <= m_oldest) return;
+
+    if (m_oldest == INT64_MIN || oldest - m_oldest >= buckets) {
+        for (auto& bucket : m_buckets)
+            if (bucket.index < oldest) Expire(bucket);
+    } else {
+        for (int64_t i = m_oldest; i < oldest; ++i) {
+            auto& bucket = m_buckets[static_cast<size_t>(i % buckets)];
+            if (bucket.index == i) Expire(bucket);
+        }
+    }
+    m_oldest = oldest;
+}
+
+void UsageAttribution::Clear()
+{
+    for (auto& bucket : m_buckets) {
+        bucket.amounts.clear();
+        bucket.index = INT64_MIN;
+    }
+    m_slots.assign(kInitialSlots, Slot());
+    m_rows.clear();
+    m_oldest = INT64_MIN;
+    m_total = 0;
+}
+
+size_t UsageAttribution::Top(AttributionRow* out, size_t n) const
+{
+    size_t count = 0;
+    for (auto& row : m_rows) {
+        if (!row.weight || (count == n && row.weight <= out[n - 1].weight)) continue;
+        size_t i = count < n ? count++ : n - 1;
+        for (; i > 0 && out[i - 1].weight < row.weight; --i) out[i] = out[i - 1];
+        out[i] = row;
+    }
+    return count;
+}
+
+std::string ProjectLabel(const std::string& directory, const std::wstring& home)
+{
+    std::string prefix;
+    for (wchar_t c : home) {
+        bool alnum = (c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z') || (c >= L'0' && c <= L'9');
+        prefix.push_back(alnum ? static_cast<char>(c) : '-');
+    }
+    if (prefix.empty() || directory.compare(0, prefix.size(), prefix) != 0) return directory;
+    if (directory.size() == prefix.size()) return "~";
+    if (directory[prefix.size()] != '-' || directory.size() == prefix.size() + 1) return directory;
+    return directory.substr(prefix.size() + 1);
+}
+
+std::string ModelLabel(const std::string& model)
+{
+    std::string label = model.compare(0, 7, "claude-") == 0 ? model.substr(7) : model;
+    size_t dash = label.rfind('-');
+    if (dash != std::string::npos && label.size() - dash == 9
+        && label.find_first_not_of("0123456789", dash + 1) == std::string::npos)
+        label.erase(dash);
+    return label.empty() ? model : label;
+}
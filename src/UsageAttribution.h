@@ -0,0 +1,70 @@
+#pragma once
+
+#include "TranscriptScanner.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct AttributionRow {
+    uint32_t project = 0;
+    uint32_t model = 0;
+    // QuotaWeight in hundredths, kept integral so expiry subtracts exactly.
+    uint64_t weight = 0;
+};
+
+// Weighted tokens per (project, model) over a sliding window of
+// bucketMs * buckets. Contributions land in a ring of time buckets, each of
+// which remembers what it added per key; when the window moves past a
+// bucket its amounts are subtracted again, so expiry never looks at the
+// transcripts. Keys are the scanner's interned ids, found through an
+// open-addressing table with linear probing.
+class UsageAttribution {
+public:
+    UsageAttribution(int64_t bucketMs, uint32_t buckets);
+
+    // Anything older than the window as of the last Advance is ignored.
+    void Add(const TranscriptEntry& contribution);
+    // Drops buckets that fell out of the window ending at nowMs.
+    void Advance(int64_t nowMs);
+    void Clear();
+
+    // The n heaviest keys, heaviest first; returns how many were written.
+    size_t Top(AttributionRow* out, size_t n) const;
+    uint64_t Total() const { return m_total; }
+    size_t Keys() const { return m_rows.size(); }
+
+private:
+    static constexpr uint64_t kEmptySlot = UINT64_MAX;
+
+    struct Slot {
+        uint64_t key = kEmptySlot;
+        uint32_t row = 0;
+    };
+
+    struct Bucket {
+        int64_t index = INT64_MIN;
+        // Row and the weight this bucket added to it.
+        std::vector<std::pair<uint32_t, uint64_t>> amounts;
+    };
+
+    uint32_t FindOrAddRow(uint64_t key);
+    void Grow();
+    void Expire(Bucket& bucket);
+
+    int64_t m_bucketMs;
+    std::vector<Slot> m_slots;
+    std::vector<AttributionRow> m_rows;
+    std::vector<Bucket> m_buckets;
+    // Oldest bucket index still inside the window.
+    int64_t m_oldest = INT64_MIN;
+    uint64_t m_total = 0;
+};
+
+uint64_t AttributionWeight(const TokenCounts& tokens);
+// "-home-me-src-app" -> "src-app": the transcripts directory names a project
+// by its path with separators turned into '-'; the home prefix adds nothing.
+std::string ProjectLabel(const std::string& directory, const std::wstring& home);
+// "claude-opus-4-1-20250805" -> "opus-4-1"
+std::string ModelLabel(const std::string& model);
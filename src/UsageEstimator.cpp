@@ -0,0 +1,99 @@
+#include "UsageEstimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// resets_at can move by a few seconds between polls of the same window.
+static const int64_t kResetJitterSec = 300;
+
+double QuotaWeight(const TokenCounts& tokens)
+{
+    return tokens.input + 5.0 * tokens.output + 1.25 * tokens.cacheCreation + 0.1 * tokens.cacheRead;
+}
+
+void TokenTimeline::Build(const std::vector<TranscriptEntry>& entries)
+{
+    std::vector<std::pair<int64_t, double>> points;
+    points.reserve(entries.size());
+    for (auto& e : entries) points.emplace_back(e.timeMs, QuotaWeight(e.tokens));
+    std::sort(points.begin(), points.end());
+
+    m_times.resize(points.size());
+    m_prefix.assign(points.size() + 1, 0.0);
+    for (size_t i = 0; i < points.size(); ++i) {
+        m_times[i] = points[i].first;
+        m_prefix[i + 1] = m_prefix[i] + points[i].second;
+    }
+}
+
+double TokenTimeline::Between(int64_t fromMs, int64_t toMs) const
+{
+    if (toMs <= fromMs) return 0.0;
+    auto from = std::lower_bound(m_times.begin(), m_times.end(), fromMs) - m_times.begin();
+    auto to = std::lower_bound(m_times.begin(), m_times.end(), toMs) - m_times.begin();
+    return m_prefix[to] - m_prefix[from];
+}
+
+bool UsageEstimator::SameWindow(int64_t resetsAt, double pct) const
+{
+    // A drop means the window rolled over even if resets_at did not say so.
+    return resetsAt != 0 && m_resetsAt != 0 && std::llabs(resetsAt - m_resetsAt) < kResetJitterSec
+        && pct >= m_pollPct - 0.5;
+}
+
+void UsageEstimator::OnPoll(double pct, int64_t resetsAt, double windowTokens)
+{
+    if (!SameWindow(resetsAt, pct)) {
+        m_anchorPct = pct;
+        m_anchorTokens = windowTokens;
+    } else if (pct - m_anchorPct >= kMinLearnPct) {
+        // Growth with nothing logged here came from another client and says
+        // nothing about the ratio.
+        double tokens = windowTokens - m_anchorTokens;
+        if (tokens > 0) {
+            double sample = (pct - m_anchorPct) / tokens;
+            m_ratio = m_samples ? m_ratio + kLearnRate * (sample - m_ratio) : sample;
+            ++m_samples;
+        }
+        m_anchorPct = pct;
+        m_anchorTokens = windowTokens;
+    }
+    m_resetsAt = resetsAt;
+    m_pollPct = pct;
+    m_pollTokens = windowTokens;
+}
+
+bool UsageEstimator::Estimate(double windowTokens, int64_t nowSec, double& pct) const
+{
+    if (!m_samples || !m_resetsAt || nowSec >= m_resetsAt) return false;
+    double grown = windowTokens - m_pollTokens;
+    if (grown <= 0) return false;
+    // Only the API can say the window is full.
+    pct = (std::min)(m_pollPct + grown * m_ratio, (std::max)(m_pollPct, 99.0));
+    return true;
+}
+
+EstimateError UsageEstimator::Replay(const std::vector<ArchiveSample>& polls, const TokenTimeline& tokens)
+{
+    EstimateError error;
+    double sum = 0.0, heldSum = 0.0;
+    for (auto& poll : polls) {
+        double windowTokens = tokens.Between((poll.resetsAt - kFiveHourWindowSec) * 1000, poll.t * 1000);
+        if (m_samples && SameWindow(poll.resetsAt, poll.pct)) {
+            double estimate = m_pollPct;
+            Estimate(windowTokens, poll.t, estimate);
+            double miss = std::fabs(estimate - poll.pct);
+            sum += miss;
+            heldSum += std::fabs(m_pollPct - poll.pct);
+            error.maxAbs = (std::max)(error.maxAbs, miss);
+            ++error.polls;
+        }
+        OnPoll(poll.pct, poll.resetsAt, windowTokens);
+    }
+    if (error.polls) {
+        error.meanAbs = sum / error.polls;
+        error.heldMeanAbs = heldSum / error.polls;
+    }
+    return error;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "TranscriptScanner.h"
+#include "UsageArchive.h"
+
+#include <cstdint>
+#include <vector>
+
+constexpr int64_t kFiveHourWindowSec = 5 * 3600;
+
+// Tokens weighted by what they cost against the quota, relative to an input
+// token: output 5x, cache writes 1.25x, cache reads 0.1x.
+double QuotaWeight(const TokenCounts& tokens);
+
+// Weighted token totals over time, for answering many range queries.
+class TokenTimeline {
+public:
+    void Build(const std::vector<TranscriptEntry>& entries);
+    // Weighted tokens logged in [fromMs, toMs).
+    double Between(int64_t fromMs, int64_t toMs) const;
+
+private:
+    std::vector<int64_t> m_times;
+    // m_prefix[i] is the weight of the first i entries.
+    std::vector<double> m_prefix;
+};
+
+struct EstimateError {
+    uint32_t polls = 0;
+    // Estimate just before each poll against the value it returned.
+    double meanAbs = 0.0;
+    double maxAbs = 0.0;
+    // The same for a bar that stays at the previous poll's value.
+    double heldMeanAbs = 0.0;
+};
+
+// Learns how many 5h percentage points a weighted local token is worth from
+// successive polls of one window, and extrapolates the last poll by the
+// tokens logged since. Polls that moved less than kMinLearnPct are folded
+// into the next sample, so the API's rounding does not swamp the ratio.
+class UsageEstimator {
+public:
+    static constexpr double kMinLearnPct = 2.0;
+    static constexpr double kLearnRate = 0.3;
+
+    // windowTokens counts weighted tokens from the window's start to the poll.
+    void OnPoll(double pct, int64_t resetsAt, double windowTokens);
+    // False until calibrated, once the window has reset, or while nothing
+    // has been logged since the poll.
+    bool Estimate(double windowTokens, int64_t nowSec, double& pct) const;
+    // Feeds archived polls in time order, scoring each against the estimate
+    // the ones before it would have given.
+    EstimateError Replay(const std::vector<ArchiveSample>& polls, const TokenTimeline& tokens);
+
+    double Ratio() const { return m_ratio; }
+    uint32_t Samples() const { return m_samples; }
+
+private:
+    bool SameWindow(int64_t resetsAt, double pct) const;
+
+    double m_ratio = 0.0;
+    uint32_t m_samples = 0;
+    int64_t m_resetsAt = 0;
+    double m_pollPct = 0.0;
+    double m_pollTokens = 0.0;
+    double m_anchorPct = 0.0;
+    double m_anchorTokens = 0.0;
+};
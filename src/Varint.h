@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// LEB128 varints shared by the on-disk formats. Reads stop at end, which
+// may be a frame or column boundary inside in, not just in.size().
+
+inline void PutVarint(std::string& out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+inline bool GetVarint(const std::string& in, size_t& pos, size_t end, uint64_t& v)
+{
+    v = 0;
+    for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+        auto byte = static_cast<uint8_t>(in[pos++]);
+        v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
@@ -1,73 +1,211 @@
 #include "WorkerThread.h"
 #include "ApiClient.h"
 #include "Settings.h"
+#include "SnapshotStore.h"
 
-#include <chrono>
+#include <algorithm>
 #include <ctime>
-#include <sstream>
-#include <iomanip>
 
-static std::wstring FormatResetsIn(const std::string& isoTimestamp)
-{
-    if (isoTimestamp.empty()) return L"";
-
-    std::tm tm = {};
-    std::istringstream ss(isoTimestamp);
-    ss >> std::get_time(&tm, "%Y-%m-%dT%H:%M:%S");
-    if (ss.fail()) return L"Unknown";
+static const uint64_t kCredentialsDebounceMs = 300;
+static const uint64_t kHousekeepingMs = 10 * 60 * 1000;
+static const int64_t kTokenCheckMinMs = 60 * 1000;
+static const int64_t kTokenCheckMaxMs = 60 * 60 * 1000;
+static const uint64_t kHousekeepingToleranceMs = 60 * 1000;
+static const uint64_t kTokenCheckToleranceMs = 30 * 1000;
+static const uint64_t kProbeAfterIdleMs = 10 * 60 * 1000;
+static const int kProbeTimeoutMs = 3000;
 
-    time_t resetTime = _mkgmtime(&tm);
-    time_t now = time(nullptr);
-    auto diff = static_cast<int64_t>(difftime(resetTime, now));
+void FormatResetsIn(int64_t resetsAt, int64_t now, wchar_t* out, size_t outLen)
+{
+    if (resetsAt == 0) {
+        if (outLen) out[0] = L'\0';
+        return;
+    }
+    if (resetsAt < 0) {
+        swprintf_s(out, outLen, L"Unknown");
+        return;
+    }
 
-    if (diff <= 0) return L"Now";
+    auto diff = resetsAt - now;
+    if (diff <= 0) {
+        swprintf_s(out, outLen, L"Now");
+        return;
+    }
 
     int days = static_cast<int>(diff / 86400);
     int hours = static_cast<int>((diff % 86400) / 3600);
     int minutes = static_cast<int>((diff % 3600) / 60);
 
-    wchar_t buf[64];
     if (days > 0)
-        swprintf_s(buf, L"Resets in %dd %dh", days, hours);
+        swprintf_s(out, outLen, L"Resets in %dd %dh", days, hours);
     else if (hours > 0)
-        swprintf_s(buf, L"Resets in %dh %dm", hours, minutes);
+        swprintf_s(out, outLen, L"Resets in %dh %dm", hours, minutes);
     else
-        swprintf_s(buf, L"Resets in %dm", minutes);
+        swprintf_s(out, outLen, L"Resets in %dm", minutes);
+}
 
+std::wstring FormatResetsIn(int64_t resetsAt, int64_t now)
+{
+    wchar_t buf[64];
+    FormatResetsIn(resetsAt, now, buf, _countof(buf));
     return buf;
 }
 
-static std::wstring Utf8ToWide(const std::string& str)
+// Replayed traces never reach the network, so they are not metered.
+static ApiGovernor& BudgetedGovernor()
+{
+    auto& governor = ApiGovernor::Shared();
+    governor.SetBudget(IsHttpReplayActive() ? 0 : static_cast<uint32_t>(Settings::Instance().Get()->apiBudgetPerHour));
+    return governor;
+}
+
+static void SetErrorMessage(UsageData& data, const std::string& error)
+{
+    auto wide = Utf8ToWide(error);
+    size_t len = (std::min)(wide.size(), _countof(data.error_msg) - 1);
+    wide.copy(data.error_msg, len);
+    data.error_msg[len] = L'\0';
+}
+
+void WorkerThread::SetAccount(const std::wstring& credentialsPath, const std::wstring& statePath)
+{
+    m_credentialsPath = credentialsPath;
+    m_statePath = statePath;
+}
+
+void WorkerThread::SetOnUpdate(std::function<void()> onUpdate)
+{
+    m_onUpdate = std::move(onUpdate);
+}
+
+void WorkerThread::NotifyUpdate()
+{
+    if (m_onUpdate) m_onUpdate();
+}
+
+// Every task resolves GetCredentialsPath() to this worker's account.
+std::function<void()> WorkerThread::InAccount(void (WorkerThread::*task)())
+{
+    return [this, task] {
+        CredentialsPathScope scope(m_credentialsPath);
+        (this->*task)();
+    };
+}
+
+void WorkerThread::Seed(const UsageData& data)
 {
-    if (str.empty()) return {};
-    int len = MultiByteToWideChar(CP_UTF8, 0, str.c_str(), -1, nullptr, 0);
-    std::wstring result(len - 1, L'\0');
-    MultiByteToWideChar(CP_UTF8, 0, str.c_str(), -1, result.data(), len);
-    return result;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_data = data;
+    m_data.stale = true;
 }
 
 void WorkerThread::Start()
 {
-    m_shutdown = false;
-    m_thread = std::thread(&WorkerThread::Run, this);
+    if (m_running.exchange(true)) return;
+    m_startTick = TickMs();
+
+    auto& scheduler = Scheduler::Shared();
+    // Everything that reads credentials or reaches the network shares the
+    // blocking lane, which also keeps those steps from overlapping.
+    m_credentialsTask = scheduler.Add(TaskPriority::High, InAccount(&WorkerThread::CheckCredentials), true);
+    m_tokenTask = scheduler.Add(TaskPriority::High, InAccount(&WorkerThread::RefreshTokenIfDue), true);
+    m_pollTask = scheduler.Add(TaskPriority::Normal, InAccount(&WorkerThread::Poll), true);
+    m_persistTask = scheduler.Add(TaskPriority::Low, [this] { PersistSnapshot(); }, true);
+    m_housekeepingTask = scheduler.Add(TaskPriority::Low, InAccount(&WorkerThread::Housekeeping), true);
+
+    InAccount(&WorkerThread::SyncWatcher)();
+    m_prewarm = std::async(std::launch::async, PrewarmConnections);
+    scheduler.ScheduleIn(m_pollTask, 0);
+    scheduler.ScheduleIn(m_housekeepingTask, kHousekeepingMs, kHousekeepingToleranceMs);
 }
 
 void WorkerThread::Stop()
 {
-    m_shutdown = true;
-    m_cv.notify_one();
-    if (m_thread.joinable()) {
-        if (m_thread.get_id() != std::this_thread::get_id())
-            m_thread.join();
-        else
-            m_thread.detach();
+    if (!m_running.exchange(false)) return;
+
+    m_presence.Stop();
+    m_connectivity.Stop();
+    m_watcher.Stop();
+    auto& scheduler = Scheduler::Shared();
+    // The poll task drains before the persist task is checked, so the last
+    // completed poll still reaches the snapshot and archive.
+    bool persistPending = false;
+    for (auto* task : {&m_credentialsTask, &m_tokenTask, &m_pollTask, &m_persistTask, &m_housekeepingTask}) {
+        if (task == &m_persistTask) persistPending = scheduler.IsScheduled(*task);
+        scheduler.Remove(*task);
+        *task = -1;
+    }
+    if (persistPending) PersistSnapshot();
+    m_archive.Close();
+    if (m_prewarm.valid()) m_prewarm.wait();
+    CloseHttpSession();
+}
+
+void WorkerThread::WatchPresence()
+{
+    m_presence.Start([this](PresenceEvent event) { OnPresenceEvent(event); });
+    m_connectivity.Start([this](bool online) {
+        OnPresenceEvent(online ? PresenceEvent::NetworkRestored : PresenceEvent::NetworkLost);
+    });
+}
+
+PollPlan WorkerThread::PlanNextPollLocked()
+{
+    if (m_paused) {
+        PollPlan plan;
+        plan.suspended = true;
+        return plan;
     }
+    SyncSettingsLocked();
+    uint64_t sinceLast = m_lastPollTick ? TickMs() - m_lastPollTick : UINT64_MAX;
+    return m_policy.Plan(m_intervalMs, sinceLast);
 }
 
-void WorkerThread::RequestRefresh()
+void WorkerThread::SyncSettingsLocked()
 {
-    m_refreshRequested = true;
-    m_cv.notify_one();
+    auto settings = Settings::Instance().Get();
+    if (settings->version == m_settingsVersion) return;
+    m_intervalMs = static_cast<uint64_t>(settings->pollInterval) * 1000;
+    m_spacingMs = static_cast<uint64_t>(settings->minRefreshSpacing) * 1000;
+    m_settingsVersion = settings->version;
+}
+
+void WorkerThread::OnPresenceEvent(PresenceEvent event)
+{
+    bool pollNow;
+    bool busy;
+    PollPlan plan;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        pollNow = m_policy.OnEvent(event) && !m_paused;
+        // After a sleep the first poll checks the route before committing
+        // to full-length timeouts.
+        if (event == PresenceEvent::Resumed) m_probeBeforePoll = true;
+        plan = PlanNextPollLocked();
+        // Poll() plans its successor when it finishes.
+        busy = m_pendingGeneration || m_inFlightGeneration;
+    }
+    if (!m_running || busy) return;
+
+    auto& scheduler = Scheduler::Shared();
+    if (pollNow) scheduler.ScheduleIn(m_pollTask, 0);
+    else if (plan.suspended) scheduler.Cancel(m_pollTask);
+    else scheduler.Reschedule(m_pollTask, plan.delayMs, plan.toleranceMs);
+}
+
+uint64_t WorkerThread::RequestRefresh(bool force)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_inFlightGeneration) return m_inFlightGeneration;
+    if (m_pendingGeneration) return m_pendingGeneration;
+
+    SyncSettingsLocked();
+    if (!force && m_data.completed_tick && TickMs() - m_data.completed_tick < m_spacingMs)
+        return m_data.completed_generation;
+
+    m_pendingGeneration = ++m_lastGeneration;
+    Scheduler::Shared().ScheduleIn(m_pollTask, 0);
+    return m_pendingGeneration;
 }
 
 UsageData WorkerThread::GetSnapshot()
@@ -76,38 +214,233 @@ UsageData WorkerThread::GetSnapshot()
     return m_data;
 }
 
-void WorkerThread::Run()
-{
-    while (!m_shutdown) {
-        m_refreshRequested = false;
-        auto result = FetchUsageWithAutoRefresh();
-
-        {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            if (result.success) {
-                m_data.five_hour_pct = result.usage.fiveHourPct;
-                m_data.seven_day_pct = result.usage.sevenDayPct;
-                m_data.five_hour_resets = FormatResetsIn(result.usage.fiveHourResetsAt);
-                m_data.seven_day_resets = FormatResetsIn(result.usage.sevenDayResetsAt);
-                m_data.last_success_tick = GetTickCount64();
-
-                if (!result.error.empty()) {
-                    m_data.has_error = true;
-                    m_data.error_msg = Utf8ToWide(result.error);
-                } else {
-                    m_data.has_error = false;
-                    m_data.error_msg.clear();
-                }
+bool WorkerThread::CopySnapshot(UsageData& out)
+{
+    std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+    bool waited = !lock.owns_lock();
+    if (waited) lock.lock();
+    out = m_data;
+    return waited;
+}
+
+PollArenaStats WorkerThread::GetArenaStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_arenaStats;
+}
+
+LatencyHistogram WorkerThread::GetPollLatency()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pollLatency;
+}
+
+void WorkerThread::ResetPollLatency()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pollLatency = LatencyHistogram();
+}
+
+void WorkerThread::SetPaused(bool paused)
+{
+    if (m_paused.exchange(paused) == paused || !m_running) return;
+    bool busy;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        busy = m_pendingGeneration || m_inFlightGeneration;
+    }
+    if (busy) return;
+    // Resuming catches up at once rather than waiting out an interval.
+    auto& scheduler = Scheduler::Shared();
+    if (paused) scheduler.Cancel(m_pollTask);
+    else scheduler.ScheduleIn(m_pollTask, 0);
+}
+
+void WorkerThread::SyncWatcher()
+{
+    auto& path = GetCredentialsPath();
+    if (m_watcher.IsRunning() && m_watcher.GetPath() == path) return;
+    // Editors and the CLI write in bursts; each event pushes the check back.
+    m_watcher.Start(path, [this] {
+        Scheduler::Shared().Reschedule(m_credentialsTask, kCredentialsDebounceMs);
+    });
+}
+
+void WorkerThread::CheckCredentials()
+{
+    if (!HasCredentialsFileChanged()) return;
+    InvalidateCredentialsCache();
+    auto& scheduler = Scheduler::Shared();
+    scheduler.ScheduleIn(m_tokenTask, 0);
+    if (!m_paused) scheduler.ScheduleIn(m_pollTask, 0);
+}
+
+void WorkerThread::RefreshTokenIfDue()
+{
+    int64_t nextMs = kTokenCheckMaxMs;
+    auto creds = ReadCredentials();
+    if (creds.success && !IsHttpReplayActive()) {
+        nextMs = MsUntilTokenRefresh(creds.credentials);
+        if (IsTokenExpired(creds.credentials)) {
+            ApiAdmission admission(ApiPriority::TokenRefresh, BudgetedGovernor());
+            if (admission.Granted()) {
+                auto refreshed = RefreshToken(creds.credentials);
+                if (refreshed.success) creds = refreshed;
+                nextMs = MsUntilTokenRefresh(creds.credentials);
             } else {
+                nextMs = static_cast<int64_t>(admission.RetryMs());
+            }
+        }
+    }
+    if (nextMs < kTokenCheckMinMs) nextMs = kTokenCheckMinMs;
+    if (nextMs > kTokenCheckMaxMs) nextMs = kTokenCheckMaxMs;
+    Scheduler::Shared().ScheduleIn(m_tokenTask, static_cast<uint64_t>(nextMs), kTokenCheckToleranceMs);
+}
+
+void WorkerThread::Poll()
+{
+    uint64_t generation;
+    bool manual;
+    bool offline;
+    bool probe;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        manual = m_pendingGeneration != 0;
+        generation = m_pendingGeneration ? m_pendingGeneration : ++m_lastGeneration;
+        m_pendingGeneration = 0;
+        m_inFlightGeneration = generation;
+        offline = !m_policy.IsOnline();
+        probe = m_probeBeforePoll || m_data.offline
+            || (m_lastPollTick && TickMs() - m_lastPollTick > kProbeAfterIdleMs);
+        m_probeBeforePoll = false;
+    }
+
+    if (!offline && probe) offline = !ProbeReachability(kProbeTimeoutMs);
+    if (offline) {
+        CompleteOffline(generation);
+        return;
+    }
+
+    ApiAdmission admission(manual ? ApiPriority::Manual : ApiPriority::Scheduled, BudgetedGovernor());
+    if (!admission.Granted()) {
+        CompleteDeferred(generation, admission.RetryMs());
+        return;
+    }
+
+    SyncWatcher();
+    ApiResponse result;
+    uint64_t fetchStart = PerfCounter();
+    {
+        PollArenaScope scope(m_arena);
+        result = FetchUsageWithAutoRefresh();
+    }
+    uint64_t fetchUs = PerfCounterUs(PerfCounter() - fetchStart);
+    m_arena.Reset();
+
+    bool persist = false;
+    PollPlan next;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inFlightGeneration = 0;
+        m_lastPollTick = TickMs();
+        next = PlanNextPollLocked();
+        m_arenaStats = m_arena.GetStats();
+        m_pollLatency.Add(fetchUs);
+        m_data.completed_generation = generation;
+        m_data.completed_tick = TickMs();
+        m_data.offline = false;
+        m_data.deferred_until = 0;
+        if (result.success) {
+            m_data.usage = result.usage;
+            m_data.fetched_at = static_cast<int64_t>(time(nullptr));
+            m_data.stale = false;
+            m_data.last_success_tick = TickMs();
+            if (m_data.first_data_ms == 0)
+                m_data.first_data_ms = m_data.last_success_tick - m_startTick;
+
+            if (!result.error.empty()) {
                 m_data.has_error = true;
-                m_data.error_msg = Utf8ToWide(result.error);
+                SetErrorMessage(m_data, result.error);
+            } else {
+                m_data.has_error = false;
+                m_data.error_msg[0] = L'\0';
             }
+            persist = true;
+        } else {
+            m_data.has_error = true;
+            SetErrorMessage(m_data, result.error);
         }
+    }
+
+    auto& scheduler = Scheduler::Shared();
+    if (persist) scheduler.ScheduleIn(m_persistTask, 0);
+    if (!scheduler.IsScheduled(m_tokenTask))
+        scheduler.ScheduleIn(m_tokenTask, kTokenCheckMinMs, kTokenCheckToleranceMs);
+    if (!next.suspended) scheduler.ScheduleIn(m_pollTask, next.delayMs, next.toleranceMs);
+    NotifyUpdate();
+}
 
-        std::unique_lock<std::mutex> lock(m_mutex);
-        auto interval = std::chrono::seconds(Settings::Instance().Get().pollInterval);
-        m_cv.wait_for(lock, interval, [this] {
-            return m_shutdown.load() || m_refreshRequested.load();
-        });
+// Finishes a poll without touching the network, keeping the last data and
+// error message as they were.
+void WorkerThread::CompleteOffline(uint64_t generation)
+{
+    PollPlan next;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inFlightGeneration = 0;
+        m_lastPollTick = TickMs();
+        m_data.completed_generation = generation;
+        m_data.completed_tick = m_lastPollTick;
+        m_data.offline = true;
+        m_data.deferred_until = 0;
+        next = PlanNextPollLocked();
     }
+    if (!next.suspended) Scheduler::Shared().ScheduleIn(m_pollTask, next.delayMs, next.toleranceMs);
+    NotifyUpdate();
+}
+
+// Finishes a poll the API budget turned away and retries once it allows.
+// The click, if any, completes now so the UI stops waiting on it.
+void WorkerThread::CompleteDeferred(uint64_t generation, uint64_t retryMs)
+{
+    PollPlan next;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inFlightGeneration = 0;
+        m_data.completed_generation = generation;
+        m_data.completed_tick = TickMs();
+        m_data.deferred_until = static_cast<int64_t>(time(nullptr)) + static_cast<int64_t>((retryMs + 999) / 1000);
+        next = PlanNextPollLocked();
+    }
+    if (!next.suspended)
+        Scheduler::Shared().ScheduleIn(m_pollTask, (std::max)(retryMs, next.delayMs), next.toleranceMs);
+    NotifyUpdate();
+}
+
+void WorkerThread::PersistSnapshot()
+{
+    auto data = GetSnapshot();
+    if (data.fetched_at <= 0) return;
+    auto& settings = Settings::Instance();
+    auto snapshotPath = m_statePath.empty() ? settings.GetSnapshotPath() : m_statePath + L".snapshot.json";
+    auto archivePath = m_statePath.empty() ? settings.GetArchivePath() : m_statePath + L".archive";
+    if (snapshotPath.empty()) return;
+    SaveUsageSnapshot(snapshotPath, data);
+
+    if (!m_archive.IsOpen() && !m_archive.Open(archivePath))
+        return;
+    for (int i = 0; i < data.usage.count; ++i) {
+        auto& w = data.usage.windows[i];
+        ArchiveSample sample;
+        sample.t = data.fetched_at;
+        sample.pct = w.pct;
+        sample.resetsAt = w.resetsAt;
+        m_archive.Append(w.key, sample);
+    }
+}
+
+void WorkerThread::Housekeeping()
+{
+    SyncWatcher();
+    Scheduler::Shared().ScheduleIn(m_housekeepingTask, kHousekeepingMs, kHousekeepingToleranceMs);
 }
@@ -2,37 +2,117 @@
 
 #include <string>
 #include <mutex>
-#include <thread>
-#include <condition_variable>
 #include <atomic>
-
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include "Platform.h"
+#include "CredentialsWatcher.h"
+#include "ApiClient.h"
+#include "ApiBudget.h"
+#include "Scheduler.h"
+#include "UsageArchive.h"
+#include "PollArena.h"
+#include "PollPolicy.h"
+#include "PresenceMonitor.h"
+#include "ConnectivityMonitor.h"
+#include "LatencyHistogram.h"
 
 struct UsageData {
-    double five_hour_pct = 0.0;
-    double seven_day_pct = 0.0;
-    std::wstring five_hour_resets;
-    std::wstring seven_day_resets;
+    UsageResult usage;
+    int64_t fetched_at = 0;
+    bool stale = false;
     bool has_error = false;
-    std::wstring error_msg;
-    ULONGLONG last_success_tick = 0;
+    bool offline = false;
+    // Unix time the API budget allows the next poll; 0 when not deferred.
+    int64_t deferred_until = 0;
+    wchar_t error_msg[256] = {};
+    uint64_t last_success_tick = 0;
+    // Time from Start() to the first successful poll; 0 until then.
+    uint64_t first_data_ms = 0;
+    uint64_t completed_generation = 0;
+    uint64_t completed_tick = 0;
 };
 
+std::wstring FormatResetsIn(int64_t resetsAt, int64_t now);
+void FormatResetsIn(int64_t resetsAt, int64_t now, wchar_t* out, size_t outLen);
+
+// Poll, token-refresh and housekeeping jobs run as tasks on the shared
+// Scheduler; no thread is owned here.
 class WorkerThread {
 public:
+    // Polls this credentials file and keeps the snapshot and archive beside
+    // statePath instead of the Settings defaults. Empty keeps the default;
+    // call before Start().
+    void SetAccount(const std::wstring& credentialsPath, const std::wstring& statePath);
+    // Runs on the scheduler thread after every completed poll.
+    void SetOnUpdate(std::function<void()> onUpdate);
+    void Seed(const UsageData& data);
     void Start();
     void Stop();
-    void RequestRefresh();
+    // Follows lock, display, power and network changes; call from a thread
+    // that pumps messages.
+    void WatchPresence();
+    void OnPresenceEvent(PresenceEvent event);
+    // Returns the generation whose completion answers this request; a
+    // snapshot with completed_generation at or past it reflects the click.
+    // force skips the MinRefreshSpacing reuse of a poll that just finished.
+    uint64_t RequestRefresh(bool force = false);
+    // Stops scheduled polls until unpaused; RequestRefresh still polls once.
+    void SetPaused(bool paused);
+    bool IsPaused() const { return m_paused; }
     UsageData GetSnapshot();
+    // True when it had to wait for a poll to release the snapshot.
+    bool CopySnapshot(UsageData& out);
+    PollArenaStats GetArenaStats();
+    // Time spent fetching, for polls that reached the network.
+    LatencyHistogram GetPollLatency();
+    void ResetPollLatency();
 
 private:
-    void Run();
+    void Poll();
+    void CompleteOffline(uint64_t generation);
+    void CompleteDeferred(uint64_t generation, uint64_t retryMs);
+    void RefreshTokenIfDue();
+    void CheckCredentials();
+    void PersistSnapshot();
+    void Housekeeping();
+    void SyncWatcher();
+    PollPlan PlanNextPollLocked();
+    void SyncSettingsLocked();
+    std::function<void()> InAccount(void (WorkerThread::*task)());
+    void NotifyUpdate();
 
-    std::thread m_thread;
     std::mutex m_mutex;
-    std::condition_variable m_cv;
-    std::atomic<bool> m_shutdown{false};
-    std::atomic<bool> m_refreshRequested{false};
+    std::atomic<bool> m_running{false};
+    std::atomic<bool> m_paused{false};
+    std::wstring m_credentialsPath;
+    std::wstring m_statePath;
+    std::function<void()> m_onUpdate;
+    // DNS and TLS warm-up, overlapping the first poll's credentials read.
+    std::future<void> m_prewarm;
+    uint64_t m_lastGeneration = 0;
+    uint64_t m_pendingGeneration = 0;
+    uint64_t m_inFlightGeneration = 0;
+    Scheduler::TaskId m_pollTask = -1;
+    Scheduler::TaskId m_tokenTask = -1;
+    Scheduler::TaskId m_credentialsTask = -1;
+    Scheduler::TaskId m_persistTask = -1;
+    Scheduler::TaskId m_housekeepingTask = -1;
+    CredentialsWatcher m_watcher;
+    PresenceMonitor m_presence;
+    ConnectivityMonitor m_connectivity;
+    PollPolicy m_policy;
+    // Poll timing derived from the settings version it was read from.
+    uint64_t m_settingsVersion = UINT64_MAX;
+    uint64_t m_intervalMs = 0;
+    uint64_t m_spacingMs = 0;
+    uint64_t m_lastPollTick = 0;
+    bool m_probeBeforePoll = false;
+    UsageArchiveWriter m_archive;
+    PollArena m_arena;
+    PollArenaStats m_arenaStats;
+    LatencyHistogram m_pollLatency;
     UsageData m_data;
+    uint64_t m_startTick = 0;
 };
@@ -14,7 +14,9 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserv
         Settings::Instance().Load();
         break;
     case DLL_PROCESS_DETACH:
-        ClaudeUsagePlugin::Instance().Shutdown();
+        // At process exit the other threads are already gone and Shutdown
+        // would wait for them forever; each poll has saved its results.
+        if (!lpReserved) ClaudeUsagePlugin::Instance().Shutdown();
         break;
     }
     return TRUE;
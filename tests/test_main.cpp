@@ -5,11 +5,58 @@
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#include <winsock2.h>
 
 #include "../src/ApiClient.h"
 #include "../src/WorkerThread.h"
+#include "../src/Settings.h"
+#include "../src/CredentialsWatcher.h"
+#include "../src/HttpTrace.h"
+#include "../src/HttpTransport.h"
+#include "../src/SnapshotStore.h"
+#include "../src/Renderer.h"
+#include "../src/Scheduler.h"
+#include "../src/CredentialsFile.h"
+#include "../src/ProxyResolver.h"
+#include "../src/UsageArchive.h"
+#include "../src/Plugin.h"
+#include "../src/PollArena.h"
+#include "../src/PollPolicy.h"
+#include "../src/ConnectivityMonitor.h"
+#include "../src/Hedge.h"
+#include "../src/ApiBudget.h"
+#include "../src/TranscriptScanner.h"
+#include "../src/SessionMeter.h"
+#include "../src/UsageEstimator.h"
+#include "../src/UsageAttribution.h"
+#include "../src/UiWatchdog.h"
+#include <fstream>
 #include <thread>
 #include <chrono>
+#include <atomic>
+#include <vector>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <cstdlib>
+#include <new>
+
+// Counts operator new calls on the current thread while enabled, so the UI
+// entry points can be checked without noise from the worker.
+static thread_local bool t_countAllocations = false;
+static thread_local unsigned long long t_allocationCount = 0;
+
+void* operator new(std::size_t size)
+{
+    if (t_countAllocations) ++t_allocationCount;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
 
 void test_placeholder();
 void test_read_credentials();
@@ -18,6 +65,41 @@ void test_refresh_token();
 void test_fetch_usage();
 void test_worker_thread();
 void test_worker_request_refresh();
+void test_settings_concurrent_publish();
+void test_credentials_watcher();
+void test_http_trace_roundtrip();
+void test_http_trace_ring();
+void test_fetch_usage_replay();
+void test_reset_formatting();
+void test_usage_snapshot_roundtrip();
+void test_usage_window_table();
+void test_render_layout_cache();
+void test_bar_animation();
+void test_timer_wheel();
+void test_scheduler_shared_wakeup();
+void test_scheduler_blocking_lane();
+void test_refresh_coalescing();
+void test_refresh_spacing();
+void test_patch_oauth_credentials();
+void test_refresh_reuses_disk_token();
+void test_proxy_connect_standin();
+void test_usage_archive_roundtrip();
+void bench_usage_archive_year();
+void test_ui_entry_points_allocation_free();
+void test_poll_arena_flat_footprint();
+void test_poll_policy_presence();
+void test_offline_polls_skip_network();
+void test_api_budget_governor();
+void test_transcript_scanner();
+void bench_transcript_scan();
+void test_session_meter();
+void test_usage_estimator();
+void test_usage_attribution();
+void test_ui_watchdog();
+void test_plugin_commands();
+void test_https_cancel_mid_request();
+void bench_hedged_requests();
+void bench_render_item();
 
 int main()
 {
@@ -30,6 +112,41 @@ int main()
     test_fetch_usage();
     test_worker_thread();
     test_worker_request_refresh();
+    test_settings_concurrent_publish();
+    test_credentials_watcher();
+    test_http_trace_roundtrip();
+    test_http_trace_ring();
+    test_fetch_usage_replay();
+    test_reset_formatting();
+    test_usage_snapshot_roundtrip();
+    test_usage_window_table();
+    test_render_layout_cache();
+    test_bar_animation();
+    test_timer_wheel();
+    test_scheduler_shared_wakeup();
+    test_scheduler_blocking_lane();
+    test_refresh_coalescing();
+    test_refresh_spacing();
+    test_patch_oauth_credentials();
+    test_refresh_reuses_disk_token();
+    test_proxy_connect_standin();
+    test_usage_archive_roundtrip();
+    bench_usage_archive_year();
+    test_ui_entry_points_allocation_free();
+    test_poll_arena_flat_footprint();
+    test_poll_policy_presence();
+    test_offline_polls_skip_network();
+    test_api_budget_governor();
+    test_transcript_scanner();
+    bench_transcript_scan();
+    test_session_meter();
+    test_usage_estimator();
+    test_usage_attribution();
+    test_ui_watchdog();
+    test_plugin_commands();
+    test_https_cancel_mid_request();
+    bench_hedged_requests();
+    bench_render_item();
 
     printf("\n=== All tests passed ===\n");
     return 0;
@@ -94,44 +211,69 @@ void test_fetch_usage()
 {
     auto result = FetchUsageWithAutoRefresh();
     if (result.success) {
-        assert(result.usage.fiveHourPct >= 0.0 && result.usage.fiveHourPct <= 100.0);
-        assert(result.usage.sevenDayPct >= 0.0 && result.usage.sevenDayPct <= 100.0);
-        assert(!result.usage.fiveHourResetsAt.empty());
-        assert(!result.usage.sevenDayResetsAt.empty());
-        printf("[PASS] test_fetch_usage (live) - 5h: %.1f%%, 7d: %.1f%%\n",
-            result.usage.fiveHourPct, result.usage.sevenDayPct);
+        auto* fiveHour = result.usage.Find("five_hour");
+        auto* sevenDay = result.usage.Find("seven_day");
+        assert(fiveHour && sevenDay);
+        assert(fiveHour->pct >= 0.0 && fiveHour->pct <= 100.0);
+        assert(sevenDay->pct >= 0.0 && sevenDay->pct <= 100.0);
+        assert(fiveHour->resetsAt > 0);
+        assert(sevenDay->resetsAt > 0);
+        printf("[PASS] test_fetch_usage (live) - 5h: %.1f%%, 7d: %.1f%%, %d windows\n",
+            fiveHour->pct, sevenDay->pct, result.usage.count);
     } else {
         printf("[FAIL] test_fetch_usage: %s\n", result.error.c_str());
         assert(false);
     }
 }
 
+static std::wstring TempFilePath(const wchar_t* name)
+{
+    wchar_t tempDir[MAX_PATH] = {};
+    GetTempPathW(MAX_PATH, tempDir);
+    return std::wstring(tempDir) + name;
+}
+
+// Workers under test keep their snapshot and archive under a temp stem, never
+// beside the test binary.
+static void DeleteStateFiles(const std::wstring& stem)
+{
+    for (auto ext : {L".snapshot.json", L".archive", L".archive.wal"})
+        DeleteFileW((stem + ext).c_str());
+}
+
 void test_worker_thread()
 {
+    auto statePath = TempFilePath(L"claude-usage-worker-state");
     WorkerThread worker;
+    worker.SetAccount(L"", statePath);
     worker.Start();
 
     for (int i = 0; i < 150; ++i) {
         auto snap = worker.GetSnapshot();
         if (snap.last_success_tick > 0) {
-            assert(snap.five_hour_pct >= 0.0 && snap.five_hour_pct <= 100.0);
-            assert(snap.seven_day_pct >= 0.0 && snap.seven_day_pct <= 100.0);
+            for (int w = 0; w < snap.usage.count; ++w)
+                assert(snap.usage.windows[w].pct >= 0.0 && snap.usage.windows[w].pct <= 100.0);
+            assert(snap.usage.Find("five_hour") && snap.usage.Find("seven_day"));
             printf("[PASS] test_worker_thread - 5h: %.1f%%, 7d: %.1f%%\n",
-                snap.five_hour_pct, snap.seven_day_pct);
+                snap.usage.Find("five_hour")->pct, snap.usage.Find("seven_day")->pct);
             worker.Stop();
+            DeleteStateFiles(statePath);
             return;
         }
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
 
     worker.Stop();
+    DeleteStateFiles(statePath);
     printf("[FAIL] test_worker_thread: no data after 15s\n");
     assert(false);
 }
 
 void test_worker_request_refresh()
 {
+    auto statePath = TempFilePath(L"claude-usage-worker-refresh-state");
     WorkerThread worker;
+    worker.SetAccount(L"", statePath);
     worker.Start();
 
     for (int i = 0; i < 150; ++i) {
@@ -139,19 +281,1868 @@ void test_worker_request_refresh()
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
 
+    // The first poll just finished, well inside MinRefreshSpacing.
     auto before = worker.GetSnapshot().last_success_tick;
-    worker.RequestRefresh();
+    worker.RequestRefresh(true);
 
     for (int i = 0; i < 150; ++i) {
         if (worker.GetSnapshot().last_success_tick > before) {
             printf("[PASS] test_worker_request_refresh\n");
             worker.Stop();
+            DeleteStateFiles(statePath);
             return;
         }
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
 
     worker.Stop();
+    DeleteStateFiles(statePath);
     printf("[FAIL] test_worker_request_refresh: no update\n");
     assert(false);
 }
+
+void test_settings_concurrent_publish()
+{
+    auto& settings = Settings::Instance();
+    PluginSettings original = settings.Get();
+    auto startVersion = original.version;
+
+    const int kPublishes = 2000;
+    std::atomic<bool> done{false};
+    std::atomic<bool> torn{false};
+
+    auto reader = [&] {
+        uint64_t lastVersion = 0;
+        while (!done) {
+            auto s = settings.Get();
+            if (s->version < lastVersion) torn = true;
+            lastVersion = s->version;
+            if (s->version > startVersion) {
+                int i = s->itemWidth - 80;
+                if (s->pollInterval != 10 + i || s->credentialsPath != L"stress-" + std::to_wstring(i))
+                    torn = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r) readers.emplace_back(reader);
+
+    std::thread writer([&] {
+        for (int n = 0; n < kPublishes; ++n) {
+            PluginSettings next = settings.Get();
+            int i = n % 300;
+            next.itemWidth = 80 + i;
+            next.pollInterval = 10 + i;
+            next.credentialsPath = L"stress-" + std::to_wstring(i);
+            settings.Publish(std::move(next));
+        }
+    });
+
+    writer.join();
+    done = true;
+    for (auto& t : readers) t.join();
+
+    assert(!torn);
+    assert(settings.Get()->version == startVersion + kPublishes);
+
+    // With every reader gone the replaced snapshots are freed.
+    settings.Publish(original);
+    assert(settings.RetainedSnapshots() == 0);
+    printf("[PASS] test_settings_concurrent_publish\n");
+}
+
+void test_credentials_watcher()
+{
+    wchar_t tempDir[MAX_PATH] = {};
+    GetTempPathW(MAX_PATH, tempDir);
+    std::wstring dir = std::wstring(tempDir) + L"claude-usage-watch-test";
+    CreateDirectoryW(dir.c_str(), nullptr);
+    std::wstring target = dir + L"\\.credentials.json";
+    std::wstring other = dir + L"\\unrelated.txt";
+
+    auto touch = [](const std::wstring& path) {
+        HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        DWORD written = 0;
+        WriteFile(h, "{}", 2, &written, nullptr);
+        CloseHandle(h);
+    };
+
+    std::atomic<int> hits{0};
+    CredentialsWatcher watcher;
+    assert(watcher.Start(target, [&] { ++hits; }));
+
+    touch(other);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    assert(hits == 0);
+
+    touch(target);
+    for (int i = 0; i < 50 && hits == 0; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    assert(hits > 0);
+
+    watcher.Stop();
+    assert(!watcher.IsRunning());
+    DeleteFileW(target.c_str());
+    DeleteFileW(other.c_str());
+    printf("[PASS] test_credentials_watcher\n");
+}
+
+void test_http_trace_roundtrip()
+{
+    auto path = TempFilePath(L"claude-usage-trace-test.jsonl");
+    DeleteFileW(path.c_str());
+
+    {
+        HttpRecorder recorder;
+        assert(recorder.Open(path));
+        HttpExchange ex;
+        ex.method = "POST";
+        ex.host = "platform.claude.com";
+        ex.path = "/v1/oauth/token";
+        ex.requestHeaders = "Authorization: Bearer sk-secret\r\nContent-Type: application/json";
+        ex.requestBody = R"({"grant_type":"refresh_token","refresh_token":"rt-secret"})";
+        ex.statusCode = 200;
+        ex.responseBody = R"({"access_token":"at-secret","expires_in":3600})";
+        ex.startMs = TraceClockMs();
+        ex.durationMs = 120;
+        recorder.Append(ex);
+    }
+
+    std::ifstream raw(path, std::ios::binary);
+    std::string text((std::istreambuf_iterator<char>(raw)), std::istreambuf_iterator<char>());
+    raw.close();
+    assert(text.find("secret") == std::string::npos);
+
+    HttpReplay replay;
+    assert(replay.Load(path));
+    HttpExchange out;
+    assert(!replay.Next("GET", "platform.claude.com", "/v1/oauth/token", out));
+    assert(replay.Next("POST", "platform.claude.com", "/v1/oauth/token", out));
+    assert(out.statusCode == 200 && out.durationMs == 120);
+    assert(out.requestHeaders.find("Bearer <redacted>") != std::string::npos);
+    assert(out.responseBody.find("expires_in") != std::string::npos);
+    assert(replay.Remaining() == 0);
+
+    DeleteFileW(path.c_str());
+    printf("[PASS] test_http_trace_roundtrip\n");
+}
+
+void test_http_trace_ring()
+{
+    auto path = TempFilePath(L"claude-usage-trace-ring-test.jsonl");
+    DeleteFileW(path.c_str());
+
+    HttpTraceRing ring;
+    HttpExchange ex;
+    ex.method = "GET";
+    ex.host = "api.anthropic.com";
+    ex.requestHeaders = "Authorization: Bearer sk-secret";
+    ex.statusCode = 200;
+    for (int i = 0; i < 40; ++i) {
+        ex.path = "/api/oauth/usage?n=" + std::to_string(i);
+        ex.startMs = 1000 + i;
+        ring.Append(ex);
+    }
+    assert(ring.Size() == HttpTraceRing::kCapacity);
+    assert(ring.Dump(path));
+
+    std::ifstream raw(path, std::ios::binary);
+    std::string text((std::istreambuf_iterator<char>(raw)), std::istreambuf_iterator<char>());
+    raw.close();
+    assert(text.find("secret") == std::string::npos);
+
+    // Only the newest exchanges survive, oldest first.
+    HttpReplay replay;
+    assert(replay.Load(path));
+    assert(replay.Remaining() == HttpTraceRing::kCapacity);
+    HttpExchange out;
+    assert(!replay.Next("GET", "api.anthropic.com", "/api/oauth/usage?n=7", out));
+    assert(replay.Next("GET", "api.anthropic.com", "/api/oauth/usage?n=8", out));
+    assert(out.requestHeaders.find("Bearer <redacted>") != std::string::npos);
+
+    DeleteFileW(path.c_str());
+    printf("[PASS] test_http_trace_ring\n");
+}
+
+void test_fetch_usage_replay()
+{
+    auto path = TempFilePath(L"claude-usage-replay-test.jsonl");
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << R"({"t":0,"d":5,"m":"GET","h":"api.anthropic.com","p":"/api/oauth/usage","s":200,)"
+             << R"("rb":"{\"five_hour\":{\"utilization\":42.0,\"resets_at\":\"2030-01-01T00:00:00Z\"},)"
+             << R"(\"seven_day\":{\"utilization\":7.5,\"resets_at\":\"2030-01-03T00:00:00Z\"},)"
+             << R"(\"seven_day_opus\":{\"utilization\":3.0,\"resets_at\":null},)"
+             << R"(\"seven_day_sonnet\":{\"utilization\":null,\"resets_at\":\"2030-01-03T00:00:00Z\"},)"
+             << R"(\"seven_day_oauth_apps\":null,\"extra_usage\":{\"is_enabled\":false}}"})" << "\n";
+        file << R"({"t":60000,"d":5,"m":"GET","h":"api.anthropic.com","p":"/api/oauth/usage","s":401,"rb":""})" << "\n";
+    }
+
+    assert(EnableHttpReplay(path, 0.0));
+    Credentials creds;
+    creds.accessToken = "unused";
+
+    auto first = FetchUsage(creds);
+    assert(first.success && first.error.empty());
+    assert(first.usage.count == 3);
+    assert(first.usage.Find("five_hour")->pct == 42.0);
+    assert(first.usage.Find("seven_day")->pct == 7.5);
+    assert(first.usage.Find("seven_day")->resetsAt == 1893628800);
+    assert(first.usage.Find("seven_day_opus")->pct == 3.0);
+    assert(first.usage.Find("seven_day_opus")->resetsAt == 0);
+    assert(!first.usage.Find("seven_day_sonnet"));
+    assert(!first.usage.Find("extra_usage"));
+
+    auto second = FetchUsage(creds);
+    assert(!second.success && second.error.find("HTTP 401") != std::string::npos);
+
+    auto exhausted = FetchUsage(creds);
+    assert(!exhausted.success);
+
+    DisableHttpTrace();
+    DeleteFileW(path.c_str());
+    printf("[PASS] test_fetch_usage_replay\n");
+}
+
+void test_reset_formatting()
+{
+    auto epoch = ParseIsoUtc("2030-01-01T00:00:00.123456+00:00");
+    assert(epoch == 1893456000);
+    assert(ParseIsoUtc("") == 0);
+    assert(ParseIsoUtc("garbage") < 0);
+
+    assert(FormatResetsIn(epoch, epoch - (2 * 86400 + 3 * 3600)) == L"Resets in 2d 3h");
+    assert(FormatResetsIn(epoch, epoch - (4 * 3600 + 5 * 60)) == L"Resets in 4h 5m");
+    assert(FormatResetsIn(epoch, epoch - 17 * 60) == L"Resets in 17m");
+    assert(FormatResetsIn(epoch, epoch + 1) == L"Now");
+    assert(FormatResetsIn(-1, epoch) == L"Unknown");
+    assert(FormatResetsIn(0, epoch).empty());
+    printf("[PASS] test_reset_formatting\n");
+}
+
+void test_usage_snapshot_roundtrip()
+{
+    auto path = TempFilePath(L"claude-usage-snapshot-test.json");
+
+    UsageData data;
+    auto* fiveHour = data.usage.Add("five_hour");
+    fiveHour->pct = 63.0;
+    fiveHour->resetsAt = 1893456000;
+    auto* sevenDay = data.usage.Add("seven_day");
+    sevenDay->pct = 21.5;
+    sevenDay->resetsAt = 1893628800;
+    data.usage.Add("seven_day_opus")->pct = 4.0;
+    data.fetched_at = 1893450000;
+    assert(SaveUsageSnapshot(path, data));
+
+    UsageData loaded;
+    assert(LoadUsageSnapshot(path, loaded));
+    assert(loaded.stale);
+    assert(loaded.usage.count == 3);
+    assert(loaded.usage.Find("five_hour")->pct == 63.0);
+    assert(loaded.usage.Find("five_hour")->resetsAt == 1893456000);
+    assert(loaded.usage.Find("seven_day")->pct == 21.5);
+    assert(loaded.usage.Find("seven_day")->resetsAt == 1893628800);
+    assert(loaded.usage.Find("seven_day_opus")->pct == 4.0);
+    assert(loaded.fetched_at == data.fetched_at);
+    assert(loaded.last_success_tick == 0);
+
+    DeleteFileW(path.c_str());
+    assert(!LoadUsageSnapshot(path, loaded));
+    printf("[PASS] test_usage_snapshot_roundtrip\n");
+}
+
+void test_usage_window_table()
+{
+    UsageResult table;
+    char key[16];
+    for (int i = 0; i < kMaxUsageWindows; ++i) {
+        sprintf_s(key, "window_%d", i);
+        assert(table.Add(key));
+    }
+    assert(!table.Add("one_too_many"));
+    assert(table.count == kMaxUsageWindows);
+    assert(table.Find("window_3") == &table.windows[3]);
+    assert(!table.Find("window_99"));
+
+    UsageResult small;
+    assert(!small.Add("a_key_that_is_far_too_long_to_fit_in_a_table_slot"));
+    printf("[PASS] test_usage_window_table\n");
+}
+
+struct BenchDC {
+    HDC dc = CreateCompatibleDC(nullptr);
+    HBITMAP bitmap = CreateCompatibleBitmap(GetDC(nullptr), 400, 40);
+    HFONT font = CreateFontW(-15, 0, 0, 0, 400, 0, 0, 0, 0, 0, 0, 0, 0, L"Segoe UI");
+
+    BenchDC()
+    {
+        SelectObject(dc, bitmap);
+        SelectObject(dc, font);
+    }
+    ~BenchDC()
+    {
+        DeleteDC(dc);
+        DeleteObject(bitmap);
+        DeleteObject(font);
+    }
+};
+
+static double ElapsedUs(const LARGE_INTEGER& start, const LARGE_INTEGER& end)
+{
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    return (end.QuadPart - start.QuadPart) * 1e6 / freq.QuadPart;
+}
+
+void test_render_layout_cache()
+{
+    BenchDC bench;
+    RenderLayout layout;
+
+    auto missesBefore = GetRenderStats().layoutMisses;
+    RenderUsageItem(bench.dc, 0, 0, 160, 30, 96, layout, true, L"", 42.0, true, 0, false);
+    RenderUsageItem(bench.dc, 10, 0, 160, 30, 96, layout, true, L"", 43.0, true, 0, false);
+    assert(GetRenderStats().layoutMisses == missesBefore + 1);
+
+    RenderUsageItem(bench.dc, 0, 0, 200, 30, 96, layout, true, L"", 43.0, true, 0, false);
+    RenderUsageItem(bench.dc, 0, 0, 200, 30, 144, layout, true, L"", 43.0, true, 0, false);
+    assert(GetRenderStats().layoutMisses == missesBefore + 3);
+
+    for (const wchar_t* text : {L"7%", L"42%", L"100%", L"--", L"..."}) {
+        SIZE gdi;
+        GetTextExtentPoint32W(bench.dc, text, static_cast<int>(wcslen(text)), &gdi);
+        int table = 0;
+        for (const wchar_t* c = text; *c; ++c) {
+            INT advance = 0;
+            GetCharWidth32W(bench.dc, *c, *c, &advance);
+            table += advance;
+        }
+        assert(abs(gdi.cx - table) <= 1);
+    }
+    printf("[PASS] test_render_layout_cache\n");
+}
+
+void bench_render_item()
+{
+    BenchDC bench;
+    const int kFrames = 20000;
+    LARGE_INTEGER start, end;
+
+    RenderLayout cold;
+    QueryPerformanceCounter(&start);
+    for (int i = 0; i < kFrames; ++i) {
+        cold.valid = false;
+        RenderUsageItem(bench.dc, 0, 0, 160, 30, 96, cold, true, L"", i % 101, true, 0, false);
+    }
+    QueryPerformanceCounter(&end);
+    double coldUs = ElapsedUs(start, end) / kFrames;
+
+    RenderLayout warm;
+    QueryPerformanceCounter(&start);
+    for (int i = 0; i < kFrames; ++i)
+        RenderUsageItem(bench.dc, 0, 0, 160, 30, 96, warm, true, L"", i % 101, true, 0, false);
+    QueryPerformanceCounter(&end);
+    double warmUs = ElapsedUs(start, end) / kFrames;
+
+    BarAnimation bar;
+    bar.Snap(0.0);
+    ULONGLONG tick = 0;
+    QueryPerformanceCounter(&start);
+    for (int i = 0; i < kFrames; ++i) {
+        if (!bar.active) bar.Retarget(i % 2 ? 0.0 : 100.0, tick);
+        tick += 16;
+        RenderUsageItem(bench.dc, 0, 0, 160, 30, 96, warm, true, L"", bar.Sample(tick), true, 0, false);
+    }
+    QueryPerformanceCounter(&end);
+    double animUs = ElapsedUs(start, end) / kFrames;
+
+    printf("[BENCH] bench_render_item: cold %.2f us/frame, warm %.2f us/frame, animating %.2f us/frame\n",
+        coldUs, warmUs, animUs);
+}
+
+void test_bar_animation()
+{
+    BarAnimation bar;
+    bar.Snap(20.0);
+    assert(!bar.active && bar.Sample(0) == 20.0);
+
+    bar.Retarget(80.0, 1000);
+    assert(bar.active);
+    double early = bar.Sample(1000 + kBarAnimationMs / 4);
+    double mid = bar.Sample(1000 + kBarAnimationMs / 2);
+    assert(early > 20.0 && early < mid && mid < 80.0);
+    assert(mid - 20.0 > (80.0 - 20.0) / 2);
+
+    bar.Retarget(50.0, 1000 + kBarAnimationMs / 2);
+    assert(bar.from == mid && bar.to == 50.0);
+
+    assert(bar.Sample(1000 + kBarAnimationMs * 2) == 50.0);
+    assert(!bar.active);
+
+    bar.Retarget(50.0, 5000);
+    assert(!bar.active);
+    printf("[PASS] test_bar_animation\n");
+}
+
+void test_timer_wheel()
+{
+    TimerWheel wheel;
+    std::vector<int> out;
+
+    wheel.Expire(1000, out);
+    wheel.Insert(0, 1010);
+    wheel.Insert(1, 1000 + TimerWheel::kTickMs * TimerWheel::kSlots + 10);
+    wheel.Insert(2, 500);
+    assert(wheel.Size() == 3);
+
+    uint64_t due = 0;
+    assert(wheel.NextDue(due) && due == 500);
+
+    wheel.Expire(1005, out);
+    assert(out.size() == 1 && out[0] == 2);
+
+    out.clear();
+    wheel.Expire(1010, out);
+    assert(out.size() == 1 && out[0] == 0);
+
+    out.clear();
+    wheel.Expire(1000 + TimerWheel::kTickMs * TimerWheel::kSlots, out);
+    assert(out.empty());
+
+    wheel.Insert(1, 90000);
+    wheel.Erase(1);
+    assert(wheel.Size() == 0 && !wheel.NextDue(due));
+
+    wheel.Insert(3, 200000);
+    out.clear();
+    wheel.Expire(300000, out);
+    assert(out.size() == 1 && out[0] == 3);
+    printf("[PASS] test_timer_wheel\n");
+}
+
+void test_scheduler_shared_wakeup()
+{
+    Scheduler scheduler;
+    std::vector<int> order;
+    std::mutex orderMutex;
+    auto record = [&](int tag) {
+        std::lock_guard<std::mutex> lock(orderMutex);
+        order.push_back(tag);
+    };
+
+    auto low = scheduler.Add(TaskPriority::Low, [&] { record(2); });
+    auto normal = scheduler.Add(TaskPriority::Normal, [&] { record(1); });
+    auto high = scheduler.Add(TaskPriority::High, [&] { record(0); });
+
+    // Schedule the whole batch under one due time so a single wake-up runs it.
+    auto before = scheduler.GetStats();
+    scheduler.Cancel(low);
+    scheduler.ScheduleIn(low, 200);
+    scheduler.ScheduleIn(normal, 200);
+    scheduler.ScheduleIn(high, 200);
+    scheduler.ScheduleIn(high, 5000);
+    assert(scheduler.IsScheduled(high));
+
+    for (int i = 0; i < 100 && scheduler.GetStats().tasksRun - before.tasksRun < 3; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    auto after = scheduler.GetStats();
+    assert(after.tasksRun - before.tasksRun == 3);
+    {
+        std::lock_guard<std::mutex> lock(orderMutex);
+        assert(order.size() == 3 && order[0] == 0 && order[1] == 1 && order[2] == 2);
+    }
+
+    scheduler.Reschedule(normal, 60000);
+    scheduler.Remove(normal);
+    assert(!scheduler.IsScheduled(normal));
+    scheduler.Remove(low);
+    scheduler.Remove(high);
+
+    printf("[PASS] test_scheduler_shared_wakeup - %llu wake-up(s) for 3 tasks\n",
+        static_cast<unsigned long long>(after.wakeups - before.wakeups));
+}
+
+void test_scheduler_blocking_lane()
+{
+    Scheduler scheduler;
+    std::atomic<bool> release{false};
+    std::atomic<int> shortRuns{0};
+    std::atomic<int> blockingRuns{0};
+
+    // A blocking task stuck on the network must not hold up a short one.
+    auto slow = scheduler.Add(TaskPriority::High, [&] {
+        while (!release) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        ++blockingRuns;
+    }, true);
+    auto quick = scheduler.Add(TaskPriority::Low, [&] { ++shortRuns; });
+    scheduler.ScheduleIn(slow, 0);
+    scheduler.ScheduleIn(quick, 100);
+    for (int i = 0; i < 100 && shortRuns == 0; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    assert(shortRuns == 1 && blockingRuns == 0);
+
+    release = true;
+    for (int i = 0; i < 100 && blockingRuns == 0; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    assert(blockingRuns == 1);
+
+    // A task removing itself returns instead of waiting for its own run.
+    Scheduler::TaskId self = -1;
+    std::atomic<bool> removed{false};
+    self = scheduler.Add(TaskPriority::Normal, [&] {
+        scheduler.Remove(self);
+        removed = true;
+    }, true);
+    scheduler.ScheduleIn(self, 0);
+    for (int i = 0; i < 100 && !removed; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    assert(removed);
+    scheduler.ScheduleIn(self, 0);
+    assert(!scheduler.IsScheduled(self));
+
+    scheduler.Remove(slow);
+    scheduler.Remove(quick);
+    printf("[PASS] test_scheduler_blocking_lane\n");
+}
+
+void test_refresh_coalescing()
+{
+    auto tracePath = TempFilePath(L"claude-usage-coalesce-test.jsonl");
+    {
+        std::ofstream file(tracePath, std::ios::binary | std::ios::trunc);
+        const char* usage = R"("rb":"{\"five_hour\":{\"utilization\":%d.0,\"resets_at\":null},)"
+                            R"(\"seven_day\":{\"utilization\":1.0,\"resets_at\":null}}"})";
+        char line[512];
+        for (int pct : {10, 20}) {
+            file << R"({"t":0,"d":300,"m":"GET","h":"api.anthropic.com","p":"/api/oauth/usage","s":200,)";
+            snprintf(line, sizeof(line), usage, pct);
+            file << line << "\n";
+        }
+        file << R"({"t":0,"d":50,"m":"GET","h":"api.anthropic.com","p":"/api/oauth/usage","s":500,"rb":""})" << "\n";
+    }
+
+    PluginSettings original = Settings::Instance().Get();
+    auto isolated = original;
+    isolated.credentialsPath = TempFilePath(L"claude-usage-coalesce-missing.json");
+    isolated.minRefreshSpacing = 60;
+    Settings::Instance().Publish(isolated);
+    assert(EnableHttpReplay(tracePath, 1.0));
+
+    auto statePath = TempFilePath(L"claude-usage-coalesce-state");
+    WorkerThread worker;
+    worker.SetAccount(L"", statePath);
+    worker.Start();
+
+    // Every click during the first fetch joins it.
+    uint64_t first = worker.RequestRefresh();
+    for (int i = 0; i < 5; ++i)
+        assert(worker.RequestRefresh() == first);
+
+    for (int i = 0; i < 100 && worker.GetSnapshot().completed_generation < first; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto snap = worker.GetSnapshot();
+    assert(snap.completed_generation == first);
+    assert(snap.usage.Find("five_hour")->pct == 10.0);
+
+    // A click right after completion is served from that result.
+    assert(worker.RequestRefresh() == first);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    assert(worker.GetSnapshot().usage.Find("five_hour")->pct == 10.0);
+
+    // A forced click skips the spacing.
+    uint64_t second = worker.RequestRefresh(true);
+    assert(second > first);
+    for (int i = 0; i < 100 && worker.GetSnapshot().completed_generation < second; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    assert(worker.GetSnapshot().usage.Find("five_hour")->pct == 20.0);
+    assert(worker.GetPollLatency().count == 2);
+
+    // Without spacing, clicks start new generations; a failed fetch still completes one.
+    PluginSettings unspaced = Settings::Instance().Get();
+    unspaced.minRefreshSpacing = 0;
+    Settings::Instance().Publish(unspaced);
+
+    uint64_t third = worker.RequestRefresh();
+    for (int i = 0; i < 100 && worker.GetSnapshot().completed_generation < third; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    snap = worker.GetSnapshot();
+    assert(snap.completed_generation == third && snap.has_error);
+
+    worker.Stop();
+    DeleteStateFiles(statePath);
+    DisableHttpTrace();
+    Settings::Instance().Publish(original);
+    DeleteFileW(tracePath.c_str());
+    printf("[PASS] test_refresh_coalescing\n");
+}
+
+void test_refresh_spacing()
+{
+    auto tracePath = TempFilePath(L"claude-usage-spacing-test.jsonl");
+    {
+        std::ofstream file(tracePath, std::ios::binary | std::ios::trunc);
+        for (int i = 0; i < 3; ++i)
+            file << R"({"t":0,"d":5,"m":"GET","h":"api.anthropic.com","p":"/api/oauth/usage","s":200,)"
+                 << R"("rb":"{\"five_hour\":{\"utilization\":1.0,\"resets_at\":null},)"
+                 << R"(\"seven_day\":{\"utilization\":1.0,\"resets_at\":null}}"})" << "\n";
+    }
+
+    PluginSettings original = Settings::Instance().Get();
+    auto spaced = original;
+    spaced.credentialsPath = TempFilePath(L"claude-usage-spacing-missing.json");
+    spaced.minRefreshSpacing = 1;
+    Settings::Instance().Publish(spaced);
+    assert(EnableHttpReplay(tracePath, 0.0));
+
+    auto waitFor = [](WorkerThread& worker, uint64_t generation) {
+        for (int i = 0; i < 100 && worker.GetSnapshot().completed_generation < generation; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return worker.GetSnapshot().completed_generation >= generation;
+    };
+
+    auto statePath = TempFilePath(L"claude-usage-spacing-state");
+    WorkerThread worker;
+    worker.SetAccount(L"", statePath);
+    worker.Start();
+    uint64_t first = worker.RequestRefresh(true);
+    assert(waitFor(worker, first));
+
+    // Within the spacing a click reuses the poll that just finished...
+    assert(worker.RequestRefresh() == first);
+    // ...unless it is forced.
+    uint64_t forced = worker.RequestRefresh(true);
+    assert(forced > first && waitFor(worker, forced));
+
+    // Once the spacing has passed a plain click polls again.
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    uint64_t later = worker.RequestRefresh();
+    assert(later > forced && waitFor(worker, later));
+    assert(worker.GetPollLatency().count == 3);
+
+    worker.Stop();
+    DeleteStateFiles(statePath);
+    DisableHttpTrace();
+    Settings::Instance().Publish(original);
+    DeleteFileW(tracePath.c_str());
+    printf("[PASS] test_refresh_spacing\n");
+}
+
+void test_patch_oauth_credentials()
+{
+    std::string original =
+        "{\n  \"mcp\": {\"claudeAiOauth\": 1},\n"
+        "  \"claudeAiOauth\" : {\"accessToken\": \"at-\\\"old\", \"scopes\": [\"a\", {\"b\": \"}\"}],\n"
+        "    \"refreshToken\":\"rt-old\", \"expiresAt\": 123, \"subscriptionType\": \"max\"},\n"
+        "  \"tail\": true\n}";
+
+    Credentials creds;
+    creds.accessToken = "at-new";
+    creds.refreshToken = "rt-new";
+    creds.expiresAt = 1893456000000;
+
+    std::string patched;
+    assert(PatchOAuthCredentials(original, creds, patched));
+    std::string expected =
+        "{\n  \"mcp\": {\"claudeAiOauth\": 1},\n"
+        "  \"claudeAiOauth\" : {\"accessToken\": \"at-new\", \"scopes\": [\"a\", {\"b\": \"}\"}],\n"
+        "    \"refreshToken\":\"rt-new\", \"expiresAt\": 1893456000000, \"subscriptionType\": \"max\"},\n"
+        "  \"tail\": true\n}";
+    assert(patched == expected);
+
+    assert(!PatchOAuthCredentials(R"({"claudeAiOauth": {"accessToken": "x"}})", creds, patched));
+    assert(!PatchOAuthCredentials("not json", creds, patched));
+    printf("[PASS] test_patch_oauth_credentials\n");
+}
+
+void test_refresh_reuses_disk_token()
+{
+    auto credsPath = TempFilePath(L"claude-usage-cas-test.json");
+    auto tracePath = TempFilePath(L"claude-usage-cas-trace.jsonl");
+    auto freshExpiry = static_cast<int64_t>(time(nullptr) + 3600) * 1000;
+    {
+        std::ofstream file(credsPath, std::ios::binary | std::ios::trunc);
+        file << R"({"claudeAiOauth":{"accessToken":"at-cli","refreshToken":"rt-cli","expiresAt":)"
+             << freshExpiry << "}}";
+    }
+    {
+        std::ofstream file(tracePath, std::ios::binary | std::ios::trunc);
+    }
+
+    PluginSettings original = Settings::Instance().Get();
+    auto isolated = original;
+    isolated.credentialsPath = credsPath;
+    Settings::Instance().Publish(isolated);
+    assert(EnableHttpReplay(tracePath, 0.0));
+
+    // The CLI already rotated the token; the stale copy must not hit the network.
+    Credentials stale;
+    stale.accessToken = "at-old";
+    stale.refreshToken = "rt-old";
+    stale.expiresAt = 0;
+    auto result = RefreshToken(stale);
+    assert(result.success);
+    assert(result.credentials.accessToken == "at-cli" && result.credentials.refreshToken == "rt-cli");
+    assert(GetFileAttributesW((credsPath + L".lock").c_str()) == INVALID_FILE_ATTRIBUTES);
+
+    // While someone else holds the lock the refresh token is left alone.
+    {
+        std::ofstream file(credsPath, std::ios::binary | std::ios::trunc);
+        file << R"({"claudeAiOauth":{"accessToken":"at-old","refreshToken":"rt-old","expiresAt":0}})";
+    }
+    {
+        std::ofstream file(tracePath, std::ios::binary | std::ios::trunc);
+        file << R"({"t":0,"d":5,"m":"POST","h":"platform.claude.com","p":"/v1/oauth/token","s":200,)"
+             << R"("rb":"{\"access_token\":\"at-new\",\"refresh_token\":\"rt-new\",\"expires_in\":3600}"})" << "\n";
+    }
+    assert(EnableHttpReplay(tracePath, 0.0));
+    assert(CreateDirectoryW((credsPath + L".lock").c_str(), nullptr));
+    result = RefreshToken(stale);
+    assert(!result.success && result.error.find("locked") != std::string::npos);
+    RemoveDirectoryW((credsPath + L".lock").c_str());
+
+    // A refresh slower than the stale period keeps its lock fresh meanwhile.
+    {
+        std::ofstream file(tracePath, std::ios::binary | std::ios::trunc);
+        file << R"({"t":0,"d":8000,"m":"POST","h":"platform.claude.com","p":"/v1/oauth/token","s":200,)"
+             << R"("rb":"{\"access_token\":\"at-new\",\"refresh_token\":\"rt-new\",\"expires_in\":3600}"})" << "\n";
+    }
+    assert(EnableHttpReplay(tracePath, 1.0));
+    std::atomic<bool> refreshed{false};
+    uint64_t oldestMs = 0;
+    std::thread sampler([&] {
+        for (uint64_t ageMs; !refreshed; Sleep(100))
+            if (GetFileAgeMs(credsPath + L".lock", ageMs)) oldestMs = (std::max)(oldestMs, ageMs);
+    });
+    result = RefreshToken(stale);
+    refreshed = true;
+    sampler.join();
+    assert(result.success && result.credentials.refreshToken == "rt-new");
+    assert(oldestMs > 0 && oldestMs < 6500);
+
+    DisableHttpTrace();
+    Settings::Instance().Publish(original);
+    InvalidateCredentialsCache();
+    DeleteFileW(credsPath.c_str());
+    DeleteFileW(tracePath.c_str());
+    printf("[PASS] test_refresh_reuses_disk_token\n");
+}
+
+void test_proxy_connect_standin()
+{
+    WSADATA wsa;
+    assert(WSAStartup(MAKEWORD(2, 2), &wsa) == 0);
+
+    SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    assert(listener != INVALID_SOCKET);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+    assert(listen(listener, 4) == 0);
+    int addrLen = sizeof(addr);
+    getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &addrLen);
+    int port = ntohs(addr.sin_port);
+
+    // Accepts CONNECTs, records the target and refuses the tunnel.
+    std::atomic<int> connects{0};
+    std::string firstRequest;
+    std::thread standIn([&] {
+        for (;;) {
+            SOCKET client = accept(listener, nullptr, nullptr);
+            if (client == INVALID_SOCKET) return;
+            char buf[2048];
+            int n = recv(client, buf, sizeof(buf) - 1, 0);
+            if (n > 0) {
+                buf[n] = '\0';
+                if (connects++ == 0) firstRequest = buf;
+            }
+            const char* reply = "HTTP/1.1 502 Bad Gateway\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            send(client, reply, static_cast<int>(strlen(reply)), 0);
+            closesocket(client);
+        }
+    });
+
+    PluginSettings original = Settings::Instance().Get();
+    auto proxied = original;
+    proxied.proxyUrl = L"http://127.0.0.1:" + std::to_wstring(port);
+    proxied.proxyBypass.clear();
+    Settings::Instance().Publish(proxied);
+
+    auto before = GetProxyStats();
+    Credentials creds;
+    creds.accessToken = "unused";
+    auto first = FetchUsage(creds);
+    auto second = FetchUsage(creds);
+    auto after = GetProxyStats();
+
+    closesocket(listener);
+    standIn.join();
+    Settings::Instance().Publish(original);
+    WSACleanup();
+
+    assert(!first.success && !second.success);
+    assert(connects == 2);
+    assert(firstRequest.rfind("CONNECT api.anthropic.com:443 ", 0) == 0);
+    assert(after.resolutions - before.resolutions == 1);
+    assert(after.cacheHits - before.cacheHits == 1);
+    printf("[PASS] test_proxy_connect_standin - resolve %llu us\n",
+        static_cast<unsigned long long>(after.lastResolveUs));
+}
+
+static ArchiveSample ArchiveTestSample(int64_t t0, int i)
+{
+    ArchiveSample s;
+    s.t = t0 + i * 60 + (i % 7 == 0 ? 1 : 0);
+    s.pct = (i % 300) / 3.0;
+    s.resetsAt = t0 + (i / 300 + 1) * 18000;
+    return s;
+}
+
+void test_usage_archive_roundtrip()
+{
+    auto path = TempFilePath(L"claude-usage-archive-test.archive");
+    DeleteFileW(path.c_str());
+    DeleteFileW((path + L".wal").c_str());
+
+    const int64_t t0 = 1767225600;
+    const int n = 3 * 1440 + 10;
+    {
+        UsageArchiveWriter writer;
+        assert(writer.Open(path));
+        for (int i = 0; i < n; ++i) {
+            assert(writer.Append("five_hour", ArchiveTestSample(t0, i)));
+            ArchiveSample weekly = ArchiveTestSample(t0, i);
+            weekly.pct = i / 100.0;
+            weekly.resetsAt = t0 + 7 * 86400;
+            assert(writer.Append("seven_day", weekly));
+        }
+        assert(!writer.Append("five_hour", ArchiveTestSample(t0, 0)));
+    }
+
+    UsageArchiveReader reader;
+    assert(reader.Load(path));
+    assert(reader.SampleCount() == 2 * static_cast<size_t>(n));
+    double bytesPerSample = static_cast<double>(reader.ArchiveBytes()) / reader.SampleCount();
+    assert(bytesPerSample < 4.0);
+
+    // Full blocks plus the WAL tail come back exactly, to 0.01%.
+    std::vector<ArchiveSample> samples;
+    assert(reader.Query("five_hour", t0, t0 + 10 * 86400, samples));
+    assert(static_cast<int>(samples.size()) == n);
+    for (int i = 0; i < n; ++i) {
+        auto expected = ArchiveTestSample(t0, i);
+        assert(samples[i].t == expected.t && samples[i].resetsAt == expected.resetsAt);
+        assert(fabs(samples[i].pct - expected.pct) < 0.006);
+    }
+
+    std::vector<ArchiveRollup> hours;
+    assert(reader.QueryRollup("five_hour", t0, t0 + 86400 - 1, kArchiveHour, hours));
+    assert(hours.size() == 24);
+    for (auto& h : hours) assert(h.count == 60);
+
+    std::vector<ArchiveRollup> days;
+    assert(reader.QueryRollup("seven_day", t0, t0 + 10 * 86400, kArchiveDay, days));
+    assert(days.size() == 4 && days[0].count == 1440 && days[3].count == 10);
+    assert(days[0].min == 0.0 && fabs(days[0].max - 14.39) < 0.001);
+
+    {
+        UsageArchiveWriter writer;
+        assert(writer.Open(path));
+        assert(writer.Append("five_hour", ArchiveTestSample(t0, n)));
+    }
+    assert(reader.Load(path));
+    assert(reader.Query("five_hour", t0, t0 + 10 * 86400, samples) && static_cast<int>(samples.size()) == n + 1);
+
+    DeleteFileW(path.c_str());
+    DeleteFileW((path + L".wal").c_str());
+    printf("[PASS] test_usage_archive_roundtrip - %.2f bytes/sample\n", bytesPerSample);
+}
+
+void bench_usage_archive_year()
+{
+    auto path = TempFilePath(L"claude-usage-archive-bench.archive");
+    DeleteFileW(path.c_str());
+    DeleteFileW((path + L".wal").c_str());
+
+    const int64_t t0 = 1767225600;
+    const int n = 365 * 1440;
+    {
+        UsageArchiveWriter writer;
+        assert(writer.Open(path));
+        for (int i = 0; i < n; ++i) writer.Append("five_hour", ArchiveTestSample(t0, i));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    UsageArchiveReader reader;
+    assert(reader.Load(path));
+    auto loaded = std::chrono::steady_clock::now();
+
+    std::vector<ArchiveRollup> days;
+    assert(reader.QueryRollup("five_hour", t0, t0 + 366 * 86400, kArchiveDay, days));
+    auto daily = std::chrono::steady_clock::now();
+
+    std::vector<ArchiveSample> samples;
+    assert(reader.Query("five_hour", t0, t0 + 366 * 86400, samples));
+    auto raw = std::chrono::steady_clock::now();
+
+    assert(days.size() == 365 && static_cast<int>(samples.size()) == n);
+    auto ms = [](auto a, auto b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+    printf("[BENCH] bench_usage_archive_year: %d samples, %.2f bytes/sample, load %.2f ms, 1d rollup %.2f ms, raw %.2f ms\n",
+        n, static_cast<double>(reader.ArchiveBytes()) / n, ms(start, loaded), ms(loaded, daily), ms(daily, raw));
+
+    DeleteFileW(path.c_str());
+    DeleteFileW((path + L".wal").c_str());
+}
+
+void test_ui_entry_points_allocation_free()
+{
+    auto tracePath = TempFilePath(L"claude-usage-ui-alloc.jsonl");
+    {
+        std::ofstream file(tracePath, std::ios::binary | std::ios::trunc);
+        file << R"({"t":0,"d":0,"m":"GET","h":"api.anthropic.com","p":"/api/oauth/usage","s":200,)"
+             << R"("rb":"{\"five_hour\":{\"utilization\":42.0,\"resets_at\":\"2030-01-01T00:00:00Z\"},)"
+             << R"(\"seven_day\":{\"utilization\":7.5,\"resets_at\":\"2030-01-03T00:00:00Z\"},)"
+             << R"(\"seven_day_opus\":{\"utilization\":3.0,\"resets_at\":null}}"})" << "\n";
+    }
+
+    PluginSettings original = Settings::Instance().Get();
+    auto isolated = original;
+    isolated.credentialsPath = TempFilePath(L"claude-usage-ui-alloc-missing.json");
+    // A preempted tick would schedule a slow-call record.
+    isolated.uiBudgetMs = 0;
+    Settings::Instance().Publish(isolated);
+    assert(EnableHttpReplay(tracePath, 0.0));
+
+    auto& plugin = ClaudeUsagePlugin::Instance();
+    for (int i = 0; i < 250; ++i) {
+        plugin.DataRequired();
+        if (wcsstr(plugin.GetTooltipInfo(), L"Session")) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    assert(wcsstr(plugin.GetTooltipInfo(), L"Session"));
+
+    BenchDC bench;
+    auto tick = [&](int n) {
+        plugin.DataRequired();
+        plugin.GetTooltipInfo();
+        for (int i = 0; auto* item = plugin.GetItem(i); ++i) {
+            item->GetItemValueText();
+            item->DrawItem(bench.dc, 0, 0, 160, 30, (n + i) % 2 == 0);
+        }
+    };
+
+    for (int n = 0; n < 100; ++n) tick(n);
+
+    t_allocationCount = 0;
+    t_countAllocations = true;
+    for (int n = 0; n < 10000; ++n) tick(n);
+    t_countAllocations = false;
+    auto allocations = t_allocationCount;
+
+    plugin.Shutdown();
+    DisableHttpTrace();
+    Settings::Instance().Publish(original);
+    DeleteFileW(tracePath.c_str());
+
+    if (allocations != 0)
+        printf("[FAIL] test_ui_entry_points_allocation_free: %llu allocations\n", allocations);
+    assert(allocations == 0);
+    printf("[PASS] test_ui_entry_points_allocation_free - 0 allocations over 10000 ticks\n");
+}
+
+void test_poll_arena_flat_footprint()
+{
+    {
+        PollArena arena;
+        {
+            PollArenaScope scope(arena);
+            PollString small(100, 'x');
+            PollString large(PollArena::kReservedBytes, 'y');
+            assert(CurrentPollResource() == &arena);
+        }
+        assert(CurrentPollResource() != nullptr);
+        arena.Reset();
+        auto& stats = arena.GetStats();
+        assert(stats.polls == 1 && stats.allocations == 2);
+        assert(stats.heapBytes > 0 && stats.overflowPolls == 1);
+        arena.Reset();
+        assert(arena.GetStats().allocations == 0 && arena.GetStats().heapBytes == 0);
+    }
+
+    const int kPolls = 50;
+    auto tracePath = TempFilePath(L"claude-usage-arena-test.jsonl");
+    {
+        std::ofstream file(tracePath, std::ios::binary | std::ios::trunc);
+        for (int i = 0; i < kPolls + 1; ++i) {
+            file << R"({"t":0,"d":0,"m":"GET","h":"api.anthropic.com","p":"/api/oauth/usage","s":200,)"
+                 << R"("rb":"{\"five_hour\":{\"utilization\":42.0,\"resets_at\":\"2030-01-01T00:00:00Z\"},)"
+                 << R"(\"seven_day\":{\"utilization\":7.5,\"resets_at\":null}}"})" << "\n";
+        }
+    }
+
+    PluginSettings original = Settings::Instance().Get();
+    auto isolated = original;
+    isolated.credentialsPath = TempFilePath(L"claude-usage-arena-missing.json");
+    isolated.minRefreshSpacing = 0;
+    Settings::Instance().Publish(isolated);
+    assert(EnableHttpReplay(tracePath, 0.0));
+
+    auto statePath = TempFilePath(L"claude-usage-arena-state");
+    WorkerThread worker;
+    worker.SetAccount(L"", statePath);
+    worker.Start();
+
+    std::vector<PollArenaStats> perPoll;
+    for (int i = 0; i < kPolls; ++i) {
+        uint64_t generation = worker.RequestRefresh();
+        for (int w = 0; w < 250 && worker.GetSnapshot().completed_generation < generation; ++w)
+            std::this_thread::sleep_for(std::chrono::milliseconds(4));
+        assert(worker.GetSnapshot().completed_generation >= generation);
+        perPoll.push_back(worker.GetArenaStats());
+    }
+
+    worker.Stop();
+    DeleteStateFiles(statePath);
+    DisableHttpTrace();
+    Settings::Instance().Publish(original);
+    DeleteFileW(tracePath.c_str());
+
+    auto& last = perPoll.back();
+    assert(last.polls >= static_cast<uint64_t>(kPolls));
+    assert(last.allocations > 0 && last.overflowPolls == 0);
+    for (size_t i = 1; i < perPoll.size(); ++i) {
+        assert(perPoll[i].bytes == perPoll[1].bytes);
+        assert(perPoll[i].heapBytes == 0);
+    }
+    printf("[PASS] test_poll_arena_flat_footprint - %llu allocs, %llu bytes per poll, peak %llu\n",
+        static_cast<unsigned long long>(last.allocations), static_cast<unsigned long long>(last.bytes),
+        static_cast<unsigned long long>(last.peakBytes));
+}
+
+void test_poll_policy_presence()
+{
+    const uint64_t interval = 60000;
+    PollPolicy policy;
+
+    auto plan = policy.Plan(interval, UINT64_MAX);
+    assert(!plan.suspended && plan.delayMs == 0);
+    plan = policy.Plan(interval, 15000);
+    assert(!plan.suspended && plan.delayMs == 45000);
+    assert(plan.toleranceMs == interval / PollPolicy::kAcToleranceDivisor);
+
+    // Locking stops polling; unlocking asks for an immediate poll.
+    assert(!policy.OnEvent(PresenceEvent::SessionLocked));
+    assert(policy.Plan(interval, UINT64_MAX).suspended);
+    assert(!policy.OnEvent(PresenceEvent::DisplayOff));
+    assert(!policy.OnEvent(PresenceEvent::SessionUnlocked));
+    assert(policy.Plan(interval, UINT64_MAX).suspended);
+    assert(policy.OnEvent(PresenceEvent::DisplayOn));
+    assert(policy.Plan(interval, 0).delayMs == interval);
+
+    // Repeated notifications of the current state are not transitions.
+    assert(!policy.OnEvent(PresenceEvent::DisplayOn));
+    assert(!policy.OnEvent(PresenceEvent::SessionUnlocked));
+
+    // Battery stretches the interval and widens the coalescing window.
+    assert(!policy.OnEvent(PresenceEvent::OnBattery));
+    plan = policy.Plan(interval, 0);
+    assert(plan.delayMs == interval * PollPolicy::kBatteryStretch);
+    assert(plan.toleranceMs == interval * PollPolicy::kBatteryStretch / PollPolicy::kBatteryToleranceDivisor);
+    assert(policy.Plan(interval, interval * PollPolicy::kBatteryStretch).delayMs == 0);
+    plan = policy.Plan(3600000, 0);
+    assert(plan.toleranceMs == PollPolicy::kMaxToleranceMs);
+    policy.OnEvent(PresenceEvent::OnAcPower);
+    assert(policy.Plan(interval, 0).delayMs == interval);
+
+    // Resume clears a display-off that never got its matching display-on.
+    policy.OnEvent(PresenceEvent::DisplayOff);
+    policy.OnEvent(PresenceEvent::Suspending);
+    assert(policy.Plan(interval, UINT64_MAX).suspended);
+    assert(policy.OnEvent(PresenceEvent::Resumed));
+    assert(policy.IsVisible());
+
+    // A worker fed the same events stops rescheduling itself while locked.
+    auto tracePath = TempFilePath(L"claude-usage-presence-test.jsonl");
+    {
+        std::ofstream file(tracePath, std::ios::binary | std::ios::trunc);
+        for (int i = 0; i < 3; ++i) {
+            file << R"({"t":0,"d":0,"m":"GET","h":"api.anthropic.com","p":"/api/oauth/usage","s":200,)"
+                 << R"("rb":"{\"five_hour\":{\"utilization\":1.0,\"resets_at\":null},)"
+                 << R"(\"seven_day\":{\"utilization\":1.0,\"resets_at\":null}}"})" << "\n";
+        }
+    }
+    PluginSettings original = Settings::Instance().Get();
+    auto isolated = original;
+    isolated.credentialsPath = TempFilePath(L"claude-usage-presence-missing.json");
+    isolated.pollInterval = 10;
+    Settings::Instance().Publish(isolated);
+    assert(EnableHttpReplay(tracePath, 0.0));
+
+    auto statePath = TempFilePath(L"claude-usage-presence-state");
+    WorkerThread worker;
+    worker.SetAccount(L"", statePath);
+    worker.Start();
+    for (int i = 0; i < 250 && worker.GetSnapshot().completed_generation < 1; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    assert(worker.GetSnapshot().completed_generation >= 1);
+
+    worker.OnPresenceEvent(PresenceEvent::SessionLocked);
+    auto lockedGeneration = worker.GetSnapshot().completed_generation;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    assert(worker.GetSnapshot().completed_generation == lockedGeneration);
+
+    worker.OnPresenceEvent(PresenceEvent::SessionUnlocked);
+    for (int i = 0; i < 250 && worker.GetSnapshot().completed_generation == lockedGeneration; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    assert(worker.GetSnapshot().completed_generation > lockedGeneration);
+
+    worker.Stop();
+    DeleteStateFiles(statePath);
+    DisableHttpTrace();
+    Settings::Instance().Publish(original);
+    DeleteFileW(tracePath.c_str());
+    printf("[PASS] test_poll_policy_presence\n");
+}
+
+void test_offline_polls_skip_network()
+{
+    PollPolicy policy;
+    assert(!policy.OnEvent(PresenceEvent::NetworkLost));
+    assert(policy.Plan(60000, UINT64_MAX).suspended);
+    assert(!policy.OnEvent(PresenceEvent::SessionLocked));
+    assert(!policy.OnEvent(PresenceEvent::NetworkRestored));
+    assert(policy.OnEvent(PresenceEvent::SessionUnlocked));
+
+    // One exchange only: a poll that reached the network while offline
+    // would consume it and the reconnect poll would then fail.
+    auto tracePath = TempFilePath(L"claude-usage-offline-test.jsonl");
+    {
+        std::ofstream file(tracePath, std::ios::binary | std::ios::trunc);
+        file << R"({"t":0,"d":0,"m":"GET","h":"api.anthropic.com","p":"/api/oauth/usage","s":200,)"
+             << R"("rb":"{\"five_hour\":{\"utilization\":33.0,\"resets_at\":null},)"
+             << R"(\"seven_day\":{\"utilization\":4.0,\"resets_at\":null}}"})" << "\n";
+    }
+    PluginSettings original = Settings::Instance().Get();
+    auto isolated = original;
+    isolated.credentialsPath = TempFilePath(L"claude-usage-offline-missing.json");
+    isolated.minRefreshSpacing = 0;
+    Settings::Instance().Publish(isolated);
+    assert(EnableHttpReplay(tracePath, 0.0));
+
+    auto statePath = TempFilePath(L"claude-usage-offline-state");
+    WorkerThread worker;
+    worker.SetAccount(L"", statePath);
+    worker.OnPresenceEvent(PresenceEvent::NetworkLost);
+    worker.Start();
+
+    // Clicks while offline complete at once without a request.
+    uint64_t generation = worker.RequestRefresh();
+    for (int i = 0; i < 250 && worker.GetSnapshot().completed_generation < generation; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(4));
+    auto snap = worker.GetSnapshot();
+    assert(snap.completed_generation >= generation);
+    assert(snap.offline && !snap.has_error && snap.fetched_at == 0);
+
+    worker.OnPresenceEvent(PresenceEvent::NetworkRestored);
+    for (int i = 0; i < 250 && worker.GetSnapshot().fetched_at == 0; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    snap = worker.GetSnapshot();
+    assert(!snap.offline && !snap.has_error);
+    assert(snap.usage.Find("five_hour")->pct == 33.0);
+
+    worker.Stop();
+    DeleteStateFiles(statePath);
+    DisableHttpTrace();
+    Settings::Instance().Publish(original);
+    DeleteFileW(tracePath.c_str());
+
+    ConnectivityMonitor monitor;
+    if (monitor.Start([](bool) {})) {
+        assert(monitor.IsRunning());
+        monitor.Stop();
+    }
+    assert(!monitor.IsRunning());
+    printf("[PASS] test_offline_polls_skip_network\n");
+}
+
+void test_api_budget_governor()
+{
+    // 60 an hour: a ten-token bucket refilling one token a minute.
+    const uint32_t perHour = 60;
+    assert(ApiBucketCapacity(perHour) == 10.0);
+    ApiBucket bucket = {};
+    uint64_t now = 1000;
+    uint64_t retryMs = 0;
+
+    // Scheduled polls stop with half the bucket left, token refreshes with a
+    // quarter, and clicks may drain it.
+    int scheduled = 0;
+    while (ApiBucketTake(bucket, ApiPriority::Scheduled, perHour, now, retryMs)) ++scheduled;
+    assert(scheduled == 5 && retryMs == 60000);
+    int refreshes = 0;
+    while (ApiBucketTake(bucket, ApiPriority::TokenRefresh, perHour, now, retryMs)) ++refreshes;
+    assert(refreshes == 2);
+    int clicks = 0;
+    while (ApiBucketTake(bucket, ApiPriority::Manual, perHour, now, retryMs)) ++clicks;
+    assert(clicks == 3 && retryMs == 60000);
+    assert(bucket.calls == 10 && bucket.deferred[0] == 1 && bucket.deferred[1] == 1 && bucket.deferred[2] == 1);
+
+    now += 60000;
+    assert(ApiBucketTake(bucket, ApiPriority::Manual, perHour, now, retryMs));
+    assert(!ApiBucketTake(bucket, ApiPriority::Scheduled, perHour, now, retryMs));
+    assert(retryMs == 6 * 60000);
+
+    // Calls made after admission go into debt, bounded by one bucket.
+    for (int i = 0; i < 50; ++i) ApiBucketCharge(bucket, perHour, now);
+    assert(bucket.tokens == -ApiBucketCapacity(perHour));
+    assert(!ApiBucketTake(bucket, ApiPriority::Manual, perHour, now, retryMs));
+    assert(retryMs == 11 * 60000);
+
+    ApiBucket unlimited = {};
+    for (int i = 0; i < 1000; ++i) assert(ApiBucketTake(unlimited, ApiPriority::Scheduled, 0, now, retryMs));
+
+    // Two governors on one name draw from the same bucket, as two plugin
+    // instances would.
+    std::string name = "ClaudeUsageTaskbar.ApiBudgetTest." + std::to_string(GetCurrentProcessId());
+    ApiGovernor first(name.c_str());
+    ApiGovernor second(name.c_str());
+    first.SetBudget(perHour);
+    second.SetBudget(perHour);
+    bool shared = first.GetStats().shared && second.GetStats().shared;
+    if (shared) {
+        for (int i = 0; i < 10; ++i) assert(first.Acquire(ApiPriority::Manual, retryMs));
+        assert(!second.Acquire(ApiPriority::Manual, retryMs));
+        assert(retryMs > 0 && second.GetStats().calls == 10);
+        assert(second.GetStats().deferred[static_cast<int>(ApiPriority::Manual)] == 1);
+    }
+
+    // An admission pays for the first call it covers; later calls are
+    // charged, and an unused admission is refunded.
+    ApiGovernor metered(("ClaudeUsageTaskbar.ApiBudgetTest.Admission." + std::to_string(GetCurrentProcessId())).c_str());
+    metered.SetBudget(perHour);
+    double full = metered.GetStats().tokens;
+    {
+        ApiAdmission admission(ApiPriority::Manual, metered);
+        assert(admission.Granted());
+        ChargeApiCall();
+        assert(std::fabs(metered.GetStats().tokens - (full - 1.0)) < 0.01);
+        ChargeApiCall();
+        assert(std::fabs(metered.GetStats().tokens - (full - 2.0)) < 0.01);
+    }
+    assert(metered.GetStats().calls == 2);
+    {
+        ApiAdmission unused(ApiPriority::Manual, metered);
+        assert(unused.Granted());
+    }
+    assert(std::fabs(metered.GetStats().tokens - (full - 2.0)) < 0.01);
+    assert(metered.GetStats().calls == 2);
+
+    printf("[PASS] test_api_budget_governor%s\n", shared ? "" : " (shared mapping unavailable)");
+}
+
+// Local HTTP stand-in whose per-connection latency is mostly 5-15 ms with an
+// 8% Pareto tail (50 ms minimum, alpha 1.2, capped at 800 ms).
+struct HeavyTailServer {
+    SOCKET listener = INVALID_SOCKET;
+    int port = 0;
+    std::mutex mutex;
+    std::mt19937 rng{42};
+    std::vector<std::thread> handlers;
+    std::thread acceptor;
+
+    void Start()
+    {
+        listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        listen(listener, 64);
+        int addrLen = sizeof(addr);
+        getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &addrLen);
+        port = ntohs(addr.sin_port);
+        acceptor = std::thread([this] {
+            for (;;) {
+                SOCKET client = accept(listener, nullptr, nullptr);
+                if (client == INVALID_SOCKET) return;
+                std::lock_guard<std::mutex> lock(mutex);
+                handlers.emplace_back([this, client, delay = NextLatencyMsLocked()] { Serve(client, delay); });
+            }
+        });
+    }
+
+    int NextLatencyMsLocked()
+    {
+        std::uniform_real_distribution<double> u(0.0, 1.0);
+        if (u(rng) >= 0.08) return 5 + static_cast<int>(u(rng) * 10);
+        double pareto = 50.0 / std::pow(1.0 - u(rng), 1.0 / 1.2);
+        return static_cast<int>(std::min(pareto, 800.0));
+    }
+
+    static void Serve(SOCKET client, int delayMs)
+    {
+        char buf[1024];
+        recv(client, buf, sizeof(buf), 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+        const char* reply = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: close\r\n\r\nok";
+        send(client, reply, static_cast<int>(strlen(reply)), 0);
+        closesocket(client);
+    }
+
+    void Stop()
+    {
+        closesocket(listener);
+        acceptor.join();
+        for (auto& t : handlers) t.join();
+    }
+};
+
+static int StubGet(int port, HedgeCancel& cancel)
+{
+    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    // Shutting the socket down unblocks recv; this side still closes it.
+    if (!cancel.Arm([s] { shutdown(s, SD_BOTH); })) {
+        closesocket(s);
+        return 0;
+    }
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<u_short>(port));
+    int status = 0;
+    if (connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+        const char* request = "GET / HTTP/1.1\r\nHost: stub\r\n\r\n";
+        send(s, request, static_cast<int>(strlen(request)), 0);
+        char buf[256];
+        int n = recv(s, buf, sizeof(buf) - 1, 0);
+        if (n > 12 && strncmp(buf, "HTTP/1.1 200", 12) == 0) status = 200;
+    }
+    cancel.Disarm();
+    closesocket(s);
+    return status;
+}
+
+void bench_hedged_requests()
+{
+    WSADATA wsa;
+    assert(WSAStartup(MAKEWORD(2, 2), &wsa) == 0);
+    HeavyTailServer server;
+    server.Start();
+
+    const int kRequests = 200;
+    const double kBudget = 0.10;
+    auto run = [&](HedgePolicy& policy, double percentiles[3]) {
+        std::vector<double> latencies;
+        for (int i = 0; i < kRequests; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            int status = RunHedged<int>(policy, [&](HedgeCancel& cancel) { return StubGet(server.port, cancel); },
+                [](const int& status) { return status != 0; });
+            assert(status == 200);
+            latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(latencies.begin(), latencies.end());
+        const double ranks[3] = {0.50, 0.95, 0.99};
+        for (int i = 0; i < 3; ++i) percentiles[i] = latencies[static_cast<size_t>(ranks[i] * (kRequests - 1))];
+    };
+
+    HedgePolicy baseline(0.0);
+    HedgePolicy hedged(kBudget);
+    double plain[3], hedgedP[3];
+    run(baseline, plain);
+    run(hedged, hedgedP);
+    auto stats = hedged.GetStats();
+
+    server.Stop();
+    WSACleanup();
+
+    assert(baseline.GetStats().hedges == 0);
+    assert(stats.hedges <= static_cast<uint64_t>(kRequests * kBudget) + 1);
+    printf("[BENCH] hedged requests (%d, budget %.0f%%): p50 %.1f -> %.1f ms, p95 %.1f -> %.1f ms, "
+        "p99 %.1f -> %.1f ms; %llu hedges, %llu won\n",
+        kRequests, kBudget * 100, plain[0], hedgedP[0], plain[1], hedgedP[1], plain[2], hedgedP[2],
+        static_cast<unsigned long long>(stats.hedges), static_cast<unsigned long long>(stats.hedgeWins));
+}
+
+// A listener on the HTTPS port that accepts and never answers, so the TLS
+// handshake blocks until the request is cancelled.
+void test_https_cancel_mid_request()
+{
+    WSADATA wsa;
+    assert(WSAStartup(MAKEWORD(2, 2), &wsa) == 0);
+    SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(443);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listener, 4) != 0) {
+        closesocket(listener);
+        WSACleanup();
+        printf("[SKIP] test_https_cancel_mid_request: port 443 is in use\n");
+        return;
+    }
+    std::atomic<bool> accepted{false};
+    std::vector<SOCKET> clients;
+    std::thread acceptor([&] {
+        for (;;) {
+            SOCKET client = accept(listener, nullptr, nullptr);
+            if (client == INVALID_SOCKET) return;
+            clients.push_back(client);
+            accepted = true;
+        }
+    });
+
+    HedgeCancel cancel;
+    HttpResponse resp;
+    std::thread request([&] {
+        resp = SendHttpsRequest(L"127.0.0.1", L"/", L"GET", nullptr, {}, false, kHttpTimeoutMs, &cancel);
+    });
+    for (int i = 0; i < 250 && !accepted; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    assert(accepted);
+
+    auto cancelled = std::chrono::steady_clock::now();
+    cancel.Cancel();
+    request.join();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - cancelled).count();
+    assert(ms < kHttpTimeoutMs / 2);
+    assert(!resp.success && resp.statusCode == 0 && resp.error == "Request cancelled");
+
+    // One cancelled before it starts never reaches the network.
+    HedgeCancel late;
+    late.Cancel();
+    resp = SendHttpsRequest(L"127.0.0.1", L"/", L"GET", nullptr, {}, false, kHttpTimeoutMs, &late);
+    assert(resp.error == "Request cancelled");
+
+    closesocket(listener);
+    acceptor.join();
+    for (SOCKET client : clients) closesocket(client);
+    WSACleanup();
+    printf("[PASS] test_https_cancel_mid_request (%lld ms to stop)\n", static_cast<long long>(ms));
+}
+
+static std::string TranscriptLine(const char* id, const char* model, int64_t timeMs, int input, int output,
+    int cacheRead)
+{
+    time_t t = static_cast<time_t>(timeMs / 1000);
+    std::tm tm = {};
+    gmtime_s(&tm, &t);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &tm);
+    char line[768];
+    snprintf(line, sizeof(line),
+        "{\"parentUuid\":\"p\",\"cwd\":\"/src/app\",\"sessionId\":\"s\",\"message\":{\"id\":\"%s\",\"type\":\"message\","
+        "\"role\":\"assistant\",\"model\":\"%s\",\"content\":[{\"type\":\"text\",\"text\":\"see \\\"usage\\\":{} }\"}],"
+        "\"usage\":{\"input_tokens\":%d,\"cache_creation_input_tokens\":0,\"cache_read_input_tokens\":%d,"
+        "\"cache_creation\":{\"ephemeral_5m_input_tokens\":9},\"output_tokens\":%d}},\"requestId\":\"req_%s\","
+        "\"type\":\"assistant\",\"uuid\":\"u\",\"timestamp\":\"%s.%03dZ\"}\n",
+        id, model, input, cacheRead, output, id, stamp, static_cast<int>(timeMs % 1000));
+    return line;
+}
+
+static void AppendText(const std::wstring& path, const std::string& text)
+{
+    std::ofstream file(NativePath(path), std::ios::binary | std::ios::app);
+    file << text;
+}
+
+void test_transcript_scanner()
+{
+    const int64_t now = 1790000000000;
+    TranscriptUsageLine parsed;
+    assert(ParseTranscriptLine(TranscriptLine("msg_1", "claude-opus-4", now, 10, 20, 30), parsed));
+    assert(parsed.tokens.input == 10 && parsed.tokens.output == 20 && parsed.tokens.cacheRead == 30);
+    assert(parsed.tokens.cacheCreation == 0 && parsed.model == "claude-opus-4" && parsed.timeMs == now);
+    // A subagent's usage echoed in a tool result is not an assistant line.
+    assert(!ParseTranscriptLine("{\"type\":\"user\",\"toolUseResult\":{\"usage\":{\"input_tokens\":5}}}", parsed));
+    assert(!ParseTranscriptLine("{\"type\":\"summary\",\"summary\":\"x\"}", parsed));
+
+    auto root = TempFilePath(L"claude-usage-transcripts");
+    auto projectA = root + kPathSeparator + L"-src-app";
+    auto projectB = root + kPathSeparator + L"-src-lib";
+    auto fileA = projectA + kPathSeparator + L"a.jsonl";
+    auto fileB = projectB + kPathSeparator + L"b.jsonl";
+    auto index = TempFilePath(L"claude-usage-transcripts.idx");
+    bool exists;
+    for (auto& dir : {root, projectA, projectB}) MakeDirectory(dir, exists);
+    for (auto& file : {fileA, fileB, index}) RemoveFile(file);
+
+    // The same message streamed twice keeps its larger counts; an entry
+    // older than the retention window is dropped; the partial line waits.
+    AppendText(fileA, TranscriptLine("msg_a1", "claude-opus-4", now - 1000, 100, 5, 0)
+        + TranscriptLine("msg_a1", "claude-opus-4", now - 900, 100, 50, 0)
+        + TranscriptLine("msg_old", "claude-opus-4", now - kTranscriptRetentionMs - 1, 7, 7, 7)
+        + "{\"type\":\"user\",\"message\":{\"role\":\"user\",\"content\":\"hi\"}}\n");
+    auto tail = TranscriptLine("msg_a2", "claude-sonnet-4", now - 500, 1, 2, 300);
+    AppendText(fileA, tail.substr(0, 40));
+    AppendText(fileB, TranscriptLine("msg_b1", "claude-sonnet-4", now - 100, 3, 4, 5));
+
+    TranscriptScanner scanner(root);
+    std::vector<TranscriptEntry> added;
+    auto stats = scanner.Scan(now, 2, &added);
+    assert(stats.files == 2 && stats.filesRead == 2 && stats.entries == 2 && stats.duplicates == 1);
+    auto sum = scanner.Sum(now - 3600000, now + 1);
+    assert(sum.input == 103 && sum.output == 54 && sum.cacheRead == 5);
+    // The repeated message contributes only its growth.
+    TokenCounts addedSum;
+    for (auto& e : added) addedSum += e.tokens;
+    assert(added.size() == 3 && addedSum.Total() == sum.Total());
+
+    // Only the appended bytes are read on the next pass.
+    AppendText(fileA, tail.substr(40));
+    stats = scanner.Scan(now, 2);
+    assert(stats.filesRead == 1 && stats.bytesRead == tail.size() && stats.lines == 1 && stats.entries == 1);
+    sum = scanner.Sum(now - 3600000, now + 1);
+    assert(sum.Total() == 103 + 54 + 5 + 303);
+
+    std::map<std::string, uint64_t> byModel;
+    for (auto& e : scanner.Entries()) byModel[scanner.ModelName(e.model)] += e.tokens.Total();
+    assert(byModel["claude-opus-4"] == 150 && byModel["claude-sonnet-4"] == 315);
+    assert(scanner.ProjectName(scanner.Entries().back().project) == "-src-app");
+
+    // A restart picks up from the index without reading anything.
+    assert(scanner.SaveIndex(index));
+    TranscriptScanner reloaded(root);
+    assert(reloaded.LoadIndex(index));
+    stats = reloaded.Scan(now, 2);
+    assert(stats.filesRead == 0 && reloaded.Sum(now - 3600000, now + 1).Total() == sum.Total());
+
+    // Everything ages out of the window.
+    reloaded.Scan(now + kTranscriptRetentionMs, 2);
+    assert(reloaded.Entries().empty());
+
+    for (auto& file : {fileA, fileB, index}) RemoveFile(file);
+    for (auto& dir : {projectA, projectB, root}) RemoveEmptyDirectory(dir);
+    printf("[PASS] test_transcript_scanner\n");
+}
+
+void bench_transcript_scan()
+{
+    const int64_t now = 1790000000000;
+    const int kProjects = 8, kFiles = 200, kPairs = 150;
+    auto root = TempFilePath(L"claude-usage-transcript-bench");
+    bool exists;
+    MakeDirectory(root, exists);
+
+    // Each exchange is a user line with ~1.5 KB of tool output and an
+    // assistant line of ~600 bytes, roughly what a coding session writes.
+    std::string filler(1500, 'x');
+    std::vector<std::wstring> files;
+    uint64_t totalBytes = 0;
+    for (int f = 0; f < kFiles; ++f) {
+        auto dir = root + kPathSeparator + L"-proj-" + std::to_wstring(f % kProjects);
+        MakeDirectory(dir, exists);
+        files.push_back(dir + kPathSeparator + L"session-" + std::to_wstring(f) + L".jsonl");
+        RemoveFile(files.back());
+        std::string text;
+        for (int i = 0; i < kPairs; ++i) {
+            text += "{\"type\":\"user\",\"message\":{\"role\":\"user\",\"content\":[{\"type\":\"tool_result\",\"content\":\""
+                + filler + "\"}]}}\n";
+            auto id = "msg_" + std::to_string(f) + "_" + std::to_string(i);
+            text += TranscriptLine(id.c_str(), i % 3 ? "claude-sonnet-4" : "claude-opus-4",
+                now - (kPairs - i) * 60000, 10, 200, 5000);
+        }
+        totalBytes += text.size();
+        AppendText(files.back(), text);
+    }
+
+    auto mbps = [totalBytes](uint64_t us) { return us ? totalBytes / static_cast<double>(us) : 0.0; };
+    TranscriptScanner single(root);
+    auto one = single.Scan(now, 1);
+    TranscriptScanner parallel(root);
+    auto all = parallel.Scan(now);
+    assert(one.entries == static_cast<uint64_t>(kFiles) * kPairs && all.entries == one.entries);
+    assert(single.Sum(0, now).Total() == parallel.Sum(0, now).Total());
+
+    auto warm = parallel.Scan(now);
+    assert(warm.filesRead == 0);
+    AppendText(files[0], TranscriptLine("msg_tail", "claude-opus-4", now, 1, 1, 1));
+    auto append = parallel.Scan(now);
+    assert(append.filesRead == 1 && append.entries == 1);
+
+    printf("[BENCH] bench_transcript_scan: %.1f MB in %d files, 1 thread %.0f MB/s, %u threads %.0f MB/s, "
+           "unchanged rescan %.2f ms, one append %.2f ms\n",
+        totalBytes / 1e6, kFiles, mbps(one.elapsedUs), all.threads, mbps(all.elapsedUs),
+        warm.elapsedUs / 1000.0, append.elapsedUs / 1000.0);
+
+    for (int f = 0; f < kFiles; ++f) RemoveFile(files[f]);
+    for (int p = 0; p < kProjects; ++p) RemoveEmptyDirectory(root + kPathSeparator + L"-proj-" + std::to_wstring(p));
+    RemoveEmptyDirectory(root);
+}
+
+void test_session_meter()
+{
+    const int64_t now = static_cast<int64_t>(time(nullptr)) * 1000;
+    auto root = TempFilePath(L"claude-usage-session");
+    auto projectA = root + kPathSeparator + L"-src-app";
+    auto projectB = root + kPathSeparator + L"-src-lib";
+    auto fileA = projectA + kPathSeparator + L"a.jsonl";
+    auto fileB = projectB + kPathSeparator + L"b.jsonl";
+    bool exists;
+    for (auto& dir : {root, projectA}) MakeDirectory(dir, exists);
+    for (auto& file : {fileA, fileB}) RemoveFile(file);
+    AppendText(fileA, TranscriptLine("msg_1", "claude-opus-4", now - 2000, 10, 1, 100));
+
+    SessionMeter meter;
+    SessionUsage usage;
+    auto waitFor = [&](uint64_t updates) {
+        for (int i = 0; i < 100; ++i) {
+            meter.CopyUsage(usage);
+            if (usage.updates >= updates) return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        assert(!"session meter did not update");
+    };
+    meter.Start(root);
+    waitFor(1);
+    assert(usage.messages == 1 && usage.tokens.Total() == 111 && usage.lastActivityMs == now - 2000);
+
+    // The streamed message grows in place; only the appended line is read.
+    auto more = TranscriptLine("msg_1", "claude-opus-4", now - 1500, 10, 40, 100)
+        + TranscriptLine("msg_2", "claude-opus-4", now - 1000, 5, 5, 0);
+    AppendText(fileA, more);
+    waitFor(2);
+    assert(usage.lastReadBytes == more.size());
+    assert(usage.messages == 2 && usage.tokens.input == 15 && usage.tokens.output == 45 && usage.tokens.cacheRead == 100);
+
+    // A session in a new project takes over, and going back reads only the new bytes.
+    MakeDirectory(projectB, exists);
+    AppendText(fileB, TranscriptLine("msg_b", "claude-sonnet-4", now - 500, 1, 2, 3));
+    for (int i = 0; i < 100 && usage.tokens.Total() != 6; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        meter.CopyUsage(usage);
+    }
+    assert(usage.messages == 1 && usage.tokens.Total() == 6);
+
+    auto last = TranscriptLine("msg_3", "claude-opus-4", now, 1, 1, 1);
+    AppendText(fileA, last);
+    for (int i = 0; i < 100 && usage.messages != 3; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        meter.CopyUsage(usage);
+    }
+    assert(usage.messages == 3 && usage.lastReadBytes == last.size() && usage.lastActivityMs == now);
+
+    meter.Stop();
+    for (auto& file : {fileA, fileB}) RemoveFile(file);
+    for (auto& dir : {projectA, projectB, root}) RemoveEmptyDirectory(dir);
+    printf("[PASS] test_session_meter\n");
+}
+
+void test_usage_estimator()
+{
+    // One 5h window in which the API charges kRatio points per weighted
+    // token, reports whole percents and is polled every five minutes.
+    const double kRatio = 0.00002;
+    const int64_t start = 1790000000;
+    const int64_t resetsAt = start + kFiveHourWindowSec;
+    std::vector<TranscriptEntry> entries;
+    for (int64_t t = 0; t < 4 * 3600; t += 15) {
+        TranscriptEntry e;
+        e.timeMs = (start + t) * 1000;
+        // Busy and quiet quarter-hours alternate.
+        bool busy = (t / 900) % 2 == 0;
+        e.tokens.input = busy ? 200 : 20;
+        e.tokens.output = busy ? 100 * (1 + t % 5) : 10;
+        e.tokens.cacheRead = busy ? 20000 : 2000;
+        entries.push_back(e);
+    }
+    TokenTimeline timeline;
+    timeline.Build(entries);
+    assert(timeline.Between(start * 1000, (start + 15) * 1000) == QuotaWeight(entries[0].tokens));
+
+    auto truth = [&](int64_t t) { return kRatio * timeline.Between(start * 1000, t * 1000); };
+    std::vector<ArchiveSample> polls;
+    for (int64_t t = start + 300; t <= start + 4 * 3600; t += 300)
+        polls.push_back({t, std::floor(truth(t)), resetsAt});
+
+    UsageEstimator estimator;
+    auto error = estimator.Replay(polls, timeline);
+    assert(error.polls > 30 && error.meanAbs < error.heldMeanAbs / 2);
+    assert(std::fabs(estimator.Ratio() - kRatio) < kRatio * 0.15);
+
+    // Halfway to the next poll the estimate tracks the real value; with
+    // nothing logged since the poll there is nothing to add.
+    int64_t last = polls.back().t;
+    double pct = 0.0, windowTokens = timeline.Between(start * 1000, last * 1000);
+    assert(!estimator.Estimate(windowTokens, last + 1, pct));
+    int64_t mid = last - 150;
+    estimator = UsageEstimator();
+    std::vector<ArchiveSample> earlier(polls.begin(), polls.end() - 1);
+    estimator.Replay(earlier, timeline);
+    assert(estimator.Estimate(timeline.Between(start * 1000, mid * 1000), mid, pct));
+    assert(std::fabs(pct - truth(mid)) < 1.5);
+    assert(!estimator.Estimate(windowTokens * 2, resetsAt, pct));
+
+    // A new window keeps the learned ratio.
+    double ratio = estimator.Ratio();
+    estimator.OnPoll(1.0, resetsAt + kFiveHourWindowSec, 0.0);
+    assert(estimator.Estimate(50000.0, resetsAt + 60, pct) && std::fabs(pct - (1.0 + 50000.0 * ratio)) < 1e-9);
+
+    printf("[PASS] test_usage_estimator (mean error %.2f%% vs %.2f%% held, ratio %.1f/Mtok)\n",
+        error.meanAbs, error.heldMeanAbs, estimator.Ratio() * 1e6);
+}
+
+void test_usage_attribution()
+{
+    assert(ProjectLabel("-home-me-src-app", L"/home/me") == "src-app");
+    assert(ProjectLabel("C--Users-Me-src-app", L"C:\\Users\\Me") == "src-app");
+    assert(ProjectLabel("-home-me", L"/home/me") == "~");
+    assert(ProjectLabel("-home-meg-app", L"/home/me") == "-home-meg-app");
+    assert(ModelLabel("claude-opus-4-1-20250805") == "opus-4-1");
+    assert(ModelLabel("claude-sonnet-4-5") == "sonnet-4-5");
+    assert(ModelLabel("<synthetic>") == "<synthetic>");
+
+    // Ten projects times four models outgrows the initial table. Lines come
+    // in mostly in order, some a few minutes late, and the window is checked
+    // against a brute-force sum as it slides.
+    const int64_t kBucketMs = 5 * 60 * 1000;
+    const uint32_t kBuckets = 60;
+    const int64_t start = 1790000000000;
+    std::mt19937 rng(48);
+    std::vector<TranscriptEntry> log;
+    for (int i = 0; i < 20000; ++i) {
+        TranscriptEntry e;
+        e.timeMs = start + i * 2000 - static_cast<int64_t>(rng() % 4) * 60000;
+        e.project = rng() % 10;
+        e.model = rng() % 4;
+        e.tokens.input = rng() % 500;
+        e.tokens.output = rng() % 200;
+        e.tokens.cacheRead = rng() % 20000;
+        log.push_back(e);
+    }
+
+    UsageAttribution window(kBucketMs, kBuckets);
+    size_t next = 0;
+    for (int64_t now = start; now <= start + 20000 * 2000; now += 10 * 60 * 1000) {
+        window.Advance(now);
+        for (; next < log.size() && log[next].timeMs + 4 * 60000 <= now; ++next) window.Add(log[next]);
+
+        int64_t oldest = now / kBucketMs - (kBuckets - 1);
+        std::map<uint64_t, uint64_t> expected;
+        uint64_t total = 0;
+        for (size_t i = 0; i < next; ++i) {
+            if (log[i].timeMs / kBucketMs < oldest) continue;
+            uint64_t w = AttributionWeight(log[i].tokens);
+            expected[static_cast<uint64_t>(log[i].project) << 32 | log[i].model] += w;
+            total += w;
+        }
+        assert(window.Total() == total);
+
+        AttributionRow top[5];
+        size_t count = window.Top(top, 5);
+        std::vector<uint64_t> weights;
+        for (auto& [key, w] : expected) if (w) weights.push_back(w);
+        std::sort(weights.rbegin(), weights.rend());
+        assert(count == (std::min)(weights.size(), size_t(5)));
+        for (size_t i = 0; i < count; ++i) {
+            assert(top[i].weight == weights[i]);
+            assert(expected[static_cast<uint64_t>(top[i].project) << 32 | top[i].model] == top[i].weight);
+        }
+    }
+    assert(window.Keys() == 40);
+
+    // Everything slides out once the window has moved past the last line.
+    window.Advance(start + 20000 * 2000 + kBucketMs * kBuckets + 5 * 60000);
+    assert(window.Total() == 0 && window.Top(nullptr, 0) == 0);
+    printf("[PASS] test_usage_attribution\n");
+}
+
+void test_ui_watchdog()
+{
+    LatencyHistogram histogram;
+    assert(histogram.Percentile(50) == 0);
+    for (uint64_t us : {0, 1, 2, 3, 900, 1000, 1023, 1024, 5000000}) histogram.Add(us);
+    assert(histogram.counts[0] == 2 && histogram.counts[1] == 2 && histogram.counts[9] == 3);
+    assert(histogram.counts[10] == 1 && histogram.counts[LatencyHistogram::kBuckets - 1] == 1);
+    assert(histogram.count == 9 && histogram.maxUs == 5000000);
+    assert(histogram.Percentile(40) == 3 && histogram.Percentile(75) == 1023);
+    assert(histogram.Percentile(80) == 2047 && histogram.Percentile(100) == 5000000);
+
+    auto log = TempFilePath(L"claude-usage-slow.jsonl");
+    RemoveFile(log);
+    auto& watchdog = UiWatchdog::Instance();
+    watchdog.Start(log, 5);
+    watchdog.Reset();
+
+    // Under budget only feeds the histogram.
+    watchdog.Record(UiEntry::DrawItem, 4000, nullptr, 0);
+    {
+        UiTimer timer(UiEntry::DrawItem);
+        SleepMs(2);
+    }
+
+    // The first slow call is written with its phases; the rest of the
+    // minute only counts.
+    uint64_t phases[static_cast<int>(UiPhase::Count)] = {};
+    phases[static_cast<int>(UiPhase::Snapshot)] = 11500;
+    phases[static_cast<int>(UiPhase::Tooltip)] = 300;
+    watchdog.Record(UiEntry::DataRequired, 12000, phases, kUiNoteLockWait);
+    watchdog.Record(UiEntry::DataRequired, 9000, phases, 0);
+    watchdog.Record(UiEntry::GetTooltipInfo, 6000, nullptr, 0);
+
+    UiWatchdogStats stats;
+    for (int i = 0; i < 100; ++i) {
+        watchdog.CopyStats(stats);
+        if (stats.records) break;
+        SleepMs(10);
+    }
+    assert(stats.records == 1 && stats.overBudget == 3 && stats.budgetMs == 5);
+    auto& drawn = stats.entries[static_cast<int>(UiEntry::DrawItem)];
+    assert(drawn.count == 2 && drawn.maxUs >= 2000);
+    assert(stats.entries[static_cast<int>(UiEntry::DataRequired)].count == 2);
+
+    watchdog.Stop();
+    std::ifstream file(NativePath(log));
+    std::string line;
+    assert(std::getline(file, line));
+    auto record = nlohmann::json::parse(line);
+    assert(record["entry"] == "DataRequired" && record["ms"] == 12.0 && record["budget_ms"] == 5);
+    assert(record["phases"]["snapshot"] == 11.5 && record["phases"]["tooltip"] == 0.3);
+    assert(!record["phases"].contains("render") && record["notes"][0] == "lock_wait");
+    assert(!std::getline(file, line));
+    file.close();
+
+    watchdog.Reset();
+    watchdog.CopyStats(stats);
+    assert(stats.overBudget == 0 && stats.entries[static_cast<int>(UiEntry::DrawItem)].count == 0);
+    RemoveFile(log);
+    printf("[PASS] test_ui_watchdog\n");
+}
+
+void test_plugin_commands()
+{
+    auto& plugin = ClaudeUsagePlugin::Instance();
+    assert(plugin.GetCommandCount() == ClaudeUsagePlugin::kCommandCount);
+    assert(wcscmp(plugin.GetCommandName(ClaudeUsagePlugin::kCommandPollNow), L"Poll now (bypass cache)") == 0);
+    assert(wcscmp(plugin.GetCommandName(ClaudeUsagePlugin::kCommandDumpTrace), L"Dump trace to file") == 0);
+    assert(plugin.GetCommandName(ClaudeUsagePlugin::kCommandCount) == nullptr);
+
+    // Pausing is the one checkable entry.
+    assert(!plugin.IsCommandChecked(ClaudeUsagePlugin::kCommandPausePolling));
+    plugin.OnPluginCommand(ClaudeUsagePlugin::kCommandPausePolling, nullptr, nullptr);
+    assert(plugin.IsCommandChecked(ClaudeUsagePlugin::kCommandPausePolling));
+    assert(!plugin.IsCommandChecked(ClaudeUsagePlugin::kCommandShowStats));
+    plugin.OnPluginCommand(ClaudeUsagePlugin::kCommandPausePolling, nullptr, nullptr);
+    assert(!plugin.IsCommandChecked(ClaudeUsagePlugin::kCommandPausePolling));
+
+    plugin.OnPluginCommand(ClaudeUsagePlugin::kCommandResetStats, nullptr, nullptr);
+    auto stats = plugin.FormatPerformanceStats();
+    assert(stats.find(L"Polls: 0") == 0 && stats.find(L"GetTooltipInfo") == std::wstring::npos);
+    for (int i = 0; i < 3; ++i) plugin.GetTooltipInfo();
+    stats = plugin.FormatPerformanceStats();
+    assert(stats.find(L"GetTooltipInfo:") != std::wstring::npos && stats.find(L"over 3 calls") != std::wstring::npos);
+
+    auto path = TempFilePath(L"claude-usage-diagnostics.json");
+    assert(plugin.DumpDiagnostics(path));
+    std::ifstream file(path);
+    auto dump = nlohmann::json::parse(file);
+    file.close();
+    assert(dump["paused"] == false && dump["polls"]["count"] == 0);
+    assert(dump["ui"]["entries"]["GetTooltipInfo"]["count"] == 3);
+    assert(dump["ui"]["entries"]["DrawItem"]["buckets"].size() == LatencyHistogram::kBuckets);
+    assert(dump.contains("hedge") && dump.contains("proxy") && dump.contains("render") && dump.contains("first_data_ms"));
+    DeleteFileW(path.c_str());
+    printf("[PASS] test_plugin_commands\n");
+}
@@ -0,0 +1,147 @@
+// Exports a range of the usage archive as CSV.
+//
+//   claude-usage-archive <archive> [--key five_hour] [--from 2026-01-01] [--to 2026-02-01]
+//                        [--resolution raw|1h|1d]
+//   claude-usage-archive <archive> --estimate <transcripts> [--from TIME] [--to TIME]
+//
+// Times are unix seconds or UTC dates (YYYY-MM-DD[THH:MM:SS]). Without --key
+// every series is exported. --estimate replays the five_hour polls against
+// the token counts in a Claude Code projects directory and reports how far
+// the between-poll estimate was from each next poll.
+
+#include "../src/UsageArchive.h"
+#include "../src/UsageEstimator.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cwchar>
+#include <ctime>
+#include <string>
+#include <vector>
+
+static bool ParseTime(const wchar_t* text, int64_t& out)
+{
+    int y, mo, d, h = 0, mi = 0, s = 0;
+    if (swscanf_s(text, L"%d-%d-%dT%d:%d:%d", &y, &mo, &d, &h, &mi, &s) >= 3) {
+        std::tm tm = {};
+        tm.tm_year = y - 1900;
+        tm.tm_mon = mo - 1;
+        tm.tm_mday = d;
+        tm.tm_hour = h;
+        tm.tm_min = mi;
+        tm.tm_sec = s;
+        out = static_cast<int64_t>(_mkgmtime(&tm));
+        return out >= 0;
+    }
+
+    wchar_t* end = nullptr;
+    out = wcstoll(text, &end, 10);
+    return end && *end == L'\0' && end != text;
+}
+
+static void FormatUtc(int64_t t, char* buf, size_t size)
+{
+    std::tm tm = {};
+    time_t tt = static_cast<time_t>(t);
+    if (t <= 0 || gmtime_s(&tm, &tt) != 0) {
+        buf[0] = '\0';
+        return;
+    }
+    strftime(buf, size, "%Y-%m-%dT%H:%M:%SZ", &tm);
+}
+
+static int Usage()
+{
+    fwprintf(stderr, L"usage: claude-usage-archive <archive> [--key KEY] [--from TIME] [--to TIME]"
+                     L" [--resolution raw|1h|1d]\n"
+                     L"       claude-usage-archive <archive> --estimate DIR [--from TIME] [--to TIME]\n");
+    return 2;
+}
+
+int wmain(int argc, wchar_t** argv)
+{
+    if (argc < 2) return Usage();
+
+    std::wstring path = argv[1];
+    std::string key;
+    int64_t from = 0;
+    int64_t to = INT64_MAX;
+    int64_t resolution = 0;
+    std::wstring transcripts;
+
+    for (int i = 2; i < argc; ++i) {
+        std::wstring arg = argv[i];
+        if (i + 1 >= argc) return Usage();
+        const wchar_t* value = argv[++i];
+        if (arg == L"--key") {
+            for (const wchar_t* c = value; *c; ++c) key.push_back(static_cast<char>(*c));
+        } else if (arg == L"--from") {
+            if (!ParseTime(value, from)) return Usage();
+        } else if (arg == L"--to") {
+            if (!ParseTime(value, to)) return Usage();
+        } else if (arg == L"--resolution") {
+            std::wstring r = value;
+            if (r == L"raw") resolution = 0;
+            else if (r == L"1h") resolution = kArchiveHour;
+            else if (r == L"1d") resolution = kArchiveDay;
+            else return Usage();
+        } else if (arg == L"--estimate") {
+            transcripts = value;
+        } else {
+            return Usage();
+        }
+    }
+
+    UsageArchiveReader reader;
+    if (!reader.Load(path)) {
+        fwprintf(stderr, L"cannot read archive: %s\n", path.c_str());
+        return 1;
+    }
+
+    if (!transcripts.empty()) {
+        // Transcripts older than the scanner's retention are not counted.
+        TranscriptScanner scanner(transcripts);
+        scanner.Scan(static_cast<int64_t>(time(nullptr)) * 1000);
+        TokenTimeline timeline;
+        timeline.Build(scanner.Entries());
+        std::vector<ArchiveSample> polls;
+        reader.Query("five_hour", from, to, polls);
+        UsageEstimator estimator;
+        auto error = estimator.Replay(polls, timeline);
+        printf("polls,mean_abs_pct,max_abs_pct,held_mean_abs_pct,ratio_pct_per_mtok\n");
+        printf("%u,%.3f,%.3f,%.3f,%.3f\n", error.polls, error.meanAbs, error.maxAbs, error.heldMeanAbs,
+            estimator.Ratio() * 1e6);
+        return 0;
+    }
+
+    std::vector<std::string> keys;
+    if (key.empty()) keys = reader.Keys();
+    else keys.push_back(key);
+
+    char when[32];
+    char resets[32];
+    if (resolution == 0) {
+        printf("key,time_utc,unix,pct,resets_at_utc\n");
+        std::vector<ArchiveSample> samples;
+        for (auto& k : keys) {
+            if (!reader.Query(k, from, to, samples)) continue;
+            for (auto& s : samples) {
+                FormatUtc(s.t, when, sizeof(when));
+                FormatUtc(s.resetsAt, resets, sizeof(resets));
+                printf("%s,%s,%lld,%.2f,%s\n", k.c_str(), when, static_cast<long long>(s.t), s.pct, resets);
+            }
+        }
+    } else {
+        printf("key,bucket_utc,unix,count,min,max,mean\n");
+        std::vector<ArchiveRollup> rollups;
+        for (auto& k : keys) {
+            if (!reader.QueryRollup(k, from, to, resolution, rollups)) continue;
+            for (auto& r : rollups) {
+                FormatUtc(r.bucketStart, when, sizeof(when));
+                printf("%s,%s,%lld,%u,%.2f,%.2f,%.3f\n", k.c_str(), when,
+                    static_cast<long long>(r.bucketStart), r.count, r.min, r.max, r.mean);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,323 @@
+// Headless poller for Linux and other POSIX systems. Polls one or more
+// credentials files and writes one compact JSON line per completed poll.
+//
+//   claude-usage-daemon [--credentials [NAME=]PATH]... [--interval SEC] [--socket PATH]
+//                       [--config STEM] [--state DIR] [--replay TRACE] [--once]
+//
+// Lines go to stdout, or to every client of the Unix socket; a client that
+// connects is first sent the latest line for each account. Settings come from
+// STEM.ini (default $XDG_CONFIG_HOME/claude-usage-taskbar/daemon.ini).
+// Between polls the process sleeps in poll(2) and the scheduler's timer wait.
+
+#include "../src/ApiClient.h"
+#include "../src/Platform.h"
+#include "../src/Settings.h"
+#include "../src/SnapshotStore.h"
+#include "../src/WorkerThread.h"
+
+#include <nlohmann/json.hpp>
+
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+using json = nlohmann::json;
+
+struct Account {
+    std::string name;
+    WorkerThread worker;
+    uint64_t emittedGeneration = 0;
+    std::string lastLine;
+};
+
+static int g_signalPipe[2] = {-1, -1};
+
+static void OnSignal(int)
+{
+    int saved = errno;
+    char c = 1;
+    (void)!write(g_signalPipe[1], &c, 1);
+    errno = saved;
+}
+
+static int Usage()
+{
+    fprintf(stderr, "usage: claude-usage-daemon [--credentials [NAME=]PATH]... [--interval SEC] [--socket PATH]\n"
+                    "                           [--config STEM] [--state DIR] [--replay TRACE] [--once]\n");
+    return 2;
+}
+
+static std::wstring EnvDirectory(const char* name, const wchar_t* fallback)
+{
+    const char* value = getenv(name);
+    if (value && *value == '/') return Utf8ToWide(value);
+    return HomeDirectory() + fallback;
+}
+
+static bool MakeDirectories(const std::wstring& path)
+{
+    for (size_t slash = path.find(L'/', 1);; slash = path.find(L'/', slash + 1)) {
+        bool exists = false;
+        auto part = path.substr(0, slash);
+        if (!MakeDirectory(part, exists) && !exists) return false;
+        if (slash == std::wstring::npos) return true;
+    }
+}
+
+static std::wstring StateStem(const std::wstring& dir, const std::string& name)
+{
+    std::string safe;
+    for (char c : name)
+        safe.push_back(isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' ? c : '_');
+    return dir + L"/" + Utf8ToWide(safe);
+}
+
+static void SetNonBlocking(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+static int Listen(const std::string& path)
+{
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) return -1;
+    path.copy(addr.sun_path, path.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+    unlink(path.c_str());
+    mode_t mask = umask(077);
+    bool ok = bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 && listen(fd, 8) == 0;
+    umask(mask);
+    if (!ok) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static std::string FormatLine(const std::string& name, const UsageData& data)
+{
+    json windows = json::object();
+    for (int i = 0; i < data.usage.count; ++i) {
+        auto& w = data.usage.windows[i];
+        windows[w.key] = {{"pct", w.pct}, {"resets_at", w.resetsAt}};
+    }
+    json line = {
+        {"account", name},
+        {"fetched_at", data.fetched_at},
+        {"stale", data.stale},
+        {"offline", data.offline},
+        {"deferred_until", data.deferred_until},
+        {"error", data.has_error ? json(WideToUtf8(data.error_msg)) : json(nullptr)},
+        {"windows", std::move(windows)},
+    };
+    return line.dump(-1, ' ', false, json::error_handler_t::replace) + '\n';
+}
+
+static bool SendAll(int fd, const std::string& text)
+{
+    // A client that cannot take a whole line right now is dropped rather
+    // than allowed to stall the others.
+    ssize_t sent = send(fd, text.data(), text.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    return sent == static_cast<ssize_t>(text.size());
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::pair<std::string, std::wstring>> credentials;
+    std::wstring configStem = EnvDirectory("XDG_CONFIG_HOME", L"/.config") + L"/claude-usage-taskbar/daemon";
+    std::wstring stateDir = EnvDirectory("XDG_STATE_HOME", L"/.local/state") + L"/claude-usage-taskbar";
+    std::string socketPath;
+    std::wstring replayPath;
+    int interval = 0;
+    bool once = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--once") {
+            once = true;
+            continue;
+        }
+        if (i + 1 >= argc) return Usage();
+        std::string value = argv[++i];
+        if (arg == "--credentials") {
+            auto eq = value.find('=');
+            if (eq != std::string::npos && value.find('/') > eq)
+                credentials.emplace_back(value.substr(0, eq), Utf8ToWide(value.substr(eq + 1)));
+            else
+                credentials.emplace_back("", Utf8ToWide(value));
+        } else if (arg == "--interval") {
+            interval = atoi(value.c_str());
+            if (interval < 10 || interval > 3600) return Usage();
+        } else if (arg == "--socket") {
+            socketPath = value;
+        } else if (arg == "--config") {
+            configStem = Utf8ToWide(value);
+        } else if (arg == "--state") {
+            stateDir = Utf8ToWide(value);
+        } else if (arg == "--replay") {
+            replayPath = Utf8ToWide(value);
+        } else {
+            return Usage();
+        }
+    }
+
+    auto& settings = Settings::Instance();
+    settings.SetBasePath(configStem);
+    settings.Load();
+    if (interval) {
+        PluginSettings next = settings.Get();
+        next.pollInterval = interval;
+        settings.Publish(std::move(next));
+    }
+
+    auto current = settings.Get();
+    if (replayPath.empty()) replayPath = current->replayTracePath;
+    if (!replayPath.empty()) {
+        if (!EnableHttpReplay(replayPath, current->replayTimeScalePct / 100.0)) {
+            fprintf(stderr, "claude-usage-daemon: cannot read replay trace\n");
+            return 1;
+        }
+    } else if (!current->recordTracePath.empty()) {
+        EnableHttpRecording(current->recordTracePath);
+    }
+
+    if (credentials.empty()) credentials.emplace_back("default", settings.GetEffectiveCredentialsPath());
+    if (!MakeDirectories(stateDir)) {
+        fprintf(stderr, "claude-usage-daemon: cannot create %s\n", WideToUtf8(stateDir).c_str());
+        return 1;
+    }
+
+    int listener = -1;
+    if (!socketPath.empty() && (listener = Listen(socketPath)) < 0) {
+        fprintf(stderr, "claude-usage-daemon: cannot listen on %s\n", socketPath.c_str());
+        return 1;
+    }
+
+    int wakePipe[2];
+    if (pipe(wakePipe) != 0 || pipe(g_signalPipe) != 0) return 1;
+    for (int fd : {wakePipe[0], wakePipe[1], g_signalPipe[0], g_signalPipe[1]}) SetNonBlocking(fd);
+
+    struct sigaction action = {};
+    action.sa_handler = OnSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<std::unique_ptr<Account>> accounts;
+    for (size_t i = 0; i < credentials.size(); ++i) {
+        auto account = std::make_unique<Account>();
+        account->name = credentials[i].first.empty() ? "account" + std::to_string(i + 1) : credentials[i].first;
+        auto stem = StateStem(stateDir, account->name);
+
+        UsageData cached;
+        if (LoadUsageSnapshot(stem + L".snapshot.json", cached)) account->worker.Seed(cached);
+        account->worker.SetAccount(credentials[i].second, stem);
+        account->worker.SetOnUpdate([fd = wakePipe[1]] {
+            char c = 1;
+            (void)!write(fd, &c, 1);
+        });
+        accounts.push_back(std::move(account));
+    }
+
+    for (auto& account : accounts) {
+        account->worker.Start();
+        if (!IsHttpReplayActive()) account->worker.WatchPresence();
+    }
+
+    std::vector<int> clients;
+    bool running = true;
+    while (running) {
+        std::vector<pollfd> fds = {{g_signalPipe[0], POLLIN, 0}, {wakePipe[0], POLLIN, 0}};
+        if (listener >= 0) fds.push_back({listener, POLLIN, 0});
+        for (int fd : clients) fds.push_back({fd, POLLIN, 0});
+
+        if (poll(fds.data(), fds.size(), -1) < 0) continue;
+        if (fds[0].revents) break;
+
+        // Clients only listen; anything readable is either noise or a hangup.
+        char drain[64];
+        size_t firstClient = listener >= 0 ? 3 : 2;
+        for (size_t i = fds.size(); i-- > firstClient;) {
+            if (!fds[i].revents) continue;
+            if ((fds[i].revents & POLLIN) && read(fds[i].fd, drain, sizeof(drain)) > 0) continue;
+            close(fds[i].fd);
+            clients.erase(clients.begin() + (i - firstClient));
+        }
+
+        if (listener >= 0 && (fds[2].revents & POLLIN)) {
+            int fd;
+            while ((fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK)) >= 0) {
+                bool ok = true;
+                for (auto& account : accounts)
+                    if (!account->lastLine.empty()) ok = ok && SendAll(fd, account->lastLine);
+                if (ok) clients.push_back(fd);
+                else close(fd);
+            }
+        }
+
+        if (fds[1].revents) {
+            while (read(wakePipe[0], drain, sizeof(drain)) > 0) {
+            }
+
+            bool allDone = true;
+            UsageData snapshot;
+            for (auto& account : accounts) {
+                account->worker.CopySnapshot(snapshot);
+                if (snapshot.completed_generation == account->emittedGeneration) {
+                    allDone &= account->emittedGeneration != 0;
+                    continue;
+                }
+                account->emittedGeneration = snapshot.completed_generation;
+                account->lastLine = FormatLine(account->name, snapshot);
+
+                if (listener < 0) {
+                    fputs(account->lastLine.c_str(), stdout);
+                    fflush(stdout);
+                }
+                for (auto it = clients.begin(); it != clients.end();) {
+                    if (SendAll(*it, account->lastLine)) {
+                        ++it;
+                        continue;
+                    }
+                    close(*it);
+                    it = clients.erase(it);
+                }
+            }
+            if (once && allDone) running = false;
+#ifdef __GLIBC__
+            // Hand the poll's freed buffers back instead of holding them
+            // until the next one.
+            malloc_trim(0);
+#endif
+        }
+    }
+
+    for (auto& account : accounts) account->worker.Stop();
+    for (int fd : clients) close(fd);
+    if (listener >= 0) {
+        close(listener);
+        unlink(socketPath.c_str());
+    }
+    DisableHttpTrace();
+    return 0;
+}